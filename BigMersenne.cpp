@@ -0,0 +1,528 @@
+/*
+    BigMersenne.cpp -- Residues modulo 2^p - 1 for Lucas-Lehmer past 64
+    bits (part of PerfectLib).
+*/
+#include "BigMersenne.h"
+#include "Reciprocal.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+const uint64_t  cNttPrime = 0xFFFFFFFF00000001ULL;  // 2^64 - 2^32 + 1
+const uint64_t  cNttEpsilon = 0xFFFFFFFF;           // 2^64 mod the prime
+const uint64_t  cNttGenerator = 7;                  // of the prime's whole multiplicative group
+
+static inline uint64_t MulAdd(uint64_t a, uint64_t b, uint64_t add, uint64_t& carry);
+static inline uint64_t NttAdd(uint64_t a, uint64_t b);
+static inline uint64_t NttSub(uint64_t a, uint64_t b);
+static inline uint64_t NttMul(uint64_t a, uint64_t b);
+static uint64_t NttPower(uint64_t base, uint64_t power);
+static size_t   KaratsubaScratch(size_t limbs);
+static void     SquareSchoolbook(const uint64_t* value, size_t limbs, uint64_t* square);
+static void     SquareKaratsuba(const uint64_t* value, size_t limbs, uint64_t* square, LimbArena& arena);
+static void     SquareTransform(const uint64_t* value, size_t limbs, uint64_t* square,
+                    uint64_t* coefficients, const uint64_t* roots, size_t length, unsigned digitBits, uint64_t scale);
+
+
+// Low word of a * b + add + carry; its high word goes back in carry.
+static inline uint64_t MulAdd(uint64_t a, uint64_t b, uint64_t add, uint64_t& carry)
+{
+    uint64_t    low = a * b;
+    uint64_t    high = mul_high64(a, b);
+
+    low += add;
+    high += (low < add);
+    low += carry;
+    high += (low < carry);
+    carry = high;
+
+    return low;
+}
+
+
+/*
+    Arithmetic modulo 2^64 - 2^32 + 1.  2^64 is 2^32 - 1 and 2^96 is -1
+    there, so a carry out of 64 bits is an add of 2^32 - 1 and a 128-bit
+    product folds with one subtract and one add.  The carries come out
+    at random, so they are masks rather than branches.
+*/
+static inline uint64_t NttAdd(uint64_t a, uint64_t b)
+{
+    uint64_t    sum = a + b;
+
+    sum += cNttEpsilon & (0 - (uint64_t)(sum < a));
+    return sum - (cNttPrime & (0 - (uint64_t)(sum >= cNttPrime)));
+}
+
+
+static inline uint64_t NttSub(uint64_t a, uint64_t b)
+{
+    uint64_t    difference = a - b;
+
+    return difference - (cNttEpsilon & (0 - (uint64_t)(a < b)));
+}
+
+
+static inline uint64_t NttMul(uint64_t a, uint64_t b)
+{
+    uint64_t    low = a * b;
+    uint64_t    high = mul_high64(a, b);
+    uint64_t    top = high >> 32;                   // weight 2^96
+    uint64_t    middle = high & 0xFFFFFFFF;         // weight 2^64
+    uint64_t    result = low - top, fold;
+
+    result -= cNttEpsilon & (0 - (uint64_t)(low < top));
+    fold = (middle << 32) - middle;
+    result += fold;
+    result += cNttEpsilon & (0 - (uint64_t)(result < fold));
+
+    return result - (cNttPrime & (0 - (uint64_t)(result >= cNttPrime)));
+}
+
+
+static uint64_t NttPower(uint64_t base, uint64_t power)
+{
+    uint64_t    result = 1;
+
+    for (; power != 0; power >>= 1)
+    {
+        if (power & 1)
+            result = NttMul(result, base);
+        base = NttMul(base, base);
+    }
+
+    return result;
+}
+
+
+/*
+    Limbs SquareKaratsuba() takes from the arena for a square of this many
+    limbs: the sum of the halves and its square, then the same again one
+    level down for that square.  The halves' own squares are done before
+    any of it is taken.
+*/
+static size_t KaratsubaScratch(size_t limbs)
+{
+    size_t      scratch = 0;
+
+    while (limbs >= cKaratsubaLimbs)
+    {
+        size_t  high = limbs - limbs / 2;
+
+        scratch += 3 * (high + 1);
+        limbs = high + 1;
+    }
+
+    return scratch;
+}
+
+
+static void SquareSchoolbook(const uint64_t* value, size_t limbs, uint64_t* square)
+{
+    uint64_t    carry, bit;
+
+    // the cross products a[i] * a[j], i < j, once
+    memset(square, 0, 2 * limbs * sizeof(uint64_t));
+    for (size_t row = 0; row + 1 < limbs; row++)
+    {
+        carry = 0;
+        for (size_t column = row + 1; column < limbs; column++)
+            square[row + column] = MulAdd(value[row], value[column], square[row + column], carry);
+        square[row + limbs] = carry;
+    }
+
+    // doubled, plus the squares on the diagonal
+    bit = 0;
+    for (size_t index = 0; index < 2 * limbs; index++)
+    {
+        uint64_t    limb = square[index];
+
+        square[index] = (limb << 1) | bit;
+        bit = limb >> 63;
+    }
+    carry = 0;
+    for (size_t index = 0; index < limbs; index++)
+    {
+        uint64_t    high = 0;
+        uint64_t    low = MulAdd(value[index], value[index], 0, high);
+        uint64_t    sum;
+
+        sum = square[2 * index] + low;
+        high += (sum < low);
+        sum += carry;
+        high += (sum < carry);
+        square[2 * index] = sum;
+
+        sum = square[2 * index + 1] + high;
+        carry = (sum < high);
+        square[2 * index + 1] = sum;
+    }
+}
+
+
+/*
+    (a0 + a1 B)^2 = a0^2 + ((a0 + a1)^2 - a0^2 - a1^2) B + a1^2 B^2, with
+    B = 2^(64 low limbs); the halves' squares go straight into place.
+*/
+static void SquareKaratsuba(const uint64_t* value, size_t limbs, uint64_t* square, LimbArena& arena)
+{
+    if (limbs < cKaratsubaLimbs)
+    {
+        SquareSchoolbook(value, limbs, square);
+        return;
+    }
+
+    size_t      low = limbs / 2, high = limbs - low;
+    size_t      mark = arena.Mark();
+    uint64_t    carry = 0, borrow;
+
+    SquareKaratsuba(value, low, square, arena);
+    SquareKaratsuba(value + low, high, square + 2 * low, arena);
+
+    uint64_t*   sum = arena.Take(high + 1);
+    uint64_t*   middle = arena.Take(2 * (high + 1));
+
+    for (size_t index = 0; index < high; index++)
+    {
+        uint64_t    limb = value[low + index] + carry;
+
+        carry = (limb < carry);
+        if (index < low)
+        {
+            limb += value[index];
+            carry += (limb < value[index]);
+        }
+        sum[index] = limb;
+    }
+    sum[high] = carry;
+    SquareKaratsuba(sum, high + 1, middle, arena);
+
+    // middle -= a0^2 and a1^2; what is left is 2 a0 a1, never negative
+    borrow = 0;
+    for (size_t index = 0; index < 2 * (high + 1); index++)
+    {
+        uint64_t    subtract = (index < 2 * low) ? square[index] : 0;
+        uint64_t    limb = middle[index];
+        uint64_t    next = (limb < subtract) || (limb - subtract < borrow);
+
+        middle[index] = limb - subtract - borrow;
+        borrow = next;
+    }
+    borrow = 0;
+    for (size_t index = 0; index < 2 * (high + 1); index++)
+    {
+        uint64_t    subtract = (index < 2 * high) ? square[2 * low + index] : 0;
+        uint64_t    limb = middle[index];
+        uint64_t    next = (limb < subtract) || (limb - subtract < borrow);
+
+        middle[index] = limb - subtract - borrow;
+        borrow = next;
+    }
+
+    // and in at B; the whole square fits its 2 * limbs
+    carry = 0;
+    for (size_t index = low; index < 2 * limbs; index++)
+    {
+        uint64_t    add = (index - low < 2 * (high + 1)) ? middle[index - low] : 0;
+        uint64_t    limb = square[index] + add;
+        uint64_t    next = (limb < add);
+
+        limb += carry;
+        next += (limb < carry);
+        square[index] = limb;
+        carry = next;
+        if (carry == 0 && index - low >= 2 * (high + 1))
+            break;
+    }
+
+    arena.Release(mark);
+}
+
+
+/*
+    The square by transform: digits of digitBits in, forward transform
+    (decimation in frequency, so the output is in bit-reversed order),
+    each point squared, and back (decimation in time, from bit-reversed
+    order), so no permutation is ever done.  The roots of the stage with
+    butterflies half apart are roots[half ...], of the inverse stage
+    roots[length + half ...], each run in the order the stage reads it;
+    scale is 1/length.
+*/
+static void SquareTransform(const uint64_t* value, size_t limbs, uint64_t* square,
+    uint64_t* coefficients, const uint64_t* roots, size_t length, unsigned digitBits, uint64_t scale)
+{
+    uint64_t        mask = ((uint64_t)1 << digitBits) - 1;
+    size_t          digits = (64 * limbs + digitBits - 1) / digitBits;
+    uint64_t        carry;
+
+    for (size_t index = 0, bit = 0; index < length; index++, bit += digitBits)
+    {
+        uint64_t    digit = 0;
+
+        if (index < digits)
+        {
+            digit = value[bit / 64] >> (bit % 64);
+            if (bit % 64 + digitBits > 64 && bit / 64 + 1 < limbs)
+                digit |= value[bit / 64 + 1] << (64 - bit % 64);
+        }
+        coefficients[index] = digit & mask;
+    }
+
+    for (size_t half = length / 2; half >= 1; half /= 2)
+    {
+        const uint64_t* stage = roots + half;
+
+        for (size_t block = 0; block < length; block += 2 * half)
+        {
+            uint64_t*   even = coefficients + block;
+            uint64_t*   odd = even + half;
+
+            for (size_t index = 0; index < half; index++)
+            {
+                uint64_t    difference = NttSub(even[index], odd[index]);
+
+                even[index] = NttAdd(even[index], odd[index]);
+                odd[index] = NttMul(difference, stage[index]);
+            }
+        }
+    }
+
+    for (size_t index = 0; index < length; index++)
+        coefficients[index] = NttMul(coefficients[index], coefficients[index]);
+
+    for (size_t half = 1; half < length; half *= 2)
+    {
+        const uint64_t* stage = roots + length + half;
+
+        for (size_t block = 0; block < length; block += 2 * half)
+        {
+            uint64_t*   even = coefficients + block;
+            uint64_t*   odd = even + half;
+
+            for (size_t index = 0; index < half; index++)
+            {
+                uint64_t    twisted = NttMul(odd[index], stage[index]);
+
+                odd[index] = NttSub(even[index], twisted);
+                even[index] = NttAdd(even[index], twisted);
+            }
+        }
+    }
+
+    // scaled by 1/length, carried, and packed
+    memset(square, 0, 2 * limbs * sizeof(uint64_t));
+    carry = 0;
+    for (size_t index = 0, bit = 0; index < 2 * digits && bit < 128 * limbs; index++, bit += digitBits)
+    {
+        uint64_t    digit;
+
+        carry += NttMul(coefficients[index], scale);
+        digit = carry & mask;
+        carry >>= digitBits;
+
+        square[bit / 64] |= digit << (bit % 64);
+        if (bit % 64 + digitBits > 64 && bit / 64 + 1 < 2 * limbs)
+            square[bit / 64 + 1] |= digit >> (64 - bit % 64);
+    }
+}
+
+
+MersenneResidue::MersenneResidue(unsigned exponent)
+    : exponent_(exponent), limbs_((exponent + 63) / 64), topBits_(exponent - 64 * (unsigned)(limbs_ - 1)),
+      transform_(0), digitBits_(0), arena_(0), coefficients_(nullptr), roots_(nullptr), scale_(0)
+{
+    size_t      scratch = 0;
+
+    // the shortest transform some digit size fits: 2 * digits points, and
+    // every coefficient of the square, digits * 2^(2 * bits), below 2^63
+    // so the carries never overflow
+    if (limbs_ >= cNttLimbs)
+    {
+        for (transform_ = 2; ; transform_ *= 2)
+        {
+            digitBits_ = (unsigned)((128 * limbs_ + transform_ - 1) / transform_);
+            if (digitBits_ <= 24 && ((64 * limbs_ + digitBits_ - 1) / digitBits_) < ((uint64_t)1 << (63 - 2 * digitBits_)))
+                break;
+        }
+        scratch = 3 * transform_;
+    }
+    else
+        scratch = KaratsubaScratch(limbs_);
+
+    arena_ = LimbArena(4 * limbs_ + scratch);
+    value_ = arena_.Take(limbs_);
+    square_ = arena_.Take(2 * limbs_);
+    addend_ = arena_.Take(limbs_);
+    if (transform_ != 0)
+    {
+        coefficients_ = arena_.Take(transform_);
+        roots_ = arena_.Take(2 * transform_);
+        for (size_t half = 1; half < transform_; half *= 2)
+        {
+            uint64_t    root = NttPower(cNttGenerator, (cNttPrime - 1) / (2 * half));
+            uint64_t    inverse = NttPower(root, cNttPrime - 2);
+            uint64_t    forward = 1, backward = 1;
+
+            for (size_t index = 0; index < half; index++)
+            {
+                roots_[half + index] = forward;
+                roots_[transform_ + half + index] = backward;
+                forward = NttMul(forward, root);
+                backward = NttMul(backward, inverse);
+            }
+        }
+        scale_ = NttPower(transform_, cNttPrime - 2);
+    }
+    Set(0);
+}
+
+
+void MersenneResidue::Set(uint64_t value)
+{
+    memset(value_, 0, limbs_ * sizeof(uint64_t));
+    value_[0] = value;
+}
+
+
+void MersenneResidue::SquareMinus(uint64_t subtract)
+{
+    Square();
+
+    // less subtract is plus 2^p - 1 - subtract
+    for (size_t index = 0; index < limbs_; index++)
+        addend_[index] = ~(uint64_t)0;
+    if (topBits_ < 64)
+        addend_[limbs_ - 1] = ((uint64_t)1 << topBits_) - 1;
+    addend_[0] -= subtract;
+    AddFolded(addend_);
+}
+
+
+// Zero, or 2^p - 1, which is the same residue.
+bool MersenneResidue::IsZero(void) const
+{
+    uint64_t    top = (topBits_ < 64) ? ((uint64_t)1 << topBits_) - 1 : ~(uint64_t)0;
+    bool        zero = true, ones = (value_[limbs_ - 1] == top);
+
+    for (size_t index = 0; index < limbs_; index++)
+    {
+        zero = zero && value_[index] == 0;
+        ones = ones && (index == limbs_ - 1 || value_[index] == ~(uint64_t)0);
+    }
+
+    return zero || ones;
+}
+
+
+/*
+    value^2, then the bits from p up added back onto the low p bits.
+*/
+void MersenneResidue::Square(void)
+{
+    size_t      words = exponent_ / 64;
+    unsigned    bits = exponent_ % 64;
+
+    if (transform_ != 0)
+        SquareTransform(value_, limbs_, square_, coefficients_, roots_, transform_, digitBits_, scale_);
+    else
+        SquareKaratsuba(value_, limbs_, square_, arena_);
+
+    for (size_t index = 0; index < limbs_; index++)
+    {
+        addend_[index] = (bits == 0) ? square_[words + index]
+            : (square_[words + index] >> bits) | (square_[words + index + 1] << (64 - bits));
+        value_[index] = square_[index];
+    }
+    if (topBits_ < 64)
+        value_[limbs_ - 1] &= ((uint64_t)1 << topBits_) - 1;
+    AddFolded(addend_);
+}
+
+
+/*
+    value += addend, both below 2^p, folding the bit that comes out at p
+    back in at bit 0.  Adding that one can only carry to p again from
+    2^p - 1, and then leaves 1, so it folds twice at most.
+*/
+void MersenneResidue::AddFolded(const uint64_t* addend)
+{
+    uint64_t    carry = 0, over;
+
+    for (size_t index = 0; index < limbs_; index++)
+    {
+        uint64_t    limb = value_[index] + carry;
+
+        carry = (limb < carry);
+        limb += addend[index];
+        carry += (limb < addend[index]);
+        value_[index] = limb;
+    }
+
+    for (;;)
+    {
+        if (topBits_ < 64)
+        {
+            over = value_[limbs_ - 1] >> topBits_;
+            value_[limbs_ - 1] &= ((uint64_t)1 << topBits_) - 1;
+        }
+        else
+            over = carry;
+        if (over == 0)
+            break;
+
+        carry = over;
+        for (size_t index = 0; index < limbs_ && carry != 0; index++)
+        {
+            value_[index] += carry;
+            carry = (value_[index] < carry);
+        }
+    }
+}
+
+
+/*
+    2^(2p - 1) - 2^(p - 1) in decimal, nine digits at a time: the bits go
+    in 32-bit words so every step of the long division by 10^9 fits 64
+    bits, with no wide type needed.
+*/
+std::string format_perfect(unsigned exponent)
+{
+    std::vector<uint32_t>   words((2 * exponent - 1 + 31) / 32, 0);
+    std::vector<uint32_t>   groups;
+    std::string             digits;
+    size_t                  top = words.size();
+    char                    group[16];
+
+    if (exponent < 2)
+        return "0";
+
+    for (unsigned bit = exponent - 1; bit < 2 * exponent - 1; bit++)
+        words[bit / 32] |= (uint32_t)1 << (bit % 32);
+
+    while (top != 0)
+    {
+        uint64_t    remainder = 0;
+
+        for (size_t index = top; index-- > 0; )
+        {
+            uint64_t    part = (remainder << 32) | words[index];
+
+            words[index] = (uint32_t)(part / 1000000000);
+            remainder = part % 1000000000;
+        }
+        groups.push_back((uint32_t)remainder);
+        while (top != 0 && words[top - 1] == 0)
+            top--;
+    }
+
+    snprintf(group, sizeof(group), "%u", groups.back());
+    digits = group;
+    for (size_t index = groups.size() - 1; index-- > 0; )
+    {
+        snprintf(group, sizeof(group), "%09u", groups[index]);
+        digits += group;
+    }
+
+    return digits;
+}
@@ -0,0 +1,123 @@
+/*
+    BigMersenne.h -- Residues modulo 2^p - 1 for Lucas-Lehmer past 64 bits
+    (part of PerfectLib).
+
+    A residue is ceil(p / 64) limbs, low limb first, kept in [0, 2^p - 1]
+    (2^p - 1 itself standing for zero).  The test only ever squares, so
+    squaring is the one product there is, and it picks its method by size:
+
+    - Below cKaratsubaLimbs, schoolbook: every cross product once, doubled,
+      and the squares of the limbs on the diagonal.
+    - Below cNttLimbs, Karatsuba: the square of a0 + a1 * B is a0^2, a1^2
+      and (a0 + a1)^2 - a0^2 - a1^2, three half-size squares instead of
+      four.
+    - Past that, a number-theoretic transform over the prime 2^64 - 2^32 +
+      1, whose reductions are shifts and adds.  The limbs go in as digits
+      of up to 24 bits, as wide as the transform length allows while every
+      coefficient of the square stays far under the prime, so one
+      transform is exact.
+
+    Reduction needs no division: 2^p == 1 (mod 2^p - 1), so the bits from
+    p up are added back onto the low p bits.
+
+    Everything the test will touch, the residue, the square, the Karatsuba
+    scratch or the transform and its roots, is cut from one LimbArena when
+    the residue is made, so its p - 2 squarings allocate nothing; the
+    arena's block is a LimbPool's (Scratch.h), so mostly neither does
+    making the residue.
+*/
+#pragma once
+
+#include "Perfect.h"
+#include "Scratch.h"
+
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+
+const size_t    cKaratsubaLimbs = 64;           // squares of this many limbs or more split in halves
+const size_t    cNttLimbs = 1536;               // ...and of this many or more go through the transform
+
+
+// Limbs handed out in order from one block, and handed back by rewinding
+// to a mark.  Its capacity is fixed when it is made; the block comes from
+// limb_pool() and goes back to it, so the next residue of about the same
+// size allocates nothing.
+class LimbArena
+{
+public:
+    explicit LimbArena(size_t capacity)
+        : limbs_(capacity ? limb_pool().Take(capacity, capacity_) : nullptr), used_(0)
+    {
+        if (capacity == 0)
+            capacity_ = 0;
+    }
+
+    ~LimbArena()
+    {
+        if (limbs_ != nullptr)
+            limb_pool().Give(limbs_, capacity_);
+    }
+
+    LimbArena& operator=(LimbArena&& other)
+    {
+        std::swap(limbs_, other.limbs_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(used_, other.used_);
+        return *this;
+    }
+
+    // count limbs, uninitialized; the arena is sized so it never runs out
+    uint64_t*   Take(size_t count)
+    {
+        uint64_t*   limbs = &limbs_[used_];
+
+        used_ += count;
+        return limbs;
+    }
+
+    size_t      Mark(void) const { return used_; }
+    void        Release(size_t mark) { used_ = mark; }
+
+private:
+    uint64_t*   limbs_;
+    size_t      capacity_;
+    size_t      used_;
+
+    LimbArena(const LimbArena&) = delete;
+    LimbArena& operator=(const LimbArena&) = delete;
+};
+
+
+class MersenneResidue
+{
+public:
+    explicit MersenneResidue(unsigned exponent);
+
+    void        Set(uint64_t value);
+
+    // value = value^2 - subtract (mod 2^p - 1), for subtract < 2^p - 1
+    void        SquareMinus(uint64_t subtract);
+
+    bool        IsZero(void) const;
+
+    size_t      Limbs(void) const { return limbs_; }
+
+private:
+    void        Square(void);
+    void        AddFolded(const uint64_t* addend);
+
+    unsigned    exponent_;
+    size_t      limbs_;
+    unsigned    topBits_;                       // bits of 2^p - 1 in its top limb, 1 to 64
+    size_t      transform_;                     // transform length; 0 below cNttLimbs
+    unsigned    digitBits_;                     // bits per transform digit
+    LimbArena   arena_;
+    uint64_t*   value_;                         // limbs_
+    uint64_t*   square_;                        // 2 * limbs_
+    uint64_t*   addend_;                        // limbs_
+    uint64_t*   coefficients_;                  // transform_
+    uint64_t*   roots_;                         // transform_ forward by stage, then as many inverse
+    uint64_t    scale_;                         // 1 / transform_, modulo the transform's prime
+};
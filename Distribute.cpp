@@ -0,0 +1,452 @@
+/*
+    Distribute.cpp -- The lease coordinator and the lease worker.
+*/
+#include "Distribute.h"
+
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+
+const ULONG     cAcceptMillis = 100;            // how long the coordinator waits for a connection
+const ULONG     cLineMillis = 5000;             // ...and for its one line
+const ULONG     cReplyMillis = 10000;           // how long a worker waits for an answer
+const ULONG     cWaitSeconds = 5;               // a worker with nothing to do asks again after this
+const ULONG     cBeatMillis = 100;              // how often the heartbeat looks at the clock
+const unsigned  cConnectTries = 12;             // a worker gives up after this many failures in a row
+
+
+// One hiPower band, as the coordinator sees it.
+struct LeaseBand
+{
+    ULONG           settled;                    // lowest loPower settled; 0 none, 1 done
+    ULONGLONG       lease;                      // the lease out on it, 0 if none
+    double          expires;                    // wall_seconds() it runs out at
+    std::string     worker;
+};
+
+
+static bool     Stopped(const std::atomic<bool>* stop);
+static bool     Pause(ULONG seconds, const std::atomic<bool>* stop);
+static std::string Exchange(const char* host, unsigned port, const std::string& request);
+static std::string AnswerLease(LeaseBand bands[], const LeaseOptions& options, std::istringstream& request,
+                    ULONGLONG& nextLease);
+static std::string AnswerReport(LeaseBand bands[], const LeaseOptions& options, LeaseListener& listener,
+                    std::istringstream& request);
+
+
+static bool Stopped(const std::atomic<bool>* stop)
+{
+    return stop != nullptr && stop->load(std::memory_order_relaxed);
+}
+
+
+// Sleep, but wake for the stop flag; false if it was set.
+static bool Pause(ULONG seconds, const std::atomic<bool>* stop)
+{
+    for (ULONG waited = 0; waited < seconds * 10; waited++)
+    {
+        if (Stopped(stop))
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    return !Stopped(stop);
+}
+
+
+/*
+    The coordinator: one connection at a time, each a line in and a line
+    out, so the band table needs no lock.  The leases are the bands not
+    yet settled, lowest first.
+*/
+bool ServeLeases(const LeaseOptions& options, LeaseListener& listener)
+{
+    LeaseBand       bands[cMaxPower + 1];
+    net_socket      server;
+    double          linger = 0;
+    bool            done = false;
+    ULONGLONG       nextLease;
+
+    // lease numbers from an earlier run must never match this one's
+    nextLease = (ULONGLONG)std::chrono::system_clock::now().time_since_epoch().count() << 8;
+    for (unsigned power = 0; power <= cMaxPower; power++)
+    {
+        bands[power].settled = options.settled[power];
+        bands[power].lease = 0;
+        bands[power].expires = 0;
+    }
+
+    if ((server = net_listen(options.port)) == cNoSocket)
+    {
+        printf("ERROR: Cannot listen on port %u.\n", options.port);
+        return false;
+    }
+
+    while (!Stopped(options.stop))
+    {
+        double          now = wall_seconds();
+        net_socket      client;
+        std::string     line, verb;
+
+        // a band whose worker went quiet is up for the next one to ask
+        done = true;
+        for (unsigned power = 3; power <= cMaxPower; power++)
+        {
+            if (bands[power].lease != 0 && bands[power].expires < now)
+            {
+                bands[power].lease = 0;
+                listener.Expired(power, bands[power].worker);
+            }
+            if (bands[power].settled != 1)
+                done = false;
+        }
+
+        // once done, stay up long enough that the waiting workers hear so
+        if (done && linger == 0)
+            linger = now + cWaitSeconds + 1;
+        if (done && now > linger)
+            break;
+
+        if ((client = net_accept(server, cAcceptMillis)) == cNoSocket)
+            continue;
+
+        if (net_read_line(client, line, cLineMillis))
+        {
+            std::istringstream  request(line);
+
+            request >> verb;
+            if (verb == "LEASE")
+                net_send_line(client, AnswerLease(bands, options, request, nextLease));
+            else if (verb == "REPORT")
+                net_send_line(client, AnswerReport(bands, options, listener, request));
+            else
+                net_send_line(client, "ERROR");
+        }
+        net_close(client);
+    }
+
+    net_close(server);
+    return done;
+}
+
+
+static std::string AnswerLease(LeaseBand bands[], const LeaseOptions& options, std::istringstream& request,
+    ULONGLONG& nextLease)
+{
+    std::ostringstream  answer;
+    std::string         worker;
+    bool                open = false;
+
+    request >> worker;
+    for (unsigned power = 3; power <= cMaxPower; power++)
+    {
+        LeaseBand&  band = bands[power];
+
+        if (band.settled == 1)
+            continue;
+        open = true;
+        if (band.lease != 0)
+            continue;
+
+        band.lease = ++nextLease;
+        band.expires = wall_seconds() + options.leaseSeconds;
+        band.worker = worker.empty() ? "?" : worker;
+        answer << "LEASE " << band.lease << ' ' << (int)options.engine << ' ' << power << ' '
+            << (band.settled ? band.settled - 1 : power - 1);
+        return answer.str();
+    }
+
+    if (!open)
+        return "DONE";
+
+    answer << "WAIT " << cWaitSeconds;
+    return answer.str();
+}
+
+
+/*
+    Fold a worker's report into the band, if the lease is still its own
+    and the report makes sense for the band.
+*/
+static std::string AnswerReport(LeaseBand bands[], const LeaseOptions& options, LeaseListener& listener,
+    std::istringstream& request)
+{
+    ULONGLONG               lease = 0, counts[cVerdictCount];
+    ULONG                   power = 0, lowest = 0;
+    unsigned                perfect;
+    std::vector<unsigned>   perfects;
+    bool                    news = false;
+
+    request >> lease >> power >> lowest;
+    for (int index = 0; index < cVerdictCount; index++)
+    {
+        request >> counts[index];
+        news = news || counts[index] != 0;
+    }
+    if (request.fail() || power < 3 || power > cMaxPower)
+        return "ERROR";
+    while (request >> perfect)
+        perfects.push_back(perfect);
+
+    LeaseBand&  band = bands[power];
+    ULONG       above = band.settled ? band.settled : power;
+
+    if (band.lease == 0 || band.lease != lease || lowest >= above)
+        return "LOST";
+    for (size_t index = 0; index < perfects.size(); index++)
+        if (perfects[index] < (lowest ? lowest : 1) || perfects[index] >= above)
+            return "ERROR";
+
+    band.expires = wall_seconds() + options.leaseSeconds;
+    if (lowest != 0)
+        band.settled = lowest;
+    if (lowest == 1)
+        band.lease = 0;
+    if (lowest != 0 || news || !perfects.empty())
+        listener.Settled(power, lowest, counts, perfects);
+
+    return "OK";
+}
+
+
+/*
+    One request to the coordinator; the answer is empty if it could not
+    be reached.
+*/
+static std::string Exchange(const char* host, unsigned port, const std::string& request)
+{
+    net_socket      socket = net_connect(host, port);
+    std::string     answer;
+
+    if (socket == cNoSocket)
+        return answer;
+
+    if (!net_send_line(socket, request) || !net_read_line(socket, answer, cReplyMillis))
+        answer.clear();
+    net_close(socket);
+
+    return answer;
+}
+
+
+/*
+    Sweeps one lease's band, keeping what it settled until the next
+    report.  Tested() comes from the sweep's workers and Beat() from a
+    heartbeat thread of WorkLeases(), so the pending report is under a
+    lock; a serial sweep that spends minutes on one candidate still
+    reports every cBeatSeconds.  Poll() only stops the sweep once the
+    lease is lost.
+*/
+class LeaseSweep : public SweepListener
+{
+public:
+    LeaseSweep(const char* host, unsigned port, ULONGLONG lease, unsigned hiPower)
+        : host_(host), port_(port), lease_(lease), hiPower_(hiPower), lowest_(0), lost_(false),
+          lastReport_(wall_seconds())
+    {
+        for (int index = 0; index < cVerdictCount; index++)
+            counts_[index] = 0;
+    }
+
+    void Tested(unsigned, unsigned lo, PerfectValue value, PerfectVerdict verdict)
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+
+        lowest_ = lo;
+        counts_[verdict]++;
+        if (verdict == cVerdictPerfect)
+        {
+            perfects_.push_back(lo);
+            printf("Perfect number %s (2^%u - 2^%u).\n", format_value(value).c_str(), hiPower_, lo);
+            fflush(stdout);
+        }
+    }
+
+    // a lost lease stops the sweep
+    bool Poll(void)
+    {
+        return lost_;
+    }
+
+    // the heartbeat: a report once cBeatSeconds have gone by
+    void Beat(void)
+    {
+        if (!lost_ && wall_seconds() - lastReport_ >= cBeatSeconds)
+            Report();
+    }
+
+    bool Lost(void) const
+    {
+        return lost_;
+    }
+
+    // Send everything settled since the last report; false if it did not
+    // get through (it is kept for the next one) or the lease is lost.
+    // Only one thread at a time reports.
+    bool Report(void);
+
+private:
+    const char*     host_;
+    unsigned        port_;
+    ULONGLONG       lease_;
+    unsigned        hiPower_;
+    std::mutex      lock_;                      // guards the pending report
+    unsigned        lowest_;
+    ULONGLONG       counts_[cVerdictCount];
+    std::vector<unsigned> perfects_;
+    std::atomic<bool> lost_;
+    double          lastReport_;                // the reporting thread's
+};
+
+
+bool LeaseSweep::Report(void)
+{
+    std::ostringstream      request;
+    std::string             answer;
+    unsigned                lowest;
+    ULONGLONG               counts[cVerdictCount];
+    std::vector<unsigned>   perfects;
+
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+
+        lowest = lowest_;
+        perfects.swap(perfects_);
+        for (int index = 0; index < cVerdictCount; index++)
+        {
+            counts[index] = counts_[index];
+            counts_[index] = 0;
+        }
+        lowest_ = 0;
+    }
+
+    request << "REPORT " << lease_ << ' ' << hiPower_ << ' ' << lowest;
+    for (int index = 0; index < cVerdictCount; index++)
+        request << ' ' << counts[index];
+    for (size_t index = 0; index < perfects.size(); index++)
+        request << ' ' << perfects[index];
+
+    answer = Exchange(host_, port_, request.str());
+    lastReport_ = wall_seconds();
+    if (answer == "OK")
+        return true;
+    if (!answer.empty())
+    {
+        lost_ = true;
+        return false;
+    }
+
+    // no answer: put it back under whatever was settled since
+    std::lock_guard<std::mutex> guard(lock_);
+
+    if (lowest_ == 0)
+        lowest_ = lowest;
+    perfects_.insert(perfects_.begin(), perfects.begin(), perfects.end());
+    for (int index = 0; index < cVerdictCount; index++)
+        counts_[index] += counts[index];
+
+    return false;
+}
+
+
+bool WorkLeases(const char* host, unsigned port, const SweepOptions& options, bool quiet)
+{
+    SweepOptions    sweep = options;
+    std::string     name = net_host_name();
+    unsigned        failures = 0;
+
+    while (!Stopped(options.stop))
+    {
+        std::istringstream  answer(Exchange(host, port, "LEASE " + name));
+        std::string         verb;
+        ULONGLONG           lease = 0;
+        int                 engine = -1;
+        unsigned            hi = 0, lo = 0;
+        ULONG               wait = cWaitSeconds;
+
+        answer >> verb;
+        if (verb.empty())
+        {
+            if (++failures >= cConnectTries)
+            {
+                printf("ERROR: No answer from %s:%u.\n", host, port);
+                return false;
+            }
+            Pause(cWaitSeconds, options.stop);
+            continue;
+        }
+        failures = 0;
+
+        if (verb == "DONE")
+            return true;
+        if (verb == "WAIT")
+        {
+            answer >> wait;
+            Pause(wait, options.stop);
+            continue;
+        }
+
+        answer >> lease >> engine >> hi >> lo;
+        if (verb != "LEASE" || answer.fail() || engine < cEngineLucasLehmer || engine > cEngineRow
+            || hi < 3 || hi > cMaxPower || lo == 0 || lo >= hi)
+        {
+            printf("ERROR: %s:%u is not a coordinator.\n", host, port);
+            return false;
+        }
+
+        // the band, from where the last worker on it left off, with the
+        // heartbeat on a thread of its own while it runs
+        LeaseSweep          listener(host, port, lease, hi);
+        std::atomic<bool>   swept(false);
+        bool                finished;
+
+        if (!quiet)
+        {
+            printf("Band %u from loPower %u, %s engine.\n", hi, lo, engine_name((PerfectEngine)engine));
+            fflush(stdout);
+        }
+        sweep.engine = (PerfectEngine)engine;
+        sweep.firstPower = hi;
+        sweep.lastPower = hi;
+        sweep.firstLoPower = lo;
+        sweep.lastExponent = 0;
+
+        std::thread         heartbeat([&listener, &swept]
+        {
+            while (!swept)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(cBeatMillis));
+                listener.Beat();
+            }
+        });
+
+        finished = LoopForPerfects(sweep, listener);
+        swept = true;
+        heartbeat.join();
+
+        if (listener.Lost())
+        {
+            if (!quiet)
+                printf("Band %u went to another worker.\n", hi);
+            continue;
+        }
+
+        // hand in the rest; a worker that was stopped hands in what it has
+        for (unsigned tries = 0; !listener.Report() && !listener.Lost(); tries++)
+        {
+            if (tries + 1 >= cConnectTries || !Pause(cWaitSeconds, finished ? options.stop : nullptr))
+            {
+                printf("ERROR: Band %u could not be reported.\n", hi);
+                return false;
+            }
+        }
+        if (!finished)
+            return false;
+    }
+
+    return false;
+}
@@ -0,0 +1,81 @@
+/*
+    Distribute.h -- The sweep spread over machines: a coordinator that
+    leases hiPower bands out over TCP, and workers that sweep them.
+
+    A lease is one band, which with the Lucas-Lehmer engine is one
+    Mersenne exponent.  Workers report what they have settled every
+    cBeatSeconds, from a thread of their own so that one long candidate
+    cannot hold a report up, and that keeps the lease alive; a lease with
+    no report for its LeaseOptions::leaseSeconds goes to the next worker
+    that asks, which resumes the band from the last report.
+
+    Each exchange is one line from the worker, one line back, and the
+    connection is closed:
+
+        LEASE worker            -> LEASE id engine hiPower loPower
+                                   WAIT seconds   (every band is out)
+                                   DONE           (every band is settled)
+        REPORT id hiPower loPower c0 .. c4 [perfect loPower ...]
+                                -> OK | LOST
+
+    REPORT carries what was settled since the last report: the lowest
+    loPower settled (0 for none, 1 finishes the band), the verdict counts
+    and the loPower of each perfect.  LOST means the lease went to another
+    worker; the report is dropped and the worker moves on.
+*/
+#pragma once
+
+#include "LoopForPerfects.h"
+#include "Platform.h"
+
+#include <string>
+#include <vector>
+
+
+const unsigned  cDefaultPort = 7716;            // /N and /W without a port
+const ULONG     cBeatSeconds = 10;              // a worker reports this often
+
+
+// What the coordinator tells the program; it calls these on the thread
+// that called ServeLeases().
+class LeaseListener
+{
+public:
+    virtual ~LeaseListener() {}
+
+    // A report accepted for band hiPower: loPower is its lowest candidate
+    // now settled (1 once the band is done), counts and perfects are what
+    // the report settled.  Never called with nothing new.
+    virtual void    Settled(unsigned hiPower, unsigned loPower, const ULONGLONG counts[cVerdictCount],
+                        const std::vector<unsigned>& perfects) = 0;
+
+    // A lease ran out; its band is up for the next worker.
+    virtual void    Expired(unsigned hiPower, const std::string& worker) = 0;
+};
+
+
+struct LeaseOptions
+{
+    PerfectEngine   engine;                     // what the workers are told to run
+    unsigned        port;                       // to listen on
+    ULONG           leaseSeconds;               // a lease with no report this long is re-issued
+    ULONG           settled[cMaxPower + 1];     // per band: lowest loPower settled, 0 for none, 1 done
+    const std::atomic<bool>* stop;              // set from any thread to stop; may be null
+
+    LeaseOptions() : engine(cEngineLucasLehmer), port(cDefaultPort), leaseSeconds(6 * cBeatSeconds), stop(nullptr)
+    {
+        for (unsigned power = 0; power <= cMaxPower; power++)
+            settled[power] = (power < 3) ? 1 : 0;
+    }
+};
+
+
+// Lease bands out until every one is settled; returns false if stopped
+// or the port cannot be had.
+bool        ServeLeases(const LeaseOptions& options, LeaseListener& listener);
+
+// Take leases from host:port and sweep them with options (its engine
+// and range are the coordinator's) until the coordinator is done; returns
+// false if stopped or the coordinator is gone.  quiet leaves out the line
+// for each lease, keeping the perfects and the errors.
+bool        WorkLeases(const char* host, unsigned port, const SweepOptions& options, bool quiet);
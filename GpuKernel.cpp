@@ -0,0 +1,429 @@
+/*
+    GpuKernel.cpp -- Trial division of a batch of candidates on the GPU,
+    through OpenCL (part of PerfectLib).
+
+    Every candidate of the batch is swept cGpuChunk divisors at a time.
+    One launch covers the same divisor chunk of every candidate still
+    open: each work-group takes a slice of one candidate's chunk, each
+    work item a stride of the slice, and the group adds its items' sums
+    in local memory into a single 128-bit partial.  The host adds the
+    partials, settles the candidates that went abundant, ran out of
+    divisors or cannot reach their value any more, and takes them out of
+    the next launches.
+
+    The device has two queues: the next chunk is computed on one while
+    the partials of the last one are read back on the other, so the
+    transfers hide behind the compute.  That launch is made before the
+    last one's results are in, so a candidate settled by them still costs
+    one chunk more; its partials are ignored.
+
+    Without OpenCL at build time (PERFECT_HAVE_OPENCL), or without a
+    device at run time, and for values past 64 bits, the batch is trial
+    divided on the CPU with the SIMD kernel instead.
+*/
+#include "Perfect.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#if defined(PERFECT_HAVE_OPENCL)
+#define CL_TARGET_OPENCL_VERSION 120
+#if defined(__APPLE__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+#endif
+
+
+const size_t    cGpuBatch = 0x00000400;         // candidates per batch on the device
+
+
+#if defined(PERFECT_HAVE_OPENCL)
+
+const cl_ulong  cGpuChunk = 0x00400000;         // divisors per candidate per launch
+const size_t    cGpuLocal = 256;                // work items per group, at most
+const cl_uint   cGpuItemDivisors = 64;          // divisors per work item per launch
+
+static const char   cGpuSource[] =
+    "__kernel void divisor_sums(__global const ulong* values, __global const ulong* limits,\n"
+    "    ulong first, ulong chunk, uint groupsPer, __global ulong* partials,\n"
+    "    __local ulong* lows, __local ulong* highs)\n"
+    "{\n"
+    "    uint    group = get_group_id(0), item = get_local_id(0), size = get_local_size(0);\n"
+    "    uint    which = group / groupsPer, slice = group % groupsPer;\n"
+    "    ulong   value = values[which], limit = limits[which];\n"
+    "    ulong   sliceSize = (chunk + groupsPer - 1) / groupsPer;\n"
+    "    ulong   start = first + slice * sliceSize, end = start + sliceSize - 1;\n"
+    "    ulong   low = 0, high = 0, divisor, factor;\n"
+    "\n"
+    "    if (end > first + chunk - 1)\n"
+    "        end = first + chunk - 1;\n"
+    "    if (end > limit)\n"
+    "        end = limit;\n"
+    "    for (divisor = start + item; divisor <= end; divisor += size)\n"
+    "    {\n"
+    "        if (value % divisor != 0)\n"
+    "            continue;\n"
+    "        low += divisor;\n"
+    "        high += (low < divisor);\n"
+    "        factor = value / divisor;\n"
+    "        if (factor != divisor)\n"
+    "        {\n"
+    "            low += factor;\n"
+    "            high += (low < factor);\n"
+    "        }\n"
+    "    }\n"
+    "\n"
+    "    lows[item] = low;\n"
+    "    highs[item] = high;\n"
+    "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "    for (uint stride = size / 2; stride > 0; stride /= 2)\n"
+    "    {\n"
+    "        if (item < stride)\n"
+    "        {\n"
+    "            ulong   add = lows[item + stride];\n"
+    "\n"
+    "            lows[item] += add;\n"
+    "            highs[item] += highs[item + stride] + (lows[item] < add);\n"
+    "        }\n"
+    "        barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "    }\n"
+    "\n"
+    "    if (item == 0)\n"
+    "    {\n"
+    "        partials[2 * group] = lows[0];\n"
+    "        partials[2 * group + 1] = highs[0];\n"
+    "    }\n"
+    "}\n";
+
+
+// The one device, shared by every caller; GpuLock serializes the batches.
+struct GpuDevice
+{
+    std::atomic<bool>   ready;                  // cleared for good if the device fails
+    cl_context          context;
+    cl_command_queue    compute;                // runs the kernel
+    cl_command_queue    transfer;               // moves the buffers
+    cl_program          program;
+    cl_kernel           kernel;
+    size_t              local;                  // work items per group, a power of two
+    char                name[128];
+};
+
+static GpuDevice        Gpu;
+static std::once_flag   GpuStarted;
+static std::mutex       GpuLock;
+
+static void     StartGpu(void);
+static bool     GpuBatch(const uint64_t* values, size_t count, PerfectVerdict* verdicts, uint64_t* divisors);
+
+
+/*
+    The first GPU of any platform, else the first device of any kind,
+    with the kernel built for it.
+*/
+static void StartGpu(void)
+{
+    cl_platform_id  platforms[8];
+    cl_uint         numPlatforms = 0;
+    cl_device_id    device = nullptr;
+    cl_int          error;
+    const char*     source = cGpuSource;
+    size_t          largest = 0;
+
+    if (clGetPlatformIDs(8, platforms, &numPlatforms) != CL_SUCCESS || numPlatforms == 0)
+        return;
+    if (numPlatforms > 8)
+        numPlatforms = 8;
+
+    for (cl_uint index = 0; index < numPlatforms && device == nullptr; index++)
+        if (clGetDeviceIDs(platforms[index], CL_DEVICE_TYPE_GPU, 1, &device, nullptr) != CL_SUCCESS)
+            device = nullptr;
+    for (cl_uint index = 0; index < numPlatforms && device == nullptr; index++)
+        if (clGetDeviceIDs(platforms[index], CL_DEVICE_TYPE_ALL, 1, &device, nullptr) != CL_SUCCESS)
+            device = nullptr;
+    if (device == nullptr)
+        return;
+
+    Gpu.context = clCreateContext(nullptr, 1, &device, nullptr, nullptr, &error);
+    if (error != CL_SUCCESS)
+        return;
+    Gpu.compute = clCreateCommandQueue(Gpu.context, device, 0, &error);
+    if (error == CL_SUCCESS)
+        Gpu.transfer = clCreateCommandQueue(Gpu.context, device, 0, &error);
+    if (error == CL_SUCCESS)
+        Gpu.program = clCreateProgramWithSource(Gpu.context, 1, &source, nullptr, &error);
+    if (error == CL_SUCCESS)
+        error = clBuildProgram(Gpu.program, 1, &device, "", nullptr, nullptr);
+    if (error == CL_SUCCESS)
+        Gpu.kernel = clCreateKernel(Gpu.program, "divisor_sums", &error);
+    if (error == CL_SUCCESS)
+        error = clGetKernelWorkGroupInfo(Gpu.kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(largest), &largest, nullptr);
+    if (error != CL_SUCCESS || largest == 0)
+        return;
+
+    // the reduction halves the group, so it must be a power of two
+    for (Gpu.local = 1; Gpu.local * 2 <= largest && Gpu.local * 2 <= cGpuLocal; Gpu.local *= 2)
+        ;
+    if (clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(Gpu.name), Gpu.name, nullptr) != CL_SUCCESS)
+        Gpu.name[0] = '\0';
+    Gpu.name[sizeof(Gpu.name) - 1] = '\0';
+    Gpu.ready = true;
+}
+
+
+bool gpu_available(void)
+{
+    std::call_once(GpuStarted, StartGpu);
+
+    return Gpu.ready;
+}
+
+
+const char* gpu_device_name(void)
+{
+    return gpu_available() ? Gpu.name : "none";
+}
+
+
+/*
+    One batch of at most cGpuBatch candidates, each at least 2.  Returns
+    false, leaving the verdicts to the caller, if the device failed.
+*/
+static bool GpuBatch(const uint64_t* values, size_t count, PerfectVerdict* verdicts, uint64_t* divisors)
+{
+    std::lock_guard<std::mutex> guard(GpuLock);
+    cl_uint             groupsPer = (cl_uint)(cGpuChunk / (Gpu.local * cGpuItemDivisors));
+    size_t              global = count * groupsPer * Gpu.local, partialCount = count * groupsPer * 2;
+    std::vector<cl_ulong> limits(count), sums(count, 1), partials[2];
+    std::vector<bool>   open(count, true);
+    cl_mem              valueBuffer, limitBuffer, partialBuffer[2];
+    cl_event            launched[2], read[2], written = nullptr;
+    cl_ulong            first = 2, chunk = cGpuChunk, highest = 0;
+    cl_int              error;
+    size_t              left = count;
+    bool                pending[2] = { false, false };
+    bool                failed = false;
+
+    for (size_t index = 0; index < count; index++)
+    {
+        limits[index] = isqrt<uint64_t>(values[index]);
+        if (limits[index] > highest)
+            highest = limits[index];
+    }
+
+    valueBuffer = clCreateBuffer(Gpu.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                    count * sizeof(cl_ulong), (void*)values, &error);
+    limitBuffer = clCreateBuffer(Gpu.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                    count * sizeof(cl_ulong), limits.data(), &error);
+    for (int side = 0; side < 2; side++)
+    {
+        partials[side].resize(partialCount);
+        partialBuffer[side] = clCreateBuffer(Gpu.context, CL_MEM_WRITE_ONLY, partialCount * sizeof(cl_ulong), nullptr, &error);
+    }
+    if (valueBuffer == nullptr || limitBuffer == nullptr || partialBuffer[0] == nullptr || partialBuffer[1] == nullptr)
+        failed = true;
+
+    // the launch for divisors launchFirst.. onto side, its read-back behind it
+    auto launch = [&](int side, cl_ulong launchFirst) -> bool
+    {
+        cl_uint     waits = (written != nullptr) ? 1 : 0;
+
+        error = clSetKernelArg(Gpu.kernel, 0, sizeof(cl_mem), &valueBuffer);
+        error |= clSetKernelArg(Gpu.kernel, 1, sizeof(cl_mem), &limitBuffer);
+        error |= clSetKernelArg(Gpu.kernel, 2, sizeof(cl_ulong), &launchFirst);
+        error |= clSetKernelArg(Gpu.kernel, 3, sizeof(cl_ulong), &chunk);
+        error |= clSetKernelArg(Gpu.kernel, 4, sizeof(cl_uint), &groupsPer);
+        error |= clSetKernelArg(Gpu.kernel, 5, sizeof(cl_mem), &partialBuffer[side]);
+        error |= clSetKernelArg(Gpu.kernel, 6, Gpu.local * sizeof(cl_ulong), nullptr);
+        error |= clSetKernelArg(Gpu.kernel, 7, Gpu.local * sizeof(cl_ulong), nullptr);
+        if (error != CL_SUCCESS
+            || clEnqueueNDRangeKernel(Gpu.compute, Gpu.kernel, 1, nullptr, &global, &Gpu.local,
+                    waits, waits ? &written : nullptr, &launched[side]) != CL_SUCCESS)
+            return false;
+        clFlush(Gpu.compute);
+
+        pending[side] = (clEnqueueReadBuffer(Gpu.transfer, partialBuffer[side], CL_FALSE, 0,
+                            partialCount * sizeof(cl_ulong), partials[side].data(),
+                            1, &launched[side], &read[side]) == CL_SUCCESS);
+        clFlush(Gpu.transfer);
+        return pending[side];
+    };
+
+    if (!failed && !launch(0, first))
+        failed = true;
+
+    for (int side = 0; !failed && left > 0; side ^= 1, first += chunk)
+    {
+        cl_ulong    next = first + chunk;
+        bool        retired = false;
+
+        // the next chunk goes on while this one comes back
+        if (next <= highest && !launch(side ^ 1, next))
+            failed = true;
+        if (failed || clWaitForEvents(1, &read[side]) != CL_SUCCESS)
+        {
+            failed = true;
+            break;
+        }
+        clReleaseEvent(launched[side]);
+        clReleaseEvent(read[side]);
+        pending[side] = false;
+
+        for (size_t index = 0; index < count; index++)
+        {
+            cl_ulong    value = values[index], sum = sums[index], limit = limits[index];
+            bool        abundant = false;
+
+            if (!open[index])
+                continue;
+
+            for (cl_uint group = 0; group < groupsPer && !abundant; group++)
+            {
+                cl_ulong    low = partials[side][2 * (index * groupsPer + group)];
+                cl_ulong    high = partials[side][2 * (index * groupsPer + group) + 1];
+
+                if (high != 0 || low > value - sum)
+                    abundant = true;
+                else
+                    sum += low;
+            }
+            sums[index] = sum;
+            if (divisors != nullptr)
+                *divisors += (first + chunk - 1 <= limit) ? chunk : limit - first + 1;
+
+            if (abundant)
+                verdicts[index] = cVerdictAbundant;
+            else if (first + chunk - 1 >= limit)
+                verdicts[index] = (sum == value) ? cVerdictPerfect : cVerdictShort;
+            else if (cannot_reach<uint64_t>(value, sum, first + chunk, limit))
+                verdicts[index] = cVerdictDeficient;
+            else
+                continue;
+
+            open[index] = false;
+            limits[index] = 0;
+            retired = true;
+            left--;
+        }
+
+        // the launches after the one in flight skip the settled candidates;
+        // the new limits wait for it to finish with the old ones
+        if (retired && left > 0)
+        {
+            cl_uint     waits = pending[side ^ 1] ? 1 : 0;
+
+            if (written != nullptr)
+                clReleaseEvent(written);
+            written = nullptr;
+            if (clEnqueueWriteBuffer(Gpu.transfer, limitBuffer, CL_FALSE, 0, count * sizeof(cl_ulong),
+                    limits.data(), waits, waits ? &launched[side ^ 1] : nullptr, &written) != CL_SUCCESS)
+                failed = true;
+            clFlush(Gpu.transfer);
+        }
+    }
+
+    // let whatever is still in flight land before the buffers go
+    clFinish(Gpu.compute);
+    clFinish(Gpu.transfer);
+    for (int side = 0; side < 2; side++)
+    {
+        if (pending[side])
+        {
+            clReleaseEvent(launched[side]);
+            clReleaseEvent(read[side]);
+        }
+        if (partialBuffer[side] != nullptr)
+            clReleaseMemObject(partialBuffer[side]);
+    }
+    if (written != nullptr)
+        clReleaseEvent(written);
+    if (valueBuffer != nullptr)
+        clReleaseMemObject(valueBuffer);
+    if (limitBuffer != nullptr)
+        clReleaseMemObject(limitBuffer);
+
+    if (failed)
+        Gpu.ready = false;
+    return !failed;
+}
+
+#else
+
+bool gpu_available(void)
+{
+    return false;
+}
+
+
+const char* gpu_device_name(void)
+{
+    return "none";
+}
+
+#endif
+
+
+/*
+    The values the device can take go to it in batches; the rest, and
+    every value if there is no device, are divided on the CPU.
+*/
+template <typename T>
+void gpu_verdicts(const T* values, size_t count, PerfectVerdict* verdicts, uint64_t* divisors)
+{
+    std::vector<size_t>     batch;
+
+    for (size_t index = 0; index < count; index++)
+    {
+        if (!gpu_available() || values[index] < 2 || values[index] > (T)UINT64_MAX)
+            verdicts[index] = trial_verdict<T>(values[index], cEngineSimd, divisors);
+        else
+            batch.push_back(index);
+    }
+
+#if defined(PERFECT_HAVE_OPENCL)
+    for (size_t start = 0; start < batch.size(); start += cGpuBatch)
+    {
+        size_t                      size = (batch.size() - start < cGpuBatch) ? batch.size() - start : cGpuBatch;
+        std::vector<uint64_t>       narrow(size);
+        std::vector<PerfectVerdict> settled(size);
+
+        for (size_t index = 0; index < size; index++)
+            narrow[index] = (uint64_t)values[batch[start + index]];
+
+        if (gpu_available() && GpuBatch(narrow.data(), size, settled.data(), divisors))
+        {
+            for (size_t index = 0; index < size; index++)
+                verdicts[batch[start + index]] = settled[index];
+        }
+        else
+        {
+            for (size_t index = 0; index < size; index++)
+                verdicts[batch[start + index]] = trial_verdict<T>(values[batch[start + index]], cEngineSimd, divisors);
+        }
+    }
+#endif
+}
+
+
+template <typename T>
+bool is_perfect_gpu(T value)
+{
+    PerfectVerdict  verdict;
+
+    gpu_verdicts<T>(&value, 1, &verdict);
+    return verdict == cVerdictPerfect;
+}
+
+
+// the instantiations PerfectLib provides
+template void   gpu_verdicts<uint32_t>(const uint32_t*, size_t, PerfectVerdict*, uint64_t*);
+template void   gpu_verdicts<uint64_t>(const uint64_t*, size_t, PerfectVerdict*, uint64_t*);
+template bool   is_perfect_gpu<uint32_t>(uint32_t);
+template bool   is_perfect_gpu<uint64_t>(uint64_t);
+#if defined(__SIZEOF_INT128__)
+template void   gpu_verdicts<uint128_t>(const uint128_t*, size_t, PerfectVerdict*, uint64_t*);
+template bool   is_perfect_gpu<uint128_t>(uint128_t);
+#endif
@@ -0,0 +1,1125 @@
+/*
+    LoopForPerfects.cpp -- The 2^x - 2^y candidate sweep (the PerfectSweep
+    library).
+
+    Each band of hiPower is handed to the narrowest candidate type that
+    can hold it, so the small bands never pay for wide arithmetic.  The
+    parallel sweep spreads the candidates over a work-stealing pool, and a
+    candidate with a long divisor range is itself split into pieces that
+    idle workers can steal.  The GPU and row engines take a whole loPower
+    row per call instead.  Past the bands, the Lucas-Lehmer engine goes on
+    with one Euclid pair per Mersenne exponent, up to lastExponent.  The
+    engines that classify by dividing take hiPower up to cTablePower from
+    the compile-time table instead.  The staged sweep runs the same
+    candidates through a pipeline of threads and bounded queues, so the
+    filters, the engine and the listener each go at their own pace.
+*/
+#include "LoopForPerfects.h"
+#include "NodeLocal.h"
+#include "PerfectTable.h"
+#include "Scratch.h"
+#include "StageQueue.h"
+#include "ThreadPool.h"
+#include "Wheel.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+const unsigned  cSplitDivisors = 0x00100000;    // split candidates with more divisors than this
+const unsigned  cMaxPieces = 0x00001000;        // ...into at most this many pieces
+
+
+static inline bool Stopped(const SweepOptions& options);
+static inline uint64_t Nanoseconds(void);
+static void     Count(const SweepOptions& options, unsigned hiPower, unsigned worker,
+                    uint64_t tested, uint64_t divisors, bool early, uint64_t nanoseconds);
+static unsigned StartLoPower(const SweepOptions& options, unsigned hiPower);
+static bool     Prefiltered(const SweepOptions& options, unsigned hiPower, unsigned loPower, unsigned worker);
+template <typename T>
+static bool     SweepBand(const SweepOptions& options, SweepListener& listener,
+                    unsigned firstPower, unsigned lastPower);
+template <typename T>
+static bool     SweepRow(const SweepOptions& options, SweepListener& listener, unsigned hiPower);
+template <typename T>
+static bool     SweepBandParallel(const SweepOptions& options, SweepListener& listener,
+                    WorkStealingPool& pool, unsigned firstPower, unsigned lastPower);
+static bool     SweepTable(const SweepOptions& options, SweepListener& listener,
+                    unsigned firstPower, unsigned lastPower);
+static unsigned FirstExponent(const SweepOptions& options);
+static PerfectVerdict TestExponent(const SweepOptions& options, unsigned exponent, unsigned worker);
+static bool     SweepMersennes(const SweepOptions& options, SweepListener& listener, WorkStealingPool* pool);
+static PerfectVerdict FilterVerdict(PerfectEngine engine, unsigned hiPower, unsigned loPower);
+template <typename T>
+static bool     SweepBandStaged(const SweepOptions& options, SweepListener& listener,
+                    unsigned firstPower, unsigned lastPower);
+static void     Backoff(unsigned& spins);
+template <typename T>
+static PerfectVerdict TestCandidate(PerfectEngine engine, unsigned hiPower, unsigned loPower, T value,
+                    uint64_t& divisors, SigmaCache* cache);
+template <typename T>
+static bool     TestRange(PerfectEngine engine, T value, T first, T last, T& sum, const DivisorWheel& wheel);
+
+
+/*
+    Sweep every band that overlaps [firstPower, lastPower].
+*/
+bool LoopForPerfects(const SweepOptions& options, SweepListener& listener)
+{
+    unsigned    first = options.firstPower < 3 ? 3 : options.firstPower;
+    unsigned    last = options.lastPower > cMaxPower ? cMaxPower : options.lastPower;
+
+    // Lucas-Lehmer and sigma say perfect or not, which the table cannot
+    // say any faster; the others it settles without a division
+    if (options.engine != cEngineLucasLehmer && options.engine != cEngineSigma && first <= cTablePower)
+    {
+        if (!SweepTable(options, listener, first, last < cTablePower ? last : cTablePower))
+            return false;
+        first = cTablePower + 1;
+    }
+
+    if (options.pipeline != nullptr && options.engine != cEngineGpu && options.engine != cEngineRow)
+    {
+        if (!SweepBandStaged<uint32_t>(options, listener, first, last < 32 ? last : 32)
+            || !SweepBandStaged<uint64_t>(options, listener, first > 33 ? first : 33, last < 64 ? last : 64)
+#if defined(__SIZEOF_INT128__)
+            || !SweepBandStaged<uint128_t>(options, listener, first > 65 ? first : 65, last)
+#endif
+            )
+            return false;
+        if (options.lastExponent == 0)
+            return true;
+
+        WorkStealingPool    pool(options.numThreads, options.places);
+
+        return SweepMersennes(options, listener, &pool);
+    }
+
+    if (options.numThreads && options.engine != cEngineGpu)
+    {
+        WorkStealingPool    pool(options.numThreads, options.places);
+
+        return SweepBandParallel<uint32_t>(options, listener, pool, first, last < 32 ? last : 32)
+            && SweepBandParallel<uint64_t>(options, listener, pool, first > 33 ? first : 33, last < 64 ? last : 64)
+#if defined(__SIZEOF_INT128__)
+            && SweepBandParallel<uint128_t>(options, listener, pool, first > 65 ? first : 65, last)
+#endif
+            && SweepMersennes(options, listener, &pool);
+    }
+
+    return SweepBand<uint32_t>(options, listener, first, last < 32 ? last : 32)
+        && SweepBand<uint64_t>(options, listener, first > 33 ? first : 33, last < 64 ? last : 64)
+#if defined(__SIZEOF_INT128__)
+        && SweepBand<uint128_t>(options, listener, first > 65 ? first : 65, last)
+#endif
+        && SweepMersennes(options, listener, nullptr);
+}
+
+
+/*
+    The stop flag is only ever set, and a candidate more or less before
+    stopping does no harm, so a relaxed load is all it takes.
+*/
+static inline bool Stopped(const SweepOptions& options)
+{
+    return options.stop != nullptr && options.stop->load(std::memory_order_relaxed);
+}
+
+
+static inline uint64_t Nanoseconds(void)
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+/*
+    Add a candidate, or a piece of one, to its band's counters and to the
+    worker's.  Relaxed adds: the counters are only ever read as a whole
+    for a report.
+*/
+static void Count(const SweepOptions& options, unsigned hiPower, unsigned worker,
+    uint64_t tested, uint64_t divisors, bool early, uint64_t nanoseconds)
+{
+    SweepCounters*  counters[2];
+    int             count = 0;
+
+    if (options.stats == nullptr)
+        return;
+
+    counters[count++] = &options.stats->workers[worker < cMaxStatsThreads ? worker : cMaxStatsThreads - 1];
+    if (hiPower <= cMaxPower)
+        counters[count++] = &options.stats->bands[hiPower];
+    for (int index = 0; index < count; index++)
+    {
+        counters[index]->tested.fetch_add(tested, std::memory_order_relaxed);
+        counters[index]->divisors.fetch_add(divisors, std::memory_order_relaxed);
+        counters[index]->earlyExits.fetch_add(early ? 1 : 0, std::memory_order_relaxed);
+        counters[index]->nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+
+/*
+    The loPower a hiPower's sweep starts from: every pair, unless this is
+    the first hiPower of a resumed sweep.
+*/
+static unsigned StartLoPower(const SweepOptions& options, unsigned hiPower)
+{
+    if (hiPower == options.firstPower && options.firstLoPower > 0 && options.firstLoPower < hiPower)
+        return options.firstLoPower;
+
+    return hiPower - 1;
+}
+
+
+/*
+    With SweepOptions::prefilter, true when prefilter_pair() rules the
+    pair out, which the caller reports as rejected.  Either way the pair
+    is counted under the step that settled it; a rejected one is also
+    counted as tested, with no divisors.
+*/
+static bool Prefiltered(const SweepOptions& options, unsigned hiPower, unsigned loPower, unsigned worker)
+{
+    PrefilterResult     result;
+    uint64_t            start;
+
+    if (!options.prefilter)
+        return false;
+
+    start = Nanoseconds();
+    result = prefilter_pair(hiPower, loPower);
+    if (options.stats != nullptr)
+        options.stats->prefilter[result].fetch_add(1, std::memory_order_relaxed);
+    if (result == cPrefilterPassed)
+        return false;
+
+    Count(options, hiPower, worker, 1, 0, false, Nanoseconds() - start);
+    return true;
+}
+
+
+/*
+    hiPower from firstPower to lastPower out of the table: nothing to
+    time, and no divisors.
+*/
+static bool SweepTable(const SweepOptions& options, SweepListener& listener,
+    unsigned firstPower, unsigned lastPower)
+{
+    for (unsigned hiPower = firstPower; hiPower <= lastPower; hiPower++)
+    {
+        if (Stopped(options) || listener.Poll())
+            return false;
+
+        for (unsigned loPower = StartLoPower(options, hiPower); loPower > 0; loPower--)
+        {
+            Count(options, hiPower, 0, 1, 0, false, 0);
+            listener.Tested(hiPower, loPower, pair_value<PerfectValue>(hiPower, loPower),
+                table_verdict(hiPower, loPower));
+        }
+    }
+
+    return true;
+}
+
+
+/*
+    The first Mersenne exponent past the bands, p with 2p - 1 at
+    firstPower or past it.  Its band of a resumed sweep is done once the
+    position is below the Euclid pair, loPower p - 1.
+*/
+static unsigned FirstExponent(const SweepOptions& options)
+{
+    unsigned    hiPower = (options.firstPower > cMaxPower) ? options.firstPower : cMaxPower + 1;
+    unsigned    exponent = (hiPower + 2) / 2;
+
+    if (hiPower == options.firstPower && hiPower == 2 * exponent - 1
+        && options.firstLoPower > 0 && options.firstLoPower < exponent - 1)
+        exponent++;
+
+    return exponent;
+}
+
+
+static PerfectVerdict TestExponent(const SweepOptions& options, unsigned exponent, unsigned worker)
+{
+    uint64_t        start = Nanoseconds();
+    PerfectVerdict  verdict = is_perfect_pair(2 * exponent - 1, exponent - 1) ? cVerdictPerfect : cVerdictRejected;
+
+    Count(options, 2 * exponent - 1, worker, 1, 0, false, Nanoseconds() - start);
+    return verdict;
+}
+
+
+/*
+    The Mersenne exponents past the bands, with the Lucas-Lehmer engine.
+    Only the Euclid pair of a band can be perfect, so each exponent is one
+    candidate, reported as its pair with a value of 0: it does not fit
+    PerfectValue.  On a pool every exponent is a task, and they are
+    reported from the front as they finish, as a parallel band is.
+*/
+static bool SweepMersennes(const SweepOptions& options, SweepListener& listener, WorkStealingPool* pool)
+{
+    unsigned    first = FirstExponent(options);
+
+    if (options.engine != cEngineLucasLehmer || options.lastExponent < first)
+        return true;
+
+    if (pool == nullptr)
+    {
+        for (unsigned exponent = first; exponent <= options.lastExponent; exponent++)
+        {
+            if (Stopped(options) || listener.Poll())
+                return false;
+            listener.Tested(2 * exponent - 1, exponent - 1, 0, TestExponent(options, exponent, 0));
+        }
+        return true;
+    }
+
+    size_t                      count = options.lastExponent - first + 1, reported = 0;
+    std::vector<PerfectVerdict> verdicts(count, cVerdictRejected);
+    std::vector<bool>           done(count, false);
+    std::mutex                  reportLock;             // guards verdicts, done, reported and the listener
+    std::atomic<bool>           cancel(false);
+
+    for (size_t which = 0; which < count; which++)
+    {
+        pool->Submit([&, which]
+        {
+            if (cancel || Stopped(options))
+                return;
+
+            PerfectVerdict  verdict = TestExponent(options, first + (unsigned)which, pool->WorkerIndex());
+            std::lock_guard<std::mutex> guard(reportLock);
+
+            verdicts[which] = verdict;
+            done[which] = true;
+            for (; reported < count && done[reported]; reported++)
+                listener.Tested(2 * (first + (unsigned)reported) - 1, first + (unsigned)reported - 1, 0,
+                    verdicts[reported]);
+        });
+    }
+
+    while (!pool->WaitFor(100))
+        if (!cancel && (Stopped(options) || listener.Poll()))
+            cancel = true;
+
+    return !cancel && !Stopped(options);
+}
+
+
+/*
+    Test one whole candidate with the chosen engine, adding the trial
+    divisors it tried to divisors.
+*/
+template <typename T>
+static PerfectVerdict TestCandidate(PerfectEngine engine, unsigned hiPower, unsigned loPower, T value,
+    uint64_t& divisors, SigmaCache* cache)
+{
+    if (engine == cEngineLucasLehmer)
+        return is_perfect_pair(hiPower, loPower) ? cVerdictPerfect : cVerdictRejected;
+    if (engine == cEngineSigma)
+        return is_perfect_sigma<T>(value) ? cVerdictPerfect : cVerdictRejected;
+    if (engine == cEngineGpu)
+    {
+        PerfectVerdict  verdict;
+
+        gpu_verdicts<T>(&value, 1, &verdict, &divisors);
+        return verdict;
+    }
+    if (engine == cEngineRow)
+        return pair_verdict<T>(hiPower, loPower, &divisors, cache);
+
+    return trial_verdict<T>(value, engine, &divisors);
+}
+
+
+/*
+    One piece of a trial-division candidate with the chosen kernel, on
+    the candidate's wheel.
+*/
+template <typename T>
+static bool TestRange(PerfectEngine engine, T value, T first, T last, T& sum, const DivisorWheel& wheel)
+{
+    if (engine == cEngineSimd)
+        return divisor_sum_range_simd<T>(value, first, last, sum, wheel);
+    if (engine == cEngineReciprocal)
+        return divisor_sum_range_reciprocal<T>(value, first, last, sum, wheel);
+
+    return divisor_sum_range<T>(value, first, last, sum, wheel);
+}
+
+
+/*
+    Serial sweep of hiPower from firstPower to lastPower (inclusive) using
+    candidate type T.
+*/
+template <typename T>
+static bool SweepBand(const SweepOptions& options, SweepListener& listener,
+    unsigned firstPower, unsigned lastPower)
+{
+    for (unsigned hiPower = firstPower; hiPower <= lastPower; hiPower++)
+    {
+        if (options.engine == cEngineGpu || options.engine == cEngineRow)
+        {
+            if (!SweepRow<T>(options, listener, hiPower))
+                return false;
+            continue;
+        }
+
+        for (unsigned loPower = StartLoPower(options, hiPower); loPower > 0; loPower--)
+        {
+            T               value = pair_value<T>(hiPower, loPower);
+            uint64_t        divisors = 0, start;
+            PerfectVerdict  verdict;
+
+            // give the controller and the listener their chance to stop us
+            if (Stopped(options) || listener.Poll())
+                return false;
+
+            if (Prefiltered(options, hiPower, loPower, 0))
+            {
+                listener.Tested(hiPower, loPower, value, cVerdictRejected);
+                continue;
+            }
+
+            start = Nanoseconds();
+            verdict = TestCandidate<T>(options.engine, hiPower, loPower, value, divisors, options.cache);
+            Count(options, hiPower, 0, 1, divisors,
+                verdict == cVerdictAbundant || verdict == cVerdictDeficient, Nanoseconds() - start);
+
+            listener.Tested(hiPower, loPower, value, verdict);
+        }
+    }
+
+    return true;
+}
+
+
+/*
+    Every loPower of one hiPower in a single batch, on the GPU or by
+    row_verdicts().  The stop flag is looked at once per row; the row's
+    time and divisors go to its first candidate.  The batch is on the
+    thread's scratch.
+*/
+template <typename T>
+static bool SweepRow(const SweepOptions& options, SweepListener& listener, unsigned hiPower)
+{
+    unsigned                    start = StartLoPower(options, hiPower);
+    ScratchScope                scope;
+    T*                          values = scope.Arena().Take<T>(start);
+    PerfectVerdict*             verdicts = scope.Arena().Take<PerfectVerdict>(start);
+    uint64_t                    divisors = 0, begin;
+
+    if (Stopped(options) || listener.Poll())
+        return false;
+
+    for (unsigned loPower = start; loPower > 0; loPower--)
+        values[start - loPower] = pair_value<T>(hiPower, loPower);
+
+    begin = Nanoseconds();
+    if (options.engine == cEngineGpu)
+        gpu_verdicts<T>(values, start, verdicts, &divisors);
+    else
+        row_verdicts<T>(hiPower, start, verdicts, &divisors, options.cache);
+    begin = Nanoseconds() - begin;
+
+    for (unsigned index = 0; index < start; index++)
+    {
+        PerfectVerdict  verdict = verdicts[index];
+
+        Count(options, hiPower, 0, 1, index ? 0 : divisors,
+            verdict == cVerdictAbundant || verdict == cVerdictDeficient, index ? 0 : begin);
+        listener.Tested(hiPower, start - index, values[index], verdict);
+    }
+
+    return true;
+}
+
+
+/*
+    One candidate of a parallel sweep.  A candidate with more than
+    cSplitDivisors divisors to try is cut into pieces; each piece adds its
+    partial sum under the lock, and the last piece to finish settles it.
+    The pieces finish in any order, so a piece divides cVerdictChunk at a
+    time from a chunk boundary and keeps the check of its own boundaries
+    that comes nearest to failing; once every piece before it is done,
+    the sum in front of it is known and that one check decides, exactly
+    as trial_verdict() would have.  The verdict never depends on the
+    number of threads.
+*/
+template <typename T>
+struct SweepPiece
+{
+    T                   partial;                // its divisors
+    T                   at;                     // its tightest deficiency check, before at; 0 for none
+    T                   atPartial;              // ...and its divisors below at
+    bool                finished;
+};
+
+
+template <typename T>
+struct SweepCandidate
+{
+    unsigned            hiPower;
+    unsigned            loPower;
+    T                   value;
+    T                   limit;                  // highest divisor to try
+    const DivisorWheel* wheel;                  // the spokes worth trying
+    T                   pieceSize;              // divisors per piece
+    unsigned            pieces;
+    std::mutex          lock;                   // guards the sums and the pieces done
+    T                   sum;                    // divisors found so far
+    T                   frontSum;               // ...by the pieces before front
+    unsigned            front;                  // the first piece not yet done
+    std::vector<SweepPiece<T> > results;        // by piece
+    std::atomic<bool>   abundant;               // sum already passed value
+    std::atomic<bool>   deficient;              // the divisors left cannot make up value
+    std::atomic<unsigned> piecesLeft;
+    std::atomic<bool>   done;
+    PerfectVerdict      verdict;
+};
+
+
+/*
+    The shared state of one band of a parallel sweep.  Candidates are kept
+    in sweep order, which is ascending order.  They are claimed in that
+    order by feeder tasks, one per worker, and reported from the front as
+    soon as they are done, so output order never depends on timing.
+
+    On a pool of several nodes the candidates are dealt out to the nodes
+    in turn, candidate i to node i % nodes, and a feeder claims those of
+    its own node first; only once they are all claimed does it take from
+    the next node along, and still in order.
+*/
+template <typename T>
+struct ParallelBand
+{
+    const SweepOptions* options;
+    SweepListener*      listener;
+    WorkStealingPool*   pool;
+    std::vector<SweepCandidate<T> > candidates;
+    std::atomic<size_t> next[cMaxNodes];        // by node: how many of its candidates are claimed
+    unsigned            nodes;
+    std::atomic<bool>   cancel;                 // the listener asked us to stop
+    std::mutex          reportLock;             // guards reported and the listener
+    size_t              reported;
+
+    ParallelBand(const SweepOptions& sweepOptions, SweepListener& sweepListener,
+        WorkStealingPool& workers, size_t count)
+        : options(&sweepOptions), listener(&sweepListener), pool(&workers),
+          candidates(count), nodes(workers.NumNodes() < cMaxNodes ? workers.NumNodes() : cMaxNodes),
+          cancel(false), reported(0)
+    {
+        for (unsigned node = 0; node < cMaxNodes; node++)
+            next[node] = 0;
+    }
+
+    size_t  Claim(unsigned node);
+    void    Feed(void);
+    void    Test(size_t which);
+    void    TestPiece(size_t which, unsigned piece);
+    void    Finish(size_t which, PerfectVerdict verdict);
+};
+
+
+/*
+    Sweep hiPower from firstPower to lastPower on the pool.  The calling
+    thread only polls the listener while the workers run.
+*/
+template <typename T>
+static bool SweepBandParallel(const SweepOptions& options, SweepListener& listener,
+    WorkStealingPool& pool, unsigned firstPower, unsigned lastPower)
+{
+    size_t      count = 0, which = 0;
+
+    for (unsigned power = firstPower; power <= lastPower; power++)
+        count += StartLoPower(options, power);
+    if (count == 0)
+        return true;
+
+    ParallelBand<T>     band(options, listener, pool, count);
+
+    for (unsigned power = firstPower; power <= lastPower; power++)
+    {
+        for (unsigned lower = StartLoPower(options, power); lower > 0; lower--, which++)
+        {
+            SweepCandidate<T>&  candidate = band.candidates[which];
+
+            candidate.hiPower = power;
+            candidate.loPower = lower;
+            candidate.value = pair_value<T>(power, lower);
+            candidate.abundant = false;
+            candidate.deficient = false;
+            candidate.done = false;
+            candidate.verdict = cVerdictShort;
+        }
+    }
+
+    for (unsigned worker = 0; worker < pool.NumThreads(); worker++)
+        pool.Submit([&band] { band.Feed(); });
+
+    while (!pool.WaitFor(100))
+        if (!band.cancel && (Stopped(options) || listener.Poll()))
+            band.cancel = true;
+
+    // the feeders may have seen the stop flag before we did
+    return !band.cancel && !Stopped(options);
+}
+
+
+/*
+    The next candidate of node, or of the nodes after it; past the end
+    when every one is claimed.
+*/
+template <typename T>
+size_t ParallelBand<T>::Claim(unsigned node)
+{
+    for (unsigned offset = 0; offset < nodes; offset++)
+    {
+        unsigned    from = (node + offset) % nodes;
+        size_t      which = next[from]++ * nodes + from;
+
+        if (which < candidates.size())
+            return which;
+    }
+
+    return candidates.size();
+}
+
+
+/*
+    Claim the next candidate, leave a feeder behind for the one after, and
+    test it.  The feeder sits below the candidate's own pieces on this
+    worker's deque, so a thief picks up a new candidate before it starts
+    helping with the pieces of this one.
+*/
+template <typename T>
+void ParallelBand<T>::Feed(void)
+{
+    size_t      which = Claim(pool->NodeOf(pool->WorkerIndex()) % nodes);
+
+    if (which >= candidates.size() || cancel || Stopped(*options))
+        return;
+
+    pool->Submit([this] { Feed(); });
+    Test(which);
+}
+
+
+template <typename T>
+void ParallelBand<T>::Test(size_t which)
+{
+    SweepCandidate<T>&  candidate = candidates[which];
+    T                   range, pieces;
+
+    if (Prefiltered(*options, candidate.hiPower, candidate.loPower, pool->WorkerIndex()))
+    {
+        Finish(which, cVerdictRejected);
+        return;
+    }
+
+    // cut the divisors 2..limit into pieces of about cSplitDivisors
+    candidate.limit = isqrt<T>(candidate.value);
+    range = candidate.limit - 1;
+    pieces = (range + cSplitDivisors - 1) / cSplitDivisors;
+    if (pieces > cMaxPieces)
+        pieces = cMaxPieces;
+    if (pieces > 1)
+    {
+        // whole chunks, so the pieces check where trial_verdict() does
+        candidate.pieceSize = (range + pieces - 1) / pieces;
+        candidate.pieceSize += (cVerdictChunk - candidate.pieceSize % cVerdictChunk) % cVerdictChunk;
+        pieces = (range + candidate.pieceSize - 1) / candidate.pieceSize;
+    }
+
+    // the engines that do not walk a divisor range are never split, and a
+    // candidate of one piece is tested whole, with the serial sweep's exits
+    if (pieces <= 1 || options->engine == cEngineLucasLehmer || options->engine == cEngineSigma
+        || options->engine == cEngineRow)
+    {
+        uint64_t        divisors = 0, start = Nanoseconds();
+        PerfectVerdict  verdict = TestCandidate<T>(options->engine, candidate.hiPower, candidate.loPower,
+                            candidate.value, divisors, options->cache);
+
+        Count(*options, candidate.hiPower, pool->WorkerIndex(), 1, divisors,
+            verdict == cVerdictAbundant || verdict == cVerdictDeficient, Nanoseconds() - start);
+        Finish(which, verdict);
+        return;
+    }
+
+    candidate.wheel = &wheel_for<T>(candidate.value);
+    candidate.sum = 1;
+    candidate.frontSum = 1;
+    candidate.front = 0;
+    candidate.pieces = (unsigned)pieces;
+    candidate.results.assign(candidate.pieces, SweepPiece<T>());
+    candidate.piecesLeft = (unsigned)pieces;
+
+    // the pieces go on our own deque for idle workers to steal; one word
+    // of capture keeps each task within std::function's own buffer
+    for (unsigned piece = 1; piece < (unsigned)pieces; piece++)
+    {
+        size_t  task = which * cMaxPieces + piece;
+
+        pool->Submit([this, task] { TestPiece(task / cMaxPieces, (unsigned)(task % cMaxPieces)); });
+    }
+    TestPiece(which, 0);
+}
+
+
+template <typename T>
+void ParallelBand<T>::TestPiece(size_t which, unsigned piece)
+{
+    SweepCandidate<T>&  candidate = candidates[which];
+    T                   first = 2 + (T)piece * candidate.pieceSize;
+    T                   last = first + (candidate.pieceSize - 1);
+    T                   partial = 0, at = 0, atPartial = 0, tried = 0;
+    double              margin = 0;
+    bool                within = true;
+    uint64_t            start = Nanoseconds();
+    PerfectVerdict      verdict;
+
+    if (cancel)
+        return;
+
+    if (last > candidate.limit || last < first)
+        last = candidate.limit;
+
+    // a chunk at a time, keeping the check with the least room to spare;
+    // once the candidate is settled the rest of the piece is moot
+    for (T from = first; from <= last && within && !candidate.abundant && !candidate.deficient; )
+    {
+        T       to = (last - from >= cVerdictChunk) ? from + (cVerdictChunk - 1) : last;
+        T       before = partial;
+
+        within = TestRange<T>(options->engine, candidate.value, from, to, partial, *candidate.wheel);
+        tried += wheel_count<T>(*candidate.wheel, from,
+                    within ? to : abundant_exit<T>(candidate.value, from, to, before, *candidate.wheel));
+        if (within && to < candidate.limit)
+        {
+            double  room = (double)partial + reach_bound<T>(candidate.value, to + 1, candidate.limit);
+
+            if (at == 0 || room < margin)
+            {
+                margin = room;
+                at = to + 1;
+                atPartial = partial;
+            }
+        }
+        from = to + 1;
+    }
+    Count(*options, candidate.hiPower, pool->WorkerIndex(), 0, (uint64_t)tried, false, Nanoseconds() - start);
+    {
+        std::lock_guard<std::mutex> guard(candidate.lock);
+        SweepPiece<T>&              result = candidate.results[piece];
+
+        if (!within || partial > candidate.value - candidate.sum)
+            candidate.abundant = true;
+        else
+            candidate.sum += partial;
+
+        // every piece done from the front settles its own check
+        result.partial = partial;
+        result.at = at;
+        result.atPartial = atPartial;
+        result.finished = true;
+        while (candidate.front < candidate.pieces && candidate.results[candidate.front].finished)
+        {
+            const SweepPiece<T>&    done = candidate.results[candidate.front++];
+
+            if (!candidate.abundant && !candidate.deficient && done.at != 0
+                && cannot_reach<T>(candidate.value, candidate.frontSum + done.atPartial, done.at, candidate.limit))
+                candidate.deficient = true;
+            candidate.frontSum += done.partial;
+        }
+    }
+
+    if (--candidate.piecesLeft == 0)
+    {
+        verdict = candidate.abundant ? cVerdictAbundant : candidate.deficient ? cVerdictDeficient
+            : (candidate.sum == candidate.value) ? cVerdictPerfect : cVerdictShort;
+        Count(*options, candidate.hiPower, pool->WorkerIndex(), 1, 0,
+            verdict == cVerdictAbundant || verdict == cVerdictDeficient, 0);
+        Finish(which, verdict);
+    }
+}
+
+
+/*
+    Mark a candidate done and hand every finished candidate at the front
+    of the band to the listener, in order.
+*/
+template <typename T>
+void ParallelBand<T>::Finish(size_t which, PerfectVerdict verdict)
+{
+    std::lock_guard<std::mutex> guard(reportLock);
+
+    candidates[which].verdict = verdict;
+    candidates[which].done = true;
+
+    while (reported < candidates.size() && candidates[reported].done)
+    {
+        SweepCandidate<T>&  candidate = candidates[reported++];
+
+        listener->Tested(candidate.hiPower, candidate.loPower, candidate.value, candidate.verdict);
+    }
+}
+
+
+const char* stage_name(PipelineStage stage)
+{
+    static const char*  names[cStageCount] = { "filter", "test", "report" };
+
+    return ((unsigned)stage < cStageCount) ? names[stage] : "unknown";
+}
+
+
+/*
+    What the filter stage knows of 2^hiPower - 2^loPower = 2^y * m, with
+    m = 2^d - 1, without a division; cVerdictCount when it does not know.
+    Only a Euclid pair, y + 1 = d, can be perfect, so the engines that say
+    only perfect or not reject the rest outright.  For the others: with
+    d >= 2, sigma(n) >= (2^(y+1) - 1)(m + 1) = 2n + 2^(y+1) - 2^d, so a
+    pair with y + 1 > d is abundant, and a Euclid pair is abundant unless
+    m is prime, which it is not for even d past 2: 3 divides it.  The
+    verdicts are those the engine itself would return.
+*/
+static PerfectVerdict FilterVerdict(PerfectEngine engine, unsigned hiPower, unsigned loPower)
+{
+    unsigned        width = hiPower - loPower;
+    bool            yesNo = (engine == cEngineLucasLehmer || engine == cEngineSigma);
+    PerfectVerdict  composite = yesNo ? cVerdictRejected : cVerdictAbundant;
+
+    if (yesNo && loPower + 1 != width)
+        return cVerdictRejected;
+    if (width < 2 || loPower + 1 < width)
+        return cVerdictCount;
+    if (loPower + 1 > width || (width > 2 && width % 2 == 0))
+        return composite;
+
+    return cVerdictCount;
+}
+
+
+/*
+    A candidate on its way through the stages.
+*/
+template <typename T>
+struct StagedItem
+{
+    size_t          sequence;                   // its place in sweep order
+    unsigned        hiPower;
+    unsigned        loPower;
+    T               value;
+    PerfectVerdict  verdict;
+};
+
+
+/*
+    The shared state of one band of the staged sweep.  The generator
+    waits while it is window candidates ahead of the reporter, so every
+    candidate between them has a slot of its own in the reporter's ring
+    and the report queue always drains: no stage waits on one behind it.
+*/
+template <typename T>
+struct StagedBand
+{
+    const SweepOptions*         options;
+    StageCounters*              counters;       // cStageCount of them; null for none
+    unsigned                    firstPower;
+    unsigned                    lastPower;
+    size_t                      count;          // candidates in the band
+    size_t                      window;
+    unsigned                    filterThreads;
+    unsigned                    testThreads;
+    StageQueue<StagedItem<T> >  filterQueue;
+    StageQueue<StagedItem<T> >  testQueue;
+    StageQueue<StagedItem<T> >  reportQueue;
+    std::atomic<bool>           generated;      // the generator pushed its last
+    std::atomic<unsigned>       filtering;      // filter threads still at work
+    std::atomic<size_t>         reported;       // candidates handed to the listener
+    std::atomic<bool>           cancel;
+
+    StagedBand(const SweepOptions& sweepOptions, unsigned first, unsigned last, size_t candidates,
+        unsigned filters, unsigned tests)
+        : options(&sweepOptions), counters(sweepOptions.pipeline->stats ? sweepOptions.pipeline->stats->stages : nullptr),
+          firstPower(first), lastPower(last), count(candidates), window(4 * sweepOptions.pipeline->queueSlots),
+          filterThreads(filters), testThreads(tests),
+          filterQueue(sweepOptions.pipeline->queueSlots), testQueue(sweepOptions.pipeline->queueSlots),
+          reportQueue(sweepOptions.pipeline->queueSlots),
+          generated(false), filtering(filters), reported(0), cancel(false) {}
+
+    StageQueue<StagedItem<T> >& Queue(PipelineStage stage)
+    {
+        return (stage == cStageFilter) ? filterQueue : (stage == cStageTest) ? testQueue : reportQueue;
+    }
+
+    bool    Push(PipelineStage stage, const StagedItem<T>& item);
+    bool    Pop(PipelineStage stage, StagedItem<T>& item);
+    void    Generate(void);
+    void    Filter(unsigned worker);
+    void    Test(unsigned worker);
+    bool    Report(SweepListener& listener);
+};
+
+
+/*
+    Sweep hiPower from firstPower to lastPower in stages.  The calling
+    thread is the reporter, so the listener is called on it alone.
+*/
+template <typename T>
+static bool SweepBandStaged(const SweepOptions& options, SweepListener& listener,
+    unsigned firstPower, unsigned lastPower)
+{
+    const PipelineOptions&      pipeline = *options.pipeline;
+    unsigned                    filters = pipeline.filterThreads ? pipeline.filterThreads : 1;
+    unsigned                    tests = pipeline.testThreads ? pipeline.testThreads
+                                    : options.numThreads ? options.numThreads : WorkStealingPool::DefaultThreads();
+    size_t                      count = 0;
+    std::vector<std::thread>    threads;
+    bool                        done;
+
+    for (unsigned power = firstPower; power <= lastPower; power++)
+        count += StartLoPower(options, power);
+    if (count == 0)
+        return true;
+
+    StagedBand<T>   band(options, firstPower, lastPower, count, filters, tests);
+
+    threads.emplace_back([&band] { band.Generate(); });
+    for (unsigned worker = 0; worker < filters; worker++)
+        threads.emplace_back([&band, tests, worker] { band.Filter(tests + worker); });
+    for (unsigned worker = 0; worker < tests; worker++)
+        threads.emplace_back([&band, worker] { band.Test(worker); });
+
+    done = band.Report(listener);
+    band.cancel = true;                 // the stages behind a stop may still be waiting
+    for (size_t index = 0; index < threads.size(); index++)
+        threads[index].join();
+
+    return done;
+}
+
+
+/*
+    Yield for a while, then sleep: a stage with nothing to do should not
+    take a processor from one with work.
+*/
+static void Backoff(unsigned& spins)
+{
+    if (++spins < 64)
+        std::this_thread::yield();
+    else
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+
+
+// Onto a stage's queue, waiting while it is full; false if cancelled.
+template <typename T>
+bool StagedBand<T>::Push(PipelineStage stage, const StagedItem<T>& item)
+{
+    StageQueue<StagedItem<T> >& queue = Queue(stage);
+    unsigned                    spins = 0;
+
+    while (!queue.TryPush(item))
+    {
+        if (cancel.load(std::memory_order_relaxed))
+            return false;
+        if (spins == 0 && counters != nullptr)
+            counters[stage].stalls.fetch_add(1, std::memory_order_relaxed);
+        Backoff(spins);
+    }
+
+    if (counters != nullptr)
+    {
+        uint64_t    depth = queue.Depth();
+        uint64_t    peak = counters[stage].peak.load(std::memory_order_relaxed);
+
+        counters[stage].depth.store(depth, std::memory_order_relaxed);
+        while (depth > peak && !counters[stage].peak.compare_exchange_weak(peak, depth, std::memory_order_relaxed))
+            ;
+    }
+    return true;
+}
+
+
+template <typename T>
+bool StagedBand<T>::Pop(PipelineStage stage, StagedItem<T>& item)
+{
+    if (!Queue(stage).TryPop(item))
+        return false;
+
+    if (counters != nullptr)
+    {
+        counters[stage].items.fetch_add(1, std::memory_order_relaxed);
+        counters[stage].depth.store(Queue(stage).Depth(), std::memory_order_relaxed);
+    }
+    return true;
+}
+
+
+// Every candidate of the band, in sweep order, no more than window ahead.
+template <typename T>
+void StagedBand<T>::Generate(void)
+{
+    StagedItem<T>   item;
+    unsigned        spins = 0;
+
+    item.sequence = 0;
+    item.verdict = cVerdictCount;
+    for (unsigned power = firstPower; power <= lastPower; power++)
+    {
+        for (unsigned lower = StartLoPower(*options, power); lower > 0; lower--, item.sequence++)
+        {
+            while (item.sequence >= reported.load(std::memory_order_acquire) + window)
+            {
+                if (cancel.load(std::memory_order_relaxed))
+                    return;
+                Backoff(spins);
+            }
+            spins = 0;
+
+            item.hiPower = power;
+            item.loPower = lower;
+            item.value = pair_value<T>(power, lower);
+            if (!Push(cStageFilter, item))
+                return;
+        }
+    }
+
+    generated.store(true, std::memory_order_release);
+}
+
+
+/*
+    Settle what FilterVerdict(), or with SweepOptions::prefilter what
+    prefilter_pair(), can and pass the rest to the test stage.
+    The generator's last push comes before generated, so once generated
+    is seen an empty queue stays empty.
+*/
+template <typename T>
+void StagedBand<T>::Filter(unsigned worker)
+{
+    StagedItem<T>   item;
+    unsigned        spins = 0;
+
+    while (!cancel.load(std::memory_order_relaxed))
+    {
+        bool    last = generated.load(std::memory_order_acquire);
+
+        if (!Pop(cStageFilter, item))
+        {
+            if (last)
+                break;
+            Backoff(spins);
+            continue;
+        }
+        spins = 0;
+
+        if (options->prefilter)
+            item.verdict = Prefiltered(*options, item.hiPower, item.loPower, worker) ? cVerdictRejected : cVerdictCount;
+        else
+            item.verdict = FilterVerdict(options->engine, item.hiPower, item.loPower);
+        if (item.verdict == cVerdictCount)
+        {
+            if (!Push(cStageTest, item))
+                break;
+            continue;
+        }
+
+        if (counters != nullptr)
+            counters[cStageFilter].settled.fetch_add(1, std::memory_order_relaxed);
+        if (!options->prefilter)
+            Count(*options, item.hiPower, worker, 1, 0, false, 0);
+        if (!Push(cStageReport, item))
+            break;
+    }
+
+    filtering.fetch_sub(1, std::memory_order_release);
+}
+
+
+// Run the engine on each candidate the filters passed.
+template <typename T>
+void StagedBand<T>::Test(unsigned worker)
+{
+    StagedItem<T>   item;
+    unsigned        spins = 0;
+
+    while (!cancel.load(std::memory_order_relaxed))
+    {
+        bool        last = filtering.load(std::memory_order_acquire) == 0;
+        uint64_t    divisors = 0, start;
+
+        if (!Pop(cStageTest, item))
+        {
+            if (last)
+                break;
+            Backoff(spins);
+            continue;
+        }
+        spins = 0;
+
+        start = Nanoseconds();
+        item.verdict = TestCandidate<T>(options->engine, item.hiPower, item.loPower, item.value, divisors, nullptr);
+        Count(*options, item.hiPower, worker, 1, divisors,
+            item.verdict == cVerdictAbundant || item.verdict == cVerdictDeficient, Nanoseconds() - start);
+        if (counters != nullptr)
+            counters[cStageTest].settled.fetch_add(1, std::memory_order_relaxed);
+        if (!Push(cStageReport, item))
+            break;
+    }
+}
+
+
+/*
+    Take the verdicts as they come, hand them to the listener in sweep
+    order, and poll it every tenth of a second; false if it or the stop
+    flag stopped the band.
+*/
+template <typename T>
+bool StagedBand<T>::Report(SweepListener& listener)
+{
+    std::vector<StagedItem<T> > ring(window);
+    std::vector<bool>           present(window, false);
+    size_t                      next = 0;
+    uint64_t                    polled = 0;
+    unsigned                    spins = 0;
+    StagedItem<T>               item;
+
+    while (next < count)
+    {
+        uint64_t    now = Nanoseconds();
+
+        if (now - polled >= 100000000)
+        {
+            polled = now;
+            if (Stopped(*options) || listener.Poll())
+                return false;
+        }
+
+        if (!Pop(cStageReport, item))
+        {
+            Backoff(spins);
+            continue;
+        }
+        spins = 0;
+
+        ring[item.sequence % window] = item;
+        present[item.sequence % window] = true;
+        for (; next < count && present[next % window]; next++)
+        {
+            const StagedItem<T>&    settled = ring[next % window];
+
+            present[next % window] = false;
+            listener.Tested(settled.hiPower, settled.loPower, settled.value, settled.verdict);
+        }
+        reported.store(next, std::memory_order_release);
+    }
+
+    return !Stopped(*options);
+}
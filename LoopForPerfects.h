@@ -0,0 +1,149 @@
+/*
+    LoopForPerfects.h -- The 2^x - 2^y candidate sweep (the PerfectSweep
+    library).
+
+    The sweep owns no console and no globals.  Everything it reports goes
+    through a SweepListener, and everything it needs comes in through
+    SweepOptions, so a program may run several sweeps side by side.
+*/
+#pragma once
+
+#include "Perfect.h"
+#include "Topology.h"
+
+#include <atomic>
+#include <vector>
+
+
+const unsigned  cMaxStatsThreads = 256;         // workers counted one by one; the rest share the last
+
+
+/*
+    Counters for one hiPower or one worker.  Workers add to them as they
+    go, so each is atomic; a reader sees a moment's snapshot.
+*/
+struct SweepCounters
+{
+    std::atomic<uint64_t>   tested;             // candidates settled
+    std::atomic<uint64_t>   divisors;           // trial divisors tried
+    std::atomic<uint64_t>   earlyExits;         // abundant or deficient before the last divisor
+    std::atomic<uint64_t>   nanoseconds;        // thread time spent testing
+
+    SweepCounters() : tested(0), divisors(0), earlyExits(0), nanoseconds(0) {}
+};
+
+
+// Where the sweep spends its time, by hiPower band and by worker.  The
+// serial sweep counts as worker 0.  With SweepOptions::prefilter, how
+// many pairs each step of prefilter_pair() ruled out, and how many it
+// passed on to the engine.
+struct SweepStats
+{
+    SweepCounters   bands[cMaxPower + 1];       // by hiPower; Mersenne exponents past it are not kept
+    SweepCounters   workers[cMaxStatsThreads];  // by worker index
+    std::atomic<uint64_t>   prefilter[cPrefilterCount];
+
+    SweepStats()
+    {
+        for (int result = 0; result < cPrefilterCount; result++)
+            prefilter[result] = 0;
+    }
+};
+
+
+// The queues of the staged sweep, each named for the stage it feeds.
+enum PipelineStage
+{
+    cStageFilter,                               // the bounds that settle a pair without dividing
+    cStageTest,                                 // the engine, one whole candidate per thread
+    cStageReport,                               // back into sweep order for the listener
+    cStageCount
+};
+
+const char*     stage_name(PipelineStage stage);
+
+
+// One stage of the staged sweep, counted like SweepCounters.
+struct StageCounters
+{
+    std::atomic<uint64_t>   items;              // taken off the stage's queue
+    std::atomic<uint64_t>   settled;            // ...and settled there, with no later stage
+    std::atomic<uint64_t>   depth;              // waiting in the queue, as of the last push
+    std::atomic<uint64_t>   peak;               // the most ever waiting
+    std::atomic<uint64_t>   stalls;             // pushes that found the queue full
+
+    StageCounters() : items(0), settled(0), depth(0), peak(0), stalls(0) {}
+};
+
+
+struct PipelineStats
+{
+    StageCounters   stages[cStageCount];
+};
+
+
+/*
+    The staged sweep, for the engines that test one candidate at a time
+    (all but the GPU and row engines): a generator, filterThreads that
+    settle what can be settled without an engine, testThreads that run
+    it, and the calling thread putting the verdicts back in order.  The
+    queues hold queueSlots each, and the generator runs at most four
+    queues' worth of candidates ahead of the listener.
+*/
+struct PipelineOptions
+{
+    unsigned        filterThreads;
+    unsigned        testThreads;                // 0 for SweepOptions::numThreads, or all cores
+    size_t          queueSlots;
+    PipelineStats*  stats;                      // queue depths and counts; may be null
+
+    PipelineOptions() : filterThreads(1), testThreads(0), queueSlots(4096), stats(nullptr) {}
+};
+
+
+struct SweepOptions
+{
+    PerfectEngine   engine;                     // how candidates are tested
+    unsigned        numThreads;                 // worker threads; 0 runs the serial sweep
+    unsigned        firstPower;                 // first hiPower to sweep
+    unsigned        lastPower;                  // last hiPower to sweep
+    unsigned        firstLoPower;               // loPower to resume firstPower at; 0 for all
+    unsigned        lastExponent;               // Lucas-Lehmer only: Mersenne exponents past the bands, up to this
+    const std::atomic<bool>* stop;              // set from any thread to stop the sweep; may be null
+    SweepStats*     stats;                      // counters to add to; may be null
+    SigmaCache*     cache;                      // the row engine's odd parts (SigmaCache.h); may be null
+    const std::vector<ThreadPlace>* places;     // where the workers run (Topology.h); null for anywhere
+    const PipelineOptions* pipeline;            // the staged sweep in place of the pool; null for none
+    bool            prefilter;                  // prefilter_pair() first: only Euclid pairs of a prime reach the engine
+
+    SweepOptions()
+        : engine(cEngineLucasLehmer), numThreads(0), firstPower(3), lastPower(cMaxPower),
+          firstLoPower(0), lastExponent(0), stop(nullptr), stats(nullptr), cache(nullptr), places(nullptr),
+          pipeline(nullptr), prefilter(false) {}
+};
+
+
+class SweepListener
+{
+public:
+    virtual ~SweepListener() {}
+
+    // Every candidate once it is settled, in ascending order, with how it
+    // was settled.  In a parallel sweep this runs on a worker thread, one
+    // call at a time.  Past cMaxPower (SweepOptions::lastExponent) only
+    // the Euclid pair of each hiPower comes, with a value of 0.
+    virtual void    Tested(unsigned hiPower, unsigned loPower, PerfectValue value, PerfectVerdict verdict) = 0;
+
+    // Asked on the sweeping thread, before every candidate in a serial
+    // sweep and every tenth of a second in a parallel one; returning true
+    // stops the sweep.  A program with a control thread of its own sets
+    // SweepOptions::stop instead, which is only a relaxed load per
+    // candidate, and returns false here.
+    virtual bool    Poll(void) = 0;
+};
+
+
+// Run the sweep; returns false if the listener stopped it.  The GPU and
+// row engines take whole rows, and ignore SweepOptions::pipeline and
+// prefilter; so do the bands of the table, which cost no engine.
+bool        LoopForPerfects(const SweepOptions& options, SweepListener& listener);
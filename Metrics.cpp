@@ -0,0 +1,75 @@
+/*
+    Metrics.cpp -- The /metrics endpoint.
+*/
+#include "Metrics.h"
+
+
+const ULONG     cScrapeAcceptMillis = 100;      // how often the server looks at its stop flag
+const ULONG     cScrapeLineMillis = 2000;       // how long a scraper has for its request
+
+
+bool MetricsServer::Start(unsigned port, std::string (*text)(void))
+{
+    if ((server_ = net_listen(port)) == cNoSocket)
+        return false;
+
+    text_ = text;
+    stop_.store(false, std::memory_order_relaxed);
+    thread_ = std::thread(&MetricsServer::Serve, this);
+    return true;
+}
+
+
+void MetricsServer::Stop(void)
+{
+    if (!thread_.joinable())
+        return;
+
+    stop_.store(true, std::memory_order_relaxed);
+    thread_.join();
+    net_close(server_);
+    server_ = cNoSocket;
+}
+
+
+/*
+    HTTP/1.0, one request per connection: the request line, the headers
+    read to the blank line so the close doesn't reset them, and the
+    answer.
+*/
+void MetricsServer::Serve(void)
+{
+    while (!stop_.load(std::memory_order_relaxed))
+    {
+        net_socket      client;
+        std::string     request, header, body, status;
+
+        if ((client = net_accept(server_, cScrapeAcceptMillis)) == cNoSocket)
+            continue;
+
+        if (net_read_line(client, request, cScrapeLineMillis))
+        {
+            while (net_read_line(client, header, cScrapeLineMillis) && !header.empty())
+                ;
+
+            if (request.compare(0, 13, "GET /metrics ") == 0 || request == "GET /metrics")
+            {
+                status = "200 OK";
+                body = text_();
+            }
+            else
+            {
+                status = "404 Not Found";
+                body = "Only /metrics is served here.\n";
+            }
+
+            // net_send_line() ends the last line of the body
+            net_send_line(client, "HTTP/1.0 " + status + "\r\n"
+                "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                "Connection: close\r\n"
+                "\r\n" + body.substr(0, body.size() - 1));
+        }
+        net_close(client);
+    }
+}
@@ -0,0 +1,53 @@
+/*
+    Metrics.h -- Live progress over HTTP, for Prometheus and anything
+    else that reads its text format.
+
+    Until now the only way to see how a run was doing was to press T or
+    S at its console.  /H serves GET /metrics on a thread of its own:
+    each scrape is one connection, answered with the text the program's
+    callback makes and then closed, the way the lease coordinator
+    answers its workers.  The callback reads only atomics (the sweep's
+    SweepStats, the sigma cache's counters, and the program's own mirror
+    of its position), so a scrape never takes StateLock or holds up a
+    worker.
+
+    Anything but GET /metrics is a 404.  There is no TLS and no
+    authentication: the port is for the machine's own scraper, or one on
+    a trusted network.
+*/
+#pragma once
+
+#include "Platform.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+
+const unsigned  cDefaultMetricsPort = 9716;     // /H without a port
+
+
+class MetricsServer
+{
+public:
+    MetricsServer() : server_(cNoSocket), text_(nullptr), stop_(false) {}
+    ~MetricsServer() { Stop(); }
+
+    // Listen on port and answer each scrape with text(), called on the
+    // server's thread; false if the port cannot be had.
+    bool        Start(unsigned port, std::string (*text)(void));
+
+    // Finish the scrape in hand, if any, and close the port.
+    void        Stop(void);
+
+private:
+    void        Serve(void);
+
+    net_socket          server_;
+    std::string         (*text_)(void);
+    std::atomic<bool>   stop_;
+    std::thread         thread_;
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+};
@@ -0,0 +1,19 @@
+/*
+    NodeLocal.cpp -- The NUMA node of the calling thread.
+*/
+#include "NodeLocal.h"
+
+
+static thread_local unsigned    CurrentNode = 0;
+
+
+unsigned thread_node(void)
+{
+    return CurrentNode;
+}
+
+
+void set_thread_node(unsigned node)
+{
+    CurrentNode = node;
+}
@@ -0,0 +1,90 @@
+/*
+    NodeLocal.h -- The NUMA node of the calling thread, and copies of the
+    shared tables kept on each node (part of PerfectLib).
+
+    The prime and reciprocal tables are built once and read by every
+    worker.  On a machine of several sockets the one copy sits on the
+    node of whichever thread built it, and every worker of the other
+    nodes pays the remote latency for each prime and each reciprocal it
+    loads.  A pool that pins its workers says which node each one is on
+    (set_thread_node()); the tables then hand the workers of node k > 0 a
+    copy of their own, made by the first of them to ask, so that under
+    the first-touch policy its pages are on node k.  Node 0 and any
+    thread nobody placed read the shared table itself.
+
+    The tables only ever grow, so a copy only grows too: it is topped up
+    from the shared table, under a lock of its own, when a reader of its
+    node wants entries it does not have yet.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+
+
+const unsigned  cMaxNodes = 16;                 // nodes with copies of their own; the rest read node 0's
+
+
+// The node the calling thread was placed on; 0 if it never was.
+unsigned    thread_node(void);
+void        set_thread_node(unsigned node);
+
+
+// Per-node copies of one grow-only table of up to capacity entries,
+// never freed, like the tables themselves.
+template <typename T>
+class NodeReplicas
+{
+public:
+    NodeReplicas()
+    {
+        for (unsigned node = 0; node < cMaxNodes; node++)
+        {
+            copies_[node].data = nullptr;
+            copies_[node].count = 0;
+        }
+    }
+
+    // The first count entries of shared, which only grows, from the copy
+    // of the calling thread's node.
+    const T*    Local(const T* shared, size_t count, size_t capacity)
+    {
+        unsigned    node = thread_node();
+
+        if (node == 0 || node >= cMaxNodes)
+            return shared;
+
+        Copy&       copy = copies_[node];
+
+        if (copy.count.load(std::memory_order_acquire) < count)
+        {
+            std::lock_guard<std::mutex> guard(copy.lock);
+            size_t      have = copy.count.load(std::memory_order_relaxed);
+
+            if (copy.data == nullptr)
+                copy.data = new T[capacity];
+            if (have < count)
+            {
+                memcpy(copy.data + have, shared + have, (count - have) * sizeof(T));
+                copy.count.store(count, std::memory_order_release);
+            }
+        }
+
+        return copy.data;
+    }
+
+private:
+    struct Copy
+    {
+        std::mutex          lock;               // guards growing data
+        T*                  data;
+        std::atomic<size_t> count;              // entries 0..count-1 are valid
+    };
+
+    Copy        copies_[cMaxNodes];
+
+    NodeReplicas(const NodeReplicas&) = delete;
+    NodeReplicas& operator=(const NodeReplicas&) = delete;
+};
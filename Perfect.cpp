@@ -0,0 +1,696 @@
+/*
+    Perfect.cpp -- Reentrant perfect-number tests (the PerfectLib library).
+*/
+#include "Perfect.h"
+#include "BigMersenne.h"
+#include "Reciprocal.h"
+#include "SigmaCache.h"
+#include "Wheel.h"
+
+#include <math.h>
+
+
+static uint64_t     SquareModMersenne(uint64_t value, unsigned exponent);
+static inline uint64_t MontgomeryMultiply(uint64_t a, uint64_t b, uint64_t modulus, uint64_t inverse);
+static bool         StrongProbablePrime(uint64_t value, uint64_t base, uint64_t inverse, uint64_t one,
+                        uint64_t odd, unsigned twos);
+template <typename T> static bool RangeWith(PerfectEngine kernel, T value, T first, T last, T& sum,
+                                    const DivisorWheel& wheel);
+template <typename T> static PerfectVerdict TrialVerdict(T value, PerfectEngine kernel, uint64_t* divisors);
+template <typename T> static PerfectVerdict OddVerdict(T odd, T target, uint64_t* divisors, SigmaCache* cache);
+template <typename T> static bool OddOutOfReach(T odd, T need, T last, T limit);
+static inline PerfectVerdict Settle(SigmaCache* cache, const OddProgress& progress, PerfectVerdict verdict);
+
+
+/*
+    Integer square root.  The double estimate is close but not exact past
+    53 bits, so it is polished with Newton steps and a final correction.
+*/
+template <typename T>
+T isqrt(T value)
+{
+    T       root;
+
+    if (value < 2)
+        return value;
+
+    root = (T)sqrt((double)value);
+    if (root == 0)
+        root = 1;
+
+    // two Newton steps pull a 53-bit estimate in to within one
+    root = (root + value / root) / 2;
+    root = (root + value / root) / 2;
+
+    while (root > value / root)
+        root--;
+    while (root + 1 <= value / (root + 1))
+        root++;
+
+    return root;
+}
+
+
+template <typename T>
+bool divisor_sum_range(T value, T first, T last, T& sum)
+{
+    T       index, factor;
+
+    // main division loop
+    for (index = first; index <= last; index++)
+    {
+        // test to see if divisor is worth trying
+        if (value % index == 0)
+        {
+            // add factor
+            if (index > value - sum)
+                return false;
+            sum += index;
+
+            // get cofactor and add if the two are not the same
+            if ((factor = value / index) != index)
+            {
+                if (factor > value - sum)
+                    return false;
+                sum += factor;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+template <typename T>
+bool divisor_sum_range(T value, T first, T last, T& sum, const DivisorWheel& wheel)
+{
+    T       index, factor;
+
+    for (WheelCursor<T> spoke(wheel, first); (index = *spoke) <= last; ++spoke)
+    {
+        if (value % index != 0)
+            continue;
+
+        if (index > value - sum)
+            return false;
+        sum += index;
+        if ((factor = value / index) != index)
+        {
+            if (factor > value - sum)
+                return false;
+            sum += factor;
+        }
+    }
+
+    return true;
+}
+
+
+template <typename T>
+T divisor_sum(T value)
+{
+    const T cMaxSum = (T)~(T)0;
+    T       limit = isqrt<T>(value);
+    T       index, factor, sum;
+
+    if (value < 2)
+        return 0;
+
+    for (sum = 1, index = 2; index <= limit; index++)
+    {
+        if (value % index == 0)
+        {
+            sum = (index > cMaxSum - sum) ? cMaxSum : sum + index;
+            if ((factor = value / index) != index)
+                sum = (factor > cMaxSum - sum) ? cMaxSum : sum + factor;
+        }
+    }
+
+    return sum;
+}
+
+
+/*
+    The divisors first..last of value, with their cofactors, add up to at
+    most sum(first..last) + value * ln(last / (first - 1)), since the sum
+    of 1/d over first..last is below that logarithm.  The bound is taken
+    in double with a margin, so rounding never rejects a candidate that
+    could still make it.
+*/
+template <typename T>
+bool cannot_reach(T value, T sum, T first, T last)
+{
+    return (double)(value - sum) > reach_bound<T>(value, first, last);
+}
+
+
+template <typename T>
+double reach_bound(T value, T first, T last)
+{
+    double  count = (double)(last - first + 1);
+    double  bound = count * ((double)first + (double)last) / 2
+                    + (double)value * log((double)last / ((double)first - 1));
+
+    return bound * 1.000001 + 1;
+}
+
+
+/*
+    The kernels do not say which spoke they stopped at, so the spokes are
+    walked again, one at a time, up to it.  An abundant exit mostly comes
+    within a few.
+*/
+template <typename T>
+T abundant_exit(T value, T first, T last, T sum, const DivisorWheel& wheel)
+{
+    T       index, factor;
+
+    for (WheelCursor<T> spoke(wheel, first); (index = *spoke) <= last; ++spoke)
+    {
+        if (value % index != 0)
+            continue;
+
+        if (index > value - sum)
+            return index;
+        sum += index;
+        if ((factor = value / index) != index)
+        {
+            if (factor > value - sum)
+                return index;
+            sum += factor;
+        }
+    }
+
+    return last;
+}
+
+
+template <typename T>
+static bool RangeWith(PerfectEngine kernel, T value, T first, T last, T& sum, const DivisorWheel& wheel)
+{
+    if (kernel == cEngineSimd)
+        return divisor_sum_range_simd<T>(value, first, last, sum, wheel);
+    if (kernel == cEngineReciprocal)
+        return divisor_sum_range_reciprocal<T>(value, first, last, sum, wheel);
+
+    return divisor_sum_range<T>(value, first, last, sum, wheel);
+}
+
+
+/*
+    Trial division in the arithmetic of T itself, cVerdictChunk numbers
+    at a time, with the deficiency bound checked between chunks.  Only
+    the spokes of the value's wheel are tried, and only they are counted,
+    as far as the division got; the bound, taken over every number left,
+    holds all the more for them.
+*/
+template <typename T>
+static PerfectVerdict TrialVerdict(T value, PerfectEngine kernel, uint64_t* divisors)
+{
+    T       sum = 1, first, last, limit;
+
+    if (value < 2)
+        return cVerdictShort;
+
+    const DivisorWheel& wheel = wheel_for<T>(value);
+
+    limit = isqrt<T>(value);
+    for (first = 2; first <= limit; first = last + 1)
+    {
+        T       before = sum;
+
+        last = (limit - first >= cVerdictChunk) ? first + (cVerdictChunk - 1) : limit;
+        if (!RangeWith<T>(kernel, value, first, last, sum, wheel))
+        {
+            if (divisors != nullptr)
+                *divisors += wheel_count<T>(wheel, first, abundant_exit<T>(value, first, last, before, wheel));
+            return cVerdictAbundant;
+        }
+        if (divisors != nullptr)
+            *divisors += wheel_count<T>(wheel, first, last);
+        if (last < limit && cannot_reach<T>(value, sum, last + 1, limit))
+            return cVerdictDeficient;
+    }
+
+    return (sum == value) ? cVerdictPerfect : cVerdictShort;
+}
+
+
+template <>
+PerfectVerdict trial_verdict<uint32_t>(uint32_t value, PerfectEngine kernel, uint64_t* divisors)
+{
+    return TrialVerdict<uint32_t>(value, kernel, divisors);
+}
+
+
+template <>
+PerfectVerdict trial_verdict<uint64_t>(uint64_t value, PerfectEngine kernel, uint64_t* divisors)
+{
+    if (value <= UINT32_MAX)
+        return TrialVerdict<uint32_t>((uint32_t)value, kernel, divisors);
+
+    return TrialVerdict<uint64_t>(value, kernel, divisors);
+}
+
+
+#if defined(__SIZEOF_INT128__)
+template <>
+PerfectVerdict trial_verdict<uint128_t>(uint128_t value, PerfectEngine kernel, uint64_t* divisors)
+{
+    if (value <= UINT64_MAX)
+        return trial_verdict<uint64_t>((uint64_t)value, kernel, divisors);
+
+    return TrialVerdict<uint128_t>(value, kernel, divisors);
+}
+#endif
+
+
+/*
+    sigma(odd) against target, dividing by the spokes of its wheel (which
+    always leaves out 2), with the same exits as TrialVerdict().  With a
+    cache, the division starts after the last whole chunk that an earlier
+    target of the same odd got through, and every exit leaves the chunks
+    this one got through for the next.
+*/
+template <typename T>
+static PerfectVerdict OddVerdict(T odd, T target, uint64_t* divisors, SigmaCache* cache)
+{
+    T               sum = 1 + odd, first = 3, last, limit, index, factor;
+    OddProgress     progress;
+
+    limit = isqrt<T>(odd);
+    if (cache != nullptr && cache->Find(odd, progress))
+    {
+        sum = (T)progress.sum;
+        first = (T)progress.reached + 1;
+        if (progress.complete)
+            return (sum == target) ? cVerdictPerfect : (sum > target) ? cVerdictAbundant : cVerdictShort;
+        if (sum <= target && first - 1 < limit && OddOutOfReach<T>(odd, target - sum, first - 1, limit))
+            return cVerdictDeficient;
+    }
+    progress.odd = odd;
+    progress.sum = sum;
+    progress.reached = (uint64_t)(first - 1);
+
+    if (sum > target)
+        return cVerdictAbundant;
+
+    const DivisorWheel& wheel = wheel_for<T>(odd);
+
+    for (; first <= limit; first = last + 1)
+    {
+        last = (limit - first >= 2 * cVerdictChunk) ? first + (2 * cVerdictChunk - 1) : limit;
+        for (WheelCursor<T> spoke(wheel, first); (index = *spoke) <= last; ++spoke)
+        {
+            if (odd % index != 0)
+                continue;
+            factor = odd / index;
+            if (index > target - sum || (factor != index && factor > target - sum - index))
+            {
+                // the pair is all in: the next target starts past it
+                progress.sum = sum + index + ((factor != index) ? factor : 0);
+                progress.reached = (uint64_t)index;
+                if (divisors != nullptr)
+                    *divisors += wheel_count<T>(wheel, first, index);
+                return Settle(cache, progress, cVerdictAbundant);
+            }
+            sum += index;
+            if (factor != index)
+                sum += factor;
+        }
+
+        if (divisors != nullptr)
+            *divisors += wheel_count<T>(wheel, first, last);
+        progress.sum = sum;
+        progress.reached = (uint64_t)last;
+        if (last < limit && OddOutOfReach<T>(odd, target - sum, last, limit))
+            return Settle(cache, progress, cVerdictDeficient);
+    }
+
+    progress.complete = true;
+    return Settle(cache, progress, (sum == target) ? cVerdictPerfect : cVerdictShort);
+}
+
+
+/*
+    The spokes past last cannot make up need: the bound of cannot_reach(),
+    over every number up to limit, since the spokes can only add less.
+*/
+template <typename T>
+static bool OddOutOfReach(T odd, T need, T last, T limit)
+{
+    double  bound = (double)(limit - last) * ((double)last + 1 + (double)limit) / 2
+                    + (double)odd * log((double)limit / (double)last);
+
+    return (double)need > bound * 1.000001 + 1;
+}
+
+
+static inline PerfectVerdict Settle(SigmaCache* cache, const OddProgress& progress, PerfectVerdict verdict)
+{
+    if (cache != nullptr)
+        cache->Store(progress);
+
+    return verdict;
+}
+
+
+/*
+    2^hi - 2^lo = 2^lo * m with m = 2^(hi-lo) - 1 odd.  sigma(2^hi - 2^lo)
+    = (2^(lo+1) - 1) * sigma(m), and that is twice the value exactly when
+    sigma(m) = 2^(lo+1) * m / (2^(lo+1) - 1).  The two sides are coprime,
+    so 2^(lo+1) - 1 must divide m = 2^(hi-lo) - 1, which it does only when
+    lo + 1 divides hi - lo.  m is worked in the narrowest type that holds
+    its target.
+*/
+template <typename T>
+PerfectVerdict pair_verdict(unsigned hiPower, unsigned loPower, uint64_t* divisors, SigmaCache* cache)
+{
+    unsigned    width = hiPower - loPower;
+
+    if (width % (loPower + 1) != 0)
+        return cVerdictRejected;
+
+    if (width < 32)
+    {
+        uint32_t    odd = ((uint32_t)1 << width) - 1;
+
+        return OddVerdict<uint32_t>(odd, (odd / (((uint32_t)1 << (loPower + 1)) - 1)) << (loPower + 1), divisors, cache);
+    }
+    if (width < 64)
+    {
+        uint64_t    odd = ((uint64_t)1 << width) - 1;
+
+        return OddVerdict<uint64_t>(odd, (odd / (((uint64_t)1 << (loPower + 1)) - 1)) << (loPower + 1), divisors, cache);
+    }
+
+    T           odd = ((T)1 << width) - 1;
+
+    return OddVerdict<T>(odd, (odd / (((T)1 << (loPower + 1)) - 1)) << (loPower + 1), divisors, cache);
+}
+
+
+template <typename T>
+void row_verdicts(unsigned hiPower, unsigned firstLo, PerfectVerdict* verdicts, uint64_t* divisors, SigmaCache* cache)
+{
+    for (unsigned loPower = firstLo; loPower > 0; loPower--)
+        verdicts[firstLo - loPower] = pair_verdict<T>(hiPower, loPower, divisors, cache);
+}
+
+
+template <typename T>
+bool is_perfect(T value)
+{
+    return trial_verdict<T>(value, cEngineTrialDivision) == cVerdictPerfect;
+}
+
+
+/*
+    The pair is 2^loPower * (2^(hiPower - loPower) - 1), which is of the
+    Euclid form 2^(p-1) * (2^p - 1) only when hiPower = 2p - 1 and loPower
+    = p - 1.  By Euclid-Euler those are the only even perfects, so every
+    other pair is rejected outright.
+*/
+PrefilterResult prefilter_pair(unsigned hiPower, unsigned loPower)
+{
+    unsigned    exponent = hiPower - loPower;
+
+    if (loPower + 1 != exponent || exponent > 64)
+        return cPrefilterForm;
+
+    return is_prime64((exponent == 64) ? ~(uint64_t)0 : ((uint64_t)1 << exponent) - 1)
+        ? cPrefilterPassed : cPrefilterPrime;
+}
+
+
+/*
+    With these twelve bases no composite below 3.3 * 10^24 is a strong
+    probable prime to all of them, so for 64 bits the test is exact.  The
+    residues stay in Montgomery form, a * 2^64 mod value, so a step is
+    two multiplies and a high multiply (mul_high64(), Reciprocal.h) with
+    no division, and no 128-bit type is needed.
+*/
+bool is_prime64(uint64_t value)
+{
+    static const uint64_t   bases[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+    const unsigned          count = sizeof(bases) / sizeof(bases[0]);
+    uint64_t                inverse, one, odd;
+    unsigned                twos = 0;
+
+    if (value < 2)
+        return false;
+    for (unsigned index = 0; index < count; index++)
+        if (value % bases[index] == 0)
+            return value == bases[index];
+
+    // value * inverse == 1 (mod 2^64): each Newton step doubles the bits
+    inverse = (3 * value) ^ 2;
+    for (unsigned step = 0; step < 4; step++)
+        inverse *= 2 - value * inverse;
+
+    // 1 in Montgomery form, and value - 1 = odd * 2^twos
+    one = (0 - value) % value;
+    for (odd = value - 1; (odd & 1) == 0; odd >>= 1)
+        twos++;
+
+    for (unsigned index = 0; index < count; index++)
+        if (!StrongProbablePrime(value, bases[index], inverse, one, odd, twos))
+            return false;
+
+    return true;
+}
+
+
+/*
+    a * b / 2^64 (mod modulus), modulus odd and a, b below it.  m is
+    chosen so the low words of a * b and m * modulus match, and the
+    difference of the high words is then exact.
+*/
+static inline uint64_t MontgomeryMultiply(uint64_t a, uint64_t b, uint64_t modulus, uint64_t inverse)
+{
+    uint64_t    high = mul_high64(a, b);
+    uint64_t    low = a * b;
+    uint64_t    product = mul_high64(low * inverse, modulus);
+
+    return (high >= product) ? high - product : high - product + modulus;
+}
+
+
+/*
+    One Miller-Rabin round: base^odd, then squared up to twos - 1 times,
+    must be 1 or reach -1.  The base goes into Montgomery form by
+    doubling 1 in it base - 1 times; the bases are small.
+*/
+static bool StrongProbablePrime(uint64_t value, uint64_t base, uint64_t inverse, uint64_t one,
+    uint64_t odd, unsigned twos)
+{
+    uint64_t    minusOne = value - one;
+    uint64_t    power = one, square = 0;
+
+    for (uint64_t index = 0; index < base; index++)
+        square = (square >= value - one) ? square - (value - one) : square + one;
+
+    for (uint64_t bits = odd; bits != 0; bits >>= 1)
+    {
+        if (bits & 1)
+            power = MontgomeryMultiply(power, square, value, inverse);
+        square = MontgomeryMultiply(square, square, value, inverse);
+    }
+
+    if (power == one || power == minusOne)
+        return true;
+    for (unsigned index = 1; index < twos; index++)
+    {
+        power = MontgomeryMultiply(power, power, value, inverse);
+        if (power == minusOne)
+            return true;
+    }
+
+    return false;
+}
+
+
+bool is_perfect_pair(unsigned hiPower, unsigned loPower)
+{
+    unsigned    exponent = hiPower - loPower;
+
+    if (loPower + 1 != exponent)
+        return false;
+
+    // 2^p - 1 can only be prime when p is
+    for (unsigned index = 2; index * index <= exponent; index++)
+        if (exponent % index == 0)
+            return false;
+
+    return lucas_lehmer(exponent);
+}
+
+
+/*
+    s = 4, then s = s^2 - 2 (mod 2^p - 1) p - 2 times; 2^p - 1 is prime
+    exactly when s ends at zero.  Past 63 bits s is a MersenneResidue.
+*/
+bool lucas_lehmer(unsigned exponent)
+{
+    uint64_t    mersenne, residue;
+    unsigned    index;
+
+    if (exponent == 2)          // 3 is prime; the recurrence needs odd p
+        return true;
+    if (exponent < 2)
+        return false;
+
+    if (exponent >= 64)
+    {
+        MersenneResidue     big(exponent);
+
+        big.Set(4);
+        for (index = 2; index < exponent; index++)
+            big.SquareMinus(2);
+
+        return big.IsZero();
+    }
+
+    mersenne = ((uint64_t)1 << exponent) - 1;
+    for (residue = 4, index = 2; index < exponent; index++)
+    {
+        residue = SquareModMersenne(residue, exponent);
+        residue = (residue >= 2) ? residue - 2 : residue + mersenne - 2;
+    }
+
+    return (residue == 0);
+}
+
+
+/*
+    3 squared p times is 3^(2^p) = 3^((2^p - 1) + 1), which is 9 (mod
+    2^p - 1) when 2^p - 1 is prime, by Fermat.  3 divides 2^2 - 1, so p = 2
+    is taken as Lucas-Lehmer takes it.
+*/
+bool fermat_prp3(unsigned exponent)
+{
+    uint64_t    mersenne, residue;
+    unsigned    index;
+
+    if (exponent == 2)
+        return true;
+    if (exponent < 2)
+        return false;
+
+    if (exponent >= 64)
+    {
+        MersenneResidue     big(exponent);
+
+        big.Set(3);
+        for (index = 1; index < exponent; index++)
+            big.SquareMinus(0);
+        big.SquareMinus(9);
+
+        return big.IsZero();
+    }
+
+    mersenne = ((uint64_t)1 << exponent) - 1;
+    for (residue = 3, index = 0; index < exponent; index++)
+        residue = SquareModMersenne(residue, exponent);
+
+    return (residue % mersenne == 9 % mersenne);
+}
+
+
+/*
+    value^2 mod 2^exponent - 1, for value < 2^exponent and exponent < 64.
+    The 128-bit square is built from 32-bit halves so no compiler extension
+    is needed, then reduced without division: since 2^p == 1 (mod 2^p - 1),
+    the bits above p are simply folded back onto the low p bits.
+*/
+static uint64_t SquareModMersenne(uint64_t value, unsigned exponent)
+{
+    uint64_t    mersenne = ((uint64_t)1 << exponent) - 1;
+    uint64_t    valueLo = value & 0xFFFFFFFF;
+    uint64_t    valueHi = value >> 32;
+    uint64_t    low, high, cross, result;
+
+    // 64 x 64 -> 128-bit square as (high, low)
+    low = valueLo * valueLo;
+    cross = valueLo * valueHi;
+    high = valueHi * valueHi + (cross >> 31);
+    cross <<= 33;
+    low += cross;
+    if (low < cross)
+        high++;
+
+    // fold: (high:low) == (low & mersenne) + ((high:low) >> exponent)
+    result = (low & mersenne) + ((high << (64 - exponent)) | (low >> exponent));
+    result = (result & mersenne) + (result >> exponent);
+    if (result >= mersenne)
+        result -= mersenne;
+
+    return result;
+}
+
+
+const char* engine_name(PerfectEngine engine)
+{
+    static const char*  names[] = { "lucas-lehmer", "trial-division", "simd", "reciprocal", "sigma", "gpu", "row" };
+
+    return ((unsigned)engine < sizeof(names) / sizeof(names[0])) ? names[engine] : "unknown";
+}
+
+
+const char* verdict_name(PerfectVerdict verdict)
+{
+    static const char*  names[cVerdictCount] = { "perfect", "abundant", "deficient", "short", "rejected" };
+
+    return ((unsigned)verdict < cVerdictCount) ? names[verdict] : "unknown";
+}
+
+
+std::string format_value(PerfectValue value)
+{
+    char    digits[48];
+    int     pos = sizeof(digits);
+
+    digits[--pos] = '\0';
+    do
+    {
+        digits[--pos] = (char)('0' + (int)(value % 10));
+        value /= 10;
+    } while (value != 0);
+
+    return std::string(&digits[pos]);
+}
+
+
+// the instantiations PerfectLib provides
+template uint32_t   isqrt<uint32_t>(uint32_t);
+template uint64_t   isqrt<uint64_t>(uint64_t);
+template bool       divisor_sum_range<uint32_t>(uint32_t, uint32_t, uint32_t, uint32_t&);
+template bool       divisor_sum_range<uint64_t>(uint64_t, uint64_t, uint64_t, uint64_t&);
+template bool       divisor_sum_range<uint32_t>(uint32_t, uint32_t, uint32_t, uint32_t&, const DivisorWheel&);
+template bool       divisor_sum_range<uint64_t>(uint64_t, uint64_t, uint64_t, uint64_t&, const DivisorWheel&);
+template uint32_t   divisor_sum<uint32_t>(uint32_t);
+template uint64_t   divisor_sum<uint64_t>(uint64_t);
+template bool       cannot_reach<uint32_t>(uint32_t, uint32_t, uint32_t, uint32_t);
+template bool       cannot_reach<uint64_t>(uint64_t, uint64_t, uint64_t, uint64_t);
+template double     reach_bound<uint32_t>(uint32_t, uint32_t, uint32_t);
+template double     reach_bound<uint64_t>(uint64_t, uint64_t, uint64_t);
+template uint32_t   abundant_exit<uint32_t>(uint32_t, uint32_t, uint32_t, uint32_t, const DivisorWheel&);
+template uint64_t   abundant_exit<uint64_t>(uint64_t, uint64_t, uint64_t, uint64_t, const DivisorWheel&);
+template bool       is_perfect<uint32_t>(uint32_t);
+template bool       is_perfect<uint64_t>(uint64_t);
+template PerfectVerdict pair_verdict<uint32_t>(unsigned, unsigned, uint64_t*, SigmaCache*);
+template PerfectVerdict pair_verdict<uint64_t>(unsigned, unsigned, uint64_t*, SigmaCache*);
+template void       row_verdicts<uint32_t>(unsigned, unsigned, PerfectVerdict*, uint64_t*, SigmaCache*);
+template void       row_verdicts<uint64_t>(unsigned, unsigned, PerfectVerdict*, uint64_t*, SigmaCache*);
+#if defined(__SIZEOF_INT128__)
+template uint128_t  isqrt<uint128_t>(uint128_t);
+template bool       divisor_sum_range<uint128_t>(uint128_t, uint128_t, uint128_t, uint128_t&);
+template bool       divisor_sum_range<uint128_t>(uint128_t, uint128_t, uint128_t, uint128_t&, const DivisorWheel&);
+template uint128_t  divisor_sum<uint128_t>(uint128_t);
+template bool       cannot_reach<uint128_t>(uint128_t, uint128_t, uint128_t, uint128_t);
+template double     reach_bound<uint128_t>(uint128_t, uint128_t, uint128_t);
+template uint128_t  abundant_exit<uint128_t>(uint128_t, uint128_t, uint128_t, uint128_t, const DivisorWheel&);
+template bool       is_perfect<uint128_t>(uint128_t);
+template PerfectVerdict pair_verdict<uint128_t>(unsigned, unsigned, uint64_t*, SigmaCache*);
+template void       row_verdicts<uint128_t>(unsigned, unsigned, PerfectVerdict*, uint64_t*, SigmaCache*);
+#endif
@@ -0,0 +1,244 @@
+/*
+    Perfect.h -- Reentrant perfect-number tests (the PerfectLib library).
+
+    Nothing in here reads or writes shared state: every function works on
+    its arguments alone, so any number of threads can test candidates at
+    once, and a service can embed the tests without a global lock.
+
+    The templates take T = uint32_t, uint64_t or, where the compiler has
+    one, uint128_t; those are the instantiations the library provides.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+
+// The widest candidate type the compiler offers.
+#if defined(__SIZEOF_INT128__)
+typedef unsigned __int128   uint128_t;
+typedef uint128_t           PerfectValue;
+const unsigned  cMaxPower = 128;                // highest hiPower that fits PerfectValue
+#else
+typedef uint64_t            PerfectValue;
+const unsigned  cMaxPower = 64;
+#endif
+
+// candidate testing engines
+enum PerfectEngine
+{
+    cEngineLucasLehmer,                         // Euclid form + Lucas-Lehmer (default)
+    cEngineTrialDivision,                       // brute-force divisor sum (verify mode)
+    cEngineSimd,                                // trial division, vectorized divisibility test
+    cEngineReciprocal,                          // trial division by table reciprocals
+    cEngineSigma,                               // sigma(n) from the prime factorization
+    cEngineGpu,                                 // trial division of whole rows on the GPU
+    cEngineRow                                  // sigma(2^y) in closed form, odd cofactors divided
+};
+
+// how a test settled a candidate
+enum PerfectVerdict
+{
+    cVerdictPerfect,                            // the proper divisors add up to the value
+    cVerdictAbundant,                           // the divisor sum passed the value
+    cVerdictDeficient,                          // the divisors left could not make up the value
+    cVerdictShort,                              // every divisor tried, and the sum fell short
+    cVerdictRejected,                           // ruled out without a divisor sum
+    cVerdictCount
+};
+
+// what prefilter_pair() made of a pair
+enum PrefilterResult
+{
+    cPrefilterForm,                             // not 2^(p-1) * (2^p - 1): rejected
+    cPrefilterPrime,                            // the Euclid form, but 2^p - 1 failed Miller-Rabin: rejected
+    cPrefilterPassed,                           // ...and passed: for the engine to settle
+    cPrefilterCount
+};
+
+// vector instruction sets for the SIMD kernel, weakest first
+enum SimdLevel
+{
+    cSimdNone,                                  // scalar loop
+    cSimdNeon,                                  // ARM NEON, 8 divisors per step
+    cSimdAvx2,                                  // x86 AVX2, 8 divisors per step
+    cSimdAvx512                                 // x86 AVX-512F, 16 divisors per step
+};
+
+struct DivisorWheel;                            // Wheel.h
+class SigmaCache;                               // SigmaCache.h
+
+
+// Largest root with root * root <= value.
+template <typename T> T     isqrt(T value);
+
+// Add every divisor pair (index, value / index) with first <= index <=
+// last to sum.  Returns false, leaving sum partial, as soon as the sum
+// would pass value, so an abundant value never wraps the arithmetic.
+template <typename T> bool  divisor_sum_range(T value, T first, T last, T& sum);
+
+// divisor_sum_range() over just the spokes of a wheel of value (Wheel.h):
+// the same sum, from the only indexes that can divide.
+template <typename T> bool  divisor_sum_range(T value, T first, T last, T& sum, const DivisorWheel& wheel);
+
+// Sum of the proper divisors of value (all divisors but value itself),
+// saturated at the largest T if it doesn't fit.
+template <typename T> T     divisor_sum(T value);
+
+// Trial division of value with the kernel of cEngineTrialDivision,
+// cEngineSimd or cEngineReciprocal, on the wheel of value.  It stops as
+// soon as the sum passes value, and as soon as the divisors left are too
+// small to make up the difference.  A value that fits a narrower type is
+// tested in that type.  If divisors is given, the count of divisors
+// tried is added to it.
+template <typename T> PerfectVerdict trial_verdict(T value, PerfectEngine kernel, uint64_t* divisors = nullptr);
+template <> PerfectVerdict trial_verdict<uint32_t>(uint32_t value, PerfectEngine kernel, uint64_t* divisors);
+template <> PerfectVerdict trial_verdict<uint64_t>(uint64_t value, PerfectEngine kernel, uint64_t* divisors);
+#if defined(__SIZEOF_INT128__)
+template <> PerfectVerdict trial_verdict<uint128_t>(uint128_t value, PerfectEngine kernel, uint64_t* divisors);
+#endif
+
+// Divisors trial_verdict() tries between deficiency checks: it checks
+// before each 2 + k * cVerdictChunk.
+const unsigned  cVerdictChunk = 0x00004000;
+
+// True when the divisors first..last of value, with their cofactors,
+// cannot add up to value - sum: the deficiency exit of trial_verdict().
+template <typename T> bool  cannot_reach(T value, T sum, T first, T last);
+
+// The bound cannot_reach() holds value - sum to, margin and all.
+template <typename T> double reach_bound(T value, T first, T last);
+
+// Where a divisor_sum_range() kernel that started from sum stopped on
+// the abundant exit: the spoke of wheel at which the sum passed value.
+template <typename T> T     abundant_exit(T value, T first, T last, T sum, const DivisorWheel& wheel);
+
+// The verdict on 2^hiPower - 2^loPower = 2^loPower * m from sigma(2^loPower)
+// = 2^(loPower+1) - 1 in closed form: it can be perfect only when that
+// divides m, and only then are the odd divisors of m tried, up to the
+// root of m rather than of the value.  Everything else is rejected
+// without a division.  A cache carries the division of m over from the
+// pairs of the same width before.  Requires 0 < loPower < hiPower <=
+// width of T.
+template <typename T> PerfectVerdict pair_verdict(unsigned hiPower, unsigned loPower, uint64_t* divisors = nullptr,
+                                SigmaCache* cache = nullptr);
+
+// pair_verdict() for a whole row: loPower = firstLo down to 1 into
+// verdicts[0] .. verdicts[firstLo - 1], the order the sweep takes them.
+template <typename T> void  row_verdicts(unsigned hiPower, unsigned firstLo, PerfectVerdict* verdicts,
+                                uint64_t* divisors = nullptr, SigmaCache* cache = nullptr);
+
+// True when value is the sum of its proper divisors, by trial division.
+template <typename T> bool  is_perfect(T value);
+
+// divisor_sum_range() and is_perfect() on the SIMD kernel: the same sums,
+// with the divisibility test done 8-16 divisors at a time by reciprocal
+// multiplication.  The level defaults to the best this CPU supports.
+template <typename T> bool  divisor_sum_range_simd(T value, T first, T last, T& sum);
+template <typename T> bool  divisor_sum_range_simd(T value, T first, T last, T& sum, SimdLevel level);
+template <> bool    divisor_sum_range_simd<uint32_t>(uint32_t value, uint32_t first, uint32_t last, uint32_t& sum, SimdLevel level);
+template <> bool    divisor_sum_range_simd<uint64_t>(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum, SimdLevel level);
+#if defined(__SIZEOF_INT128__)
+template <> bool    divisor_sum_range_simd<uint128_t>(uint128_t value, uint128_t first, uint128_t last, uint128_t& sum, SimdLevel level);
+#endif
+template <typename T> bool  divisor_sum_range_simd(T value, T first, T last, T& sum, const DivisorWheel& wheel);
+template <> bool    divisor_sum_range_simd<uint32_t>(uint32_t value, uint32_t first, uint32_t last, uint32_t& sum, const DivisorWheel& wheel);
+template <> bool    divisor_sum_range_simd<uint64_t>(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum, const DivisorWheel& wheel);
+#if defined(__SIZEOF_INT128__)
+template <> bool    divisor_sum_range_simd<uint128_t>(uint128_t value, uint128_t first, uint128_t last, uint128_t& sum, const DivisorWheel& wheel);
+#endif
+template <typename T> bool  is_perfect_simd(T value);
+
+// divisor_sum_range() and is_perfect() with every % and / replaced by a
+// multiply and shift from the shared reciprocal tables (Reciprocal.h).
+template <typename T> bool  divisor_sum_range_reciprocal(T value, T first, T last, T& sum);
+template <> bool    divisor_sum_range_reciprocal<uint32_t>(uint32_t value, uint32_t first, uint32_t last, uint32_t& sum);
+template <> bool    divisor_sum_range_reciprocal<uint64_t>(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum);
+#if defined(__SIZEOF_INT128__)
+template <> bool    divisor_sum_range_reciprocal<uint128_t>(uint128_t value, uint128_t first, uint128_t last, uint128_t& sum);
+#endif
+template <typename T> bool  divisor_sum_range_reciprocal(T value, T first, T last, T& sum, const DivisorWheel& wheel);
+template <> bool    divisor_sum_range_reciprocal<uint32_t>(uint32_t value, uint32_t first, uint32_t last, uint32_t& sum, const DivisorWheel& wheel);
+template <> bool    divisor_sum_range_reciprocal<uint64_t>(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum, const DivisorWheel& wheel);
+#if defined(__SIZEOF_INT128__)
+template <> bool    divisor_sum_range_reciprocal<uint128_t>(uint128_t value, uint128_t first, uint128_t last, uint128_t& sum, const DivisorWheel& wheel);
+#endif
+template <typename T> bool  is_perfect_reciprocal(T value);
+
+// Sum of all the divisors of value, value included, by the multiplicative
+// formula over its prime factorization (PrimeSieve.h); saturated at the
+// largest T if it doesn't fit.
+template <typename T> T     sigma(T value);
+
+// True when sigma(value) is twice value.  Every sigma(p^e) must divide
+// what is left of 2 * value, so most candidates fail at their first prime.
+template <typename T> bool  is_perfect_sigma(T value);
+template <> bool    is_perfect_sigma<uint32_t>(uint32_t value);
+template <> bool    is_perfect_sigma<uint64_t>(uint64_t value);
+#if defined(__SIZEOF_INT128__)
+template <> bool    is_perfect_sigma<uint128_t>(uint128_t value);
+#endif
+
+// Trial division of count values at once on the GPU (GpuKernel.cpp),
+// which sweeps a chunk of divisors of every value per launch.  Perfect
+// and abundant come out as trial_verdict() has them; a deficient value
+// may be settled a chunk later, or as short.  Values past 64 bits, and
+// every value when there is no device, go to the SIMD kernel instead.
+template <typename T> void  gpu_verdicts(const T* values, size_t count, PerfectVerdict* verdicts, uint64_t* divisors = nullptr);
+template <typename T> bool  is_perfect_gpu(T value);
+
+// True when OpenCL found a device for gpu_verdicts(), and its name.
+bool        gpu_available(void);
+const char* gpu_device_name(void);
+
+// Best SIMD level of this CPU (by CPUID on x86), and its name.
+SimdLevel   simd_level(void);
+const char* simd_level_name(SimdLevel level);
+
+// Lucas-Lehmer: true when 2^exponent - 1 is prime.  Past 63 bits the
+// residue is multi-word (BigMersenne.h).
+bool        lucas_lehmer(unsigned exponent);
+
+// Fermat test to base 3: true when 2^exponent - 1 is prime (no composite
+// 2^p - 1 is known to pass).  A second opinion on lucas_lehmer() by
+// another recurrence.
+bool        fermat_prp3(unsigned exponent);
+
+// True when 2^hiPower - 2^loPower is perfect, decided by the Euclid form
+// and Lucas-Lehmer instead of by division.
+bool        is_perfect_pair(unsigned hiPower, unsigned loPower);
+
+// Miller-Rabin to the twelve prime bases 2 .. 37, which is a proof of
+// primality for every value below 2^64, by Montgomery multiplication.
+bool        is_prime64(uint64_t value);
+
+// The cheap part of the sigma argument, before an engine divides
+// anything: 2^hiPower - 2^loPower = 2^y * m, m odd, can only be perfect
+// when m = 2^(y+1) - 1 and m is prime.  The form is a comparison; the
+// primality is is_prime64() on m, which always fits (y + 1 <= 64 at
+// hiPower 128).
+PrefilterResult prefilter_pair(unsigned hiPower, unsigned loPower);
+
+// Short names of an engine and of a verdict, for statistics.
+const char* engine_name(PerfectEngine engine);
+const char* verdict_name(PerfectVerdict verdict);
+
+// Decimal form of a value; iostreams cannot print 128-bit values.
+std::string format_value(PerfectValue value);
+
+// Decimal form of the Euclid perfect 2^(exponent - 1) * (2^exponent - 1),
+// at any size (BigMersenne.cpp).
+std::string format_perfect(unsigned exponent);
+
+
+/*
+    The candidate 2^hiPower - 2^loPower, built as a run of (hiPower -
+    loPower) one-bits shifted up by loPower, so hiPower may equal the width
+    of T without overflowing.  Requires 0 < loPower < hiPower.
+*/
+template <typename T>
+inline T pair_value(unsigned hiPower, unsigned loPower)
+{
+    return (((T)1 << (hiPower - loPower)) - 1) << loPower;
+}
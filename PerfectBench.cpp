@@ -0,0 +1,490 @@
+/*
+    PerfectBench.cpp -- Microbenchmarks for the PerfectLib engines.
+
+    To use:  PerfectBench            (every engine on every candidate set)
+             PerfectBench /F:text    (only the benchmarks whose name has text)
+             PerfectBench /M:s       (run each for at least s seconds; 0.2)
+             PerfectBench /J:file    (also write the results as JSON lines)
+             PerfectBench /B:file    (compare with a /J file; fail if slower)
+             PerfectBench /G:pct     (how much slower fails with /B; 10)
+
+    Each engine is timed on fixed sets of 64-bit candidates: known
+    perfects, abundant, deficient and near-perfect 2^x - 2^y values, and
+    primes; the Lucas-Lehmer engine also on three Mersenne primes the
+    width of the multi-limb residues.  A benchmark runs whole passes over
+    its set until the minimum time is up, does that five times, and
+    reports the median, which holds still from run to run far better than
+    one long timing does.  The full LoopForPerfects() sweep cannot do
+    this: its time is all in the last few hiPower.
+
+    With /B the program exits nonzero when any benchmark's median time
+    per candidate is more than /G percent above the baseline's, so it can
+    gate a build.
+
+    Built with PERFECT_COUNT_ALLOCATIONS (the CMake option of that name),
+    every operator new is counted, and a benchmark whose engine allocates
+    at all in its timed passes, once the untimed one has built the shared
+    tables and the thread's scratch, fails the run the same way.
+*/
+#include "Perfect.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+
+
+const int       cRepetitions = 5;               // medians are taken over this many runs
+
+
+struct Candidate
+{
+    uint64_t    value;                          // 0 for a pair past 64 bits
+    unsigned    hiPower;                        // the 2^hiPower - 2^loPower pair, or 0 if not one
+    unsigned    loPower;
+};
+
+struct CandidateSet
+{
+    const char*         name;
+    PerfectVerdict      expected;               // what trial division must say about each
+    std::vector<Candidate> candidates;
+    std::vector<uint64_t> values;               // the candidates' values, for a batch
+    mutable std::vector<PerfectVerdict> verdicts;   // ...and its answers, so a pass allocates nothing
+};
+
+struct Result
+{
+    std::string     name;
+    double          nsPerCandidate;             // median
+    double          divisorsPerSecond;          // 0 where the engine does not trial-divide
+    uint64_t        iterations;                 // passes over the set in the median run
+    uint64_t        allocations;                // in every timed pass together
+};
+
+
+static std::atomic<uint64_t>    Allocations(0);  // operator new calls, with PERFECT_COUNT_ALLOCATIONS
+
+
+static std::vector<CandidateSet> MakeSets(void);
+static bool     Takes(PerfectEngine engine, const Candidate& candidate);
+static bool     RunEngine(PerfectEngine engine, const CandidateSet& set, uint64_t& divisors);
+static Result   Measure(PerfectEngine engine, const CandidateSet& set, double minSeconds);
+static bool     CheckSets(const std::vector<CandidateSet>& sets);
+static bool     WriteJson(const char* fileName, const std::vector<Result>& results);
+static bool     CompareBaseline(const char* fileName, const std::vector<Result>& results, double tolerance);
+
+
+int main(int argc, char* argv[])
+{
+    const char*     filter = "";
+    const char*     jsonFile = "";
+    const char*     baselineFile = "";
+    double          minSeconds = 0.2;
+    double          tolerance = 10;
+    std::vector<CandidateSet> sets = MakeSets();
+    std::vector<Result> results;
+    bool            allocated = false;
+    const PerfectEngine engines[] = { cEngineTrialDivision, cEngineSimd, cEngineReciprocal, cEngineSigma, cEngineGpu, cEngineRow, cEngineLucasLehmer };
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        char    option = (argv[arg][0] == '/' || argv[arg][0] == '-') ? (char)toupper(argv[arg][1]) : 0;
+        const char* value = (option && argv[arg][2] == ':') ? &argv[arg][3] : nullptr;
+
+        if (option == 'F' && value)
+            filter = value;
+        else if (option == 'M' && value && atof(value) >= 0)
+            minSeconds = atof(value);
+        else if (option == 'J' && value && *value)
+            jsonFile = value;
+        else if (option == 'B' && value && *value)
+            baselineFile = value;
+        else if (option == 'G' && value && atof(value) > 0)
+            tolerance = atof(value);
+        else
+        {
+            printf("Usage: PerfectBench [/F:text] [/M:seconds] [/J:file] [/B:file [/G:percent]]\n");
+            return 2;
+        }
+    }
+
+    // a set whose candidates are not what it says would time the wrong thing
+    if (!CheckSets(sets))
+        return 2;
+
+    printf("PerfectBench -- %s kernel, GPU %s, %d repetitions of at least %.2f s each\n\n",
+        simd_level_name(simd_level()), gpu_device_name(), cRepetitions, minSeconds);
+    printf("%-34s %14s %14s %10s\n", "Benchmark", "Time/cand", "Divisors/s", "Passes");
+    printf("%-34s %14s %14s %10s\n", "---------", "---------", "----------", "------");
+
+    for (size_t engine = 0; engine < sizeof(engines) / sizeof(engines[0]); engine++)
+    {
+        for (size_t set = 0; set < sets.size(); set++)
+        {
+            std::string     name = std::string(engine_name(engines[engine])) + "/" + sets[set].name;
+            uint64_t        divisors = 0;
+            Result          result;
+
+            if (name.find(filter) == std::string::npos || !RunEngine(engines[engine], sets[set], divisors))
+                continue;
+
+            result = Measure(engines[engine], sets[set], minSeconds);
+            result.name = name;
+            results.push_back(result);
+
+            printf("%-34s %11.0f ns ", name.c_str(), result.nsPerCandidate);
+            if (result.divisorsPerSecond > 0)
+                printf("%14.4g", result.divisorsPerSecond);
+            else
+                printf("%14s", "-");
+            printf(" %10llu\n", (unsigned long long)result.iterations);
+            if (result.allocations != 0)
+            {
+                printf("ERROR: %s allocated %llu times in its timed passes.\n", name.c_str(),
+                    (unsigned long long)result.allocations);
+                allocated = true;
+            }
+            fflush(stdout);
+        }
+    }
+
+    if (*jsonFile && !WriteJson(jsonFile, results))
+        return 2;
+    if (*baselineFile && !CompareBaseline(baselineFile, results, tolerance))
+        return 1;
+
+    return allocated ? 1 : 0;
+}
+
+
+#if defined(PERFECT_COUNT_ALLOCATIONS)
+/*
+    The counting allocator: every new and new[] of the program goes
+    through here.  Only the count is new; the blocks are malloc's.
+*/
+void* operator new(size_t size)
+{
+    void*   block = malloc(size ? size : 1);
+
+    Allocations.fetch_add(1, std::memory_order_relaxed);
+    if (block == nullptr)
+        throw std::bad_alloc();
+    return block;
+}
+
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+
+void operator delete(void* block) noexcept
+{
+    free(block);
+}
+
+
+void operator delete[](void* block) noexcept
+{
+    free(block);
+}
+
+
+void operator delete(void* block, size_t) noexcept
+{
+    free(block);
+}
+
+
+void operator delete[](void* block, size_t) noexcept
+{
+    free(block);
+}
+#endif
+
+
+static Candidate Pair(unsigned hiPower, unsigned loPower)
+{
+    Candidate   candidate = { pair_value<uint64_t>(hiPower, loPower), hiPower, loPower };
+
+    return candidate;
+}
+
+
+static Candidate Plain(uint64_t value)
+{
+    Candidate   candidate = { value, 0, 0 };
+
+    return candidate;
+}
+
+
+// The perfect 2^(p-1) * (2^p - 1), for the Lucas-Lehmer engine alone.
+static Candidate Euclid(unsigned exponent)
+{
+    Candidate   candidate = { 0, 2 * exponent - 1, exponent - 1 };
+
+    return candidate;
+}
+
+
+static std::vector<CandidateSet> MakeSets(void)
+{
+    std::vector<CandidateSet>   sets(6);
+
+    sets[0].name = "perfects";
+    sets[0].expected = cVerdictPerfect;
+    sets[0].candidates = { Pair(3, 1), Pair(5, 2), Pair(9, 4), Pair(13, 6), Pair(25, 12), Pair(33, 16), Pair(37, 18) };
+
+    // plenty of small divisors: out within the first chunk
+    sets[1].name = "abundant";
+    sets[1].expected = cVerdictAbundant;
+    sets[1].candidates = { Pair(36, 24), Pair(38, 30), Pair(40, 20), Pair(40, 32), Pair(42, 36), Pair(44, 40) };
+
+    // 2 * (2^k - 1) and kin: out once the divisors left are too small
+    sets[2].name = "deficient";
+    sets[2].expected = cVerdictDeficient;
+    sets[2].candidates = { Pair(36, 1), Pair(38, 1), Pair(40, 1), Pair(40, 3), Pair(42, 1) };
+
+    // powers of two and near-perfects: the whole range, every time
+    sets[3].name = "near-perfect";
+    sets[3].expected = cVerdictShort;
+    sets[3].candidates = { Pair(36, 35), Pair(38, 37), Pair(40, 39), Pair(41, 10), Pair(42, 11) };
+
+    // the largest primes below 2^32 .. 2^40
+    sets[4].name = "primes";
+    sets[4].expected = cVerdictDeficient;
+    sets[4].candidates = { Plain(4294967291ULL), Plain(17179869143ULL), Plain(68719476731ULL),
+                           Plain(274877906899ULL), Plain(1099511627689ULL) };
+
+    // Mersenne primes of 9, 70 and 176 limbs: schoolbook and Karatsuba
+    // squares of residues whose limbs come from the limb pool
+    sets[5].name = "mersennes";
+    sets[5].expected = cVerdictPerfect;
+    sets[5].candidates = { Euclid(521), Euclid(4423), Euclid(11213) };
+
+    for (size_t set = 0; set < sets.size(); set++)
+    {
+        for (size_t index = 0; index < sets[set].candidates.size(); index++)
+            if (sets[set].candidates[index].value != 0)
+                sets[set].values.push_back(sets[set].candidates[index].value);
+        sets[set].verdicts.resize(sets[set].values.size());
+    }
+
+    return sets;
+}
+
+
+/*
+    Every candidate must get its set's verdict from scalar trial division.
+*/
+static bool CheckSets(const std::vector<CandidateSet>& sets)
+{
+    for (size_t set = 0; set < sets.size(); set++)
+    {
+        for (size_t index = 0; index < sets[set].candidates.size(); index++)
+        {
+            const Candidate&    candidate = sets[set].candidates[index];
+            PerfectVerdict      verdict;
+
+            // past 64 bits only Lucas-Lehmer can tell
+            if (candidate.value == 0)
+            {
+                verdict = is_perfect_pair(candidate.hiPower, candidate.loPower) ? cVerdictPerfect : cVerdictRejected;
+                if (verdict != sets[set].expected)
+                {
+                    printf("ERROR: 2^%u - 2^%u in set %s is %s.\n", candidate.hiPower, candidate.loPower,
+                        sets[set].name, verdict_name(verdict));
+                    return false;
+                }
+                continue;
+            }
+
+            verdict = trial_verdict<uint64_t>(candidate.value, cEngineTrialDivision);
+            if (verdict != sets[set].expected)
+            {
+                printf("ERROR: %llu in set %s is %s.\n", (unsigned long long)candidate.value, sets[set].name,
+                    verdict_name(verdict));
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+/*
+    Lucas-Lehmer and the row engine work on pairs only, and only
+    Lucas-Lehmer on pairs past 64 bits.
+*/
+static bool Takes(PerfectEngine engine, const Candidate& candidate)
+{
+    if (engine == cEngineLucasLehmer)
+        return candidate.hiPower != 0;
+    if (engine == cEngineRow)
+        return candidate.hiPower != 0 && candidate.value != 0;
+
+    return candidate.value != 0;
+}
+
+
+/*
+    One pass over the set.  Returns false if the engine has nothing to
+    run on it; the answers go into a sink so the compiler cannot drop the
+    work.
+*/
+static volatile unsigned    Sink;
+
+static bool RunEngine(PerfectEngine engine, const CandidateSet& set, uint64_t& divisors)
+{
+    unsigned    perfects = 0, tried = 0;
+
+    // the GPU takes the whole set as one batch
+    if (engine == cEngineGpu)
+    {
+        gpu_verdicts<uint64_t>(set.values.data(), set.values.size(), set.verdicts.data(), &divisors);
+        for (size_t index = 0; index < set.verdicts.size(); index++)
+            perfects += set.verdicts[index] == cVerdictPerfect;
+
+        Sink = Sink + perfects;
+        return !set.values.empty();
+    }
+
+    for (size_t index = 0; index < set.candidates.size(); index++)
+    {
+        const Candidate&    candidate = set.candidates[index];
+
+        if (!Takes(engine, candidate))
+            continue;
+        if (engine == cEngineLucasLehmer || engine == cEngineRow)
+        {
+            if (engine == cEngineRow)
+                perfects += pair_verdict<uint64_t>(candidate.hiPower, candidate.loPower, &divisors) == cVerdictPerfect;
+            else
+                perfects += is_perfect_pair(candidate.hiPower, candidate.loPower);
+        }
+        else if (engine == cEngineSigma)
+            perfects += is_perfect_sigma<uint64_t>(candidate.value);
+        else
+            perfects += trial_verdict<uint64_t>(candidate.value, engine, &divisors) == cVerdictPerfect;
+        tried++;
+    }
+
+    Sink = Sink + perfects;
+    return tried != 0;
+}
+
+
+/*
+    The median of cRepetitions runs, each of whole passes until minSeconds
+    is up.  One untimed pass first builds the shared tables and warms the
+    caches.
+*/
+static Result Measure(PerfectEngine engine, const CandidateSet& set, double minSeconds)
+{
+    typedef std::chrono::steady_clock   Clock;
+    std::vector<Result> runs(cRepetitions);
+    uint64_t            divisors = 0, allocations = 0;
+    size_t              count = 0;
+
+    RunEngine(engine, set, divisors);
+    for (size_t index = 0; index < set.candidates.size(); index++)
+        if (Takes(engine, set.candidates[index]))
+            count++;
+
+    for (int run = 0; run < cRepetitions; run++)
+    {
+        Clock::time_point   start = Clock::now();
+        double              seconds;
+        uint64_t            passes = 0;
+
+        divisors = 0;
+        do
+        {
+            uint64_t    before = Allocations.load(std::memory_order_relaxed);
+
+            RunEngine(engine, set, divisors);
+            allocations += Allocations.load(std::memory_order_relaxed) - before;
+            passes++;
+            seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (seconds < minSeconds);
+
+        runs[run].nsPerCandidate = seconds * 1e9 / ((double)passes * count);
+        runs[run].divisorsPerSecond = divisors / seconds;
+        runs[run].iterations = passes;
+    }
+
+    std::sort(runs.begin(), runs.end(),
+        [](const Result& a, const Result& b) { return a.nsPerCandidate < b.nsPerCandidate; });
+    runs[cRepetitions / 2].allocations = allocations;
+    return runs[cRepetitions / 2];
+}
+
+
+/*
+    One JSON object per line, so /B can read it back without a parser.
+*/
+static bool WriteJson(const char* fileName, const std::vector<Result>& results)
+{
+    FILE*   fd = fopen(fileName, "w");
+
+    if (fd == nullptr)
+    {
+        printf("ERROR: Cannot write '%s'.\n", fileName);
+        return false;
+    }
+
+    for (size_t index = 0; index < results.size(); index++)
+        fprintf(fd, "{\"name\": \"%s\", \"ns_per_candidate\": %.3f, \"divisors_per_second\": %.6g, \"passes\": %llu}\n",
+            results[index].name.c_str(), results[index].nsPerCandidate, results[index].divisorsPerSecond,
+            (unsigned long long)results[index].iterations);
+
+    return fclose(fd) == 0;
+}
+
+
+static bool CompareBaseline(const char* fileName, const std::vector<Result>& results, double tolerance)
+{
+    FILE*   fd = fopen(fileName, "r");
+    char    line[512], name[128];
+    double  baseline;
+    bool    passed = true;
+
+    if (fd == nullptr)
+    {
+        printf("ERROR: Cannot read baseline '%s'.\n", fileName);
+        return false;
+    }
+
+    printf("\nAgainst %s (%.0f%% allowed):\n", fileName, tolerance);
+    while (fgets(line, sizeof(line), fd) != nullptr)
+    {
+        if (sscanf(line, "{\"name\": \"%127[^\"]\", \"ns_per_candidate\": %lf", name, &baseline) != 2 || baseline <= 0)
+            continue;
+
+        for (size_t index = 0; index < results.size(); index++)
+        {
+            double  change;
+
+            if (results[index].name != name)
+                continue;
+
+            change = (results[index].nsPerCandidate / baseline - 1) * 100;
+            printf("%-34s %+8.1f%%%s\n", name, change, change > tolerance ? "  REGRESSION" : "");
+            if (change > tolerance)
+                passed = false;
+        }
+    }
+
+    fclose(fd);
+    return passed;
+}
@@ -0,0 +1,559 @@
+/*
+    PerfectCheck.cpp -- Cross-checks every PerfectLib engine against the
+    divisor loop of the original Perfect(), and gates their throughput.
+
+    To use:  PerfectCheck            (check every engine, time each one)
+             PerfectCheck /S:seed    (another set of random candidates)
+             PerfectCheck /B:file    (compare with the baseline in file; write it if there is none)
+             PerfectCheck /G:pct     (how far a throughput may drop with /B; 20)
+             PerfectCheck /U         (with /B: write the baseline anew after a passing run)
+             PerfectCheck /T         (only the Mersenne exponents of the transform; minutes)
+
+    The oracle is the loop Perfect() ran up to 1.14, every index from 2
+    to the root with its cofactor, widened to 64 bits and stopped once
+    the sum passes the value.  Every engine takes the same candidates:
+
+        the perfects 6, 28, 496, 8128 and 33550336
+        squares, where the root's cofactor is the root itself
+        values either side of cMaxULONG = 2^32 - 1, and 2^32 itself
+        2^64 - 2^y pairs an oracle can settle, the abundant ones
+        random values to 2^32 and 2^40, and random 2^x - 2^y pairs
+
+    A trial-division engine must tell perfect, abundant and deficient as
+    the oracle does (short counts as deficient); sigma must say perfect
+    exactly when it does; the Lucas-Lehmer and row engines and the
+    prefilter take the pairs.  Past 64 bits there is no oracle, so every
+    Euclid pair to hiPower 128 is checked against the known Mersenne
+    exponents instead, and so are lucas_lehmer() and fermat_prp3() on
+    exponents either side of each squaring threshold of BigMersenne.h:
+    Mersenne primes and prime p with 2^p - 1 composite.  The exponents
+    of the transform take minutes each, so only /T tests them.
+
+    Each engine is then timed over its candidates, the median of three
+    passes of at least 50 ms each.  With /B each one's candidates a
+    second are compared with a baseline file of JSON lines, and a drop of
+    more than /G percent fails the run.  A missing baseline is written
+    and passes, so the first run on a machine records it.  The exit
+    code is 0 for a pass, 1 for a wrong answer or a regression, and 2
+    for a bad command line or file.
+*/
+#include "Perfect.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+
+const int       cTimedPasses = 3;               // throughput is the median of this many
+const double    cMinSeconds = 0.05;             // each goes over the candidates until this is up
+const int       cRandomSmall = 2000;            // random values below 2^32
+const int       cRandomLarge = 100;             // ...and below 2^40
+const int       cRandomPairs = 300;             // random pairs up to hiPower 44
+const uint64_t  cMaxULONG = 0xFFFFFFFF;         // the top of the original ULONG range
+
+
+// The engines as PerfectCheck runs them; the last three take pairs only.
+enum CheckEngine
+{
+    cCheckTrialDivision,
+    cCheckSimd,
+    cCheckReciprocal,
+    cCheckSigma,
+    cCheckGpu,
+    cCheckRow,
+    cCheckLucasLehmer,
+    cCheckPrefilter,
+    cCheckCount
+};
+
+struct Candidate
+{
+    uint64_t        value;
+    unsigned        hiPower;                    // the 2^hiPower - 2^loPower pair, or 0 if not one
+    unsigned        loPower;
+    PerfectVerdict  expected;                   // the oracle's: perfect, abundant or short
+};
+
+// A prime exponent, and whether 2^p - 1 is prime too.
+struct Exponent
+{
+    unsigned        p;
+    bool            prime;
+};
+
+struct Timing
+{
+    std::string     name;
+    double          perSecond;                  // candidates
+};
+
+
+// Both sides of cKaratsubaLimbs (p = 4033) and of cNttLimbs (p = 98241).
+const Exponent  cSchoolbook[] = { { 89, true }, { 107, true }, { 127, true }, { 131, false }, { 521, true },
+                    { 523, false }, { 607, true }, { 613, false }, { 1277, false }, { 1279, true }, { 2203, true },
+                    { 2207, false }, { 2281, true }, { 3217, true }, { 3221, false } };
+const Exponent  cKaratsuba[] = { { 4093, false }, { 4099, false }, { 4253, true }, { 4423, true }, { 9689, true },
+                    { 9697, false }, { 9941, true }, { 9949, false } };
+const Exponent  cTransform[] = { { 98257, false }, { 110503, true } };
+
+
+static PerfectVerdict Original(uint64_t value);
+static std::vector<Candidate> MakeCandidates(uint64_t seed);
+static const char* CheckName(CheckEngine engine);
+static bool     TakesPlain(CheckEngine engine);
+static PerfectVerdict RunEngine(CheckEngine engine, const Candidate& candidate);
+static bool     Agrees(PerfectVerdict verdict, PerfectVerdict expected);
+static unsigned CheckEngines(const std::vector<Candidate>& candidates);
+static unsigned CheckWidePairs(void);
+static unsigned CheckExponents(const char* name, const Exponent* exponents, size_t count);
+static double   TimeEngine(CheckEngine engine, const std::vector<Candidate>& candidates);
+static bool     ReadBaseline(const char* fileName, std::vector<Timing>& baseline);
+static bool     WriteBaseline(const char* fileName, const std::vector<Timing>& timings);
+
+
+int main(int argc, char* argv[])
+{
+    const char*     baselineFile = "";
+    double          tolerance = 20;
+    bool            update = false, transform = false;
+    uint64_t        seed = 1994;
+    std::vector<Candidate> candidates;
+    std::vector<Timing> timings, baseline;
+    unsigned        wrong;
+    bool            regressed = false;
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        char    option = (argv[arg][0] == '/' || argv[arg][0] == '-') ? (char)toupper(argv[arg][1]) : 0;
+        const char* value = (option && argv[arg][2] == ':') ? &argv[arg][3] : nullptr;
+
+        if (option == 'S' && value && isdigit(*value))
+            seed = strtoull(value, nullptr, 10);
+        else if (option == 'B' && value && *value)
+            baselineFile = value;
+        else if (option == 'G' && value && atof(value) > 0)
+            tolerance = atof(value);
+        else if (option == 'U' && argv[arg][2] == '\0')
+            update = true;
+        else if (option == 'T' && argv[arg][2] == '\0')
+            transform = true;
+        else
+        {
+            printf("Usage: PerfectCheck [/S:seed] [/B:file [/G:percent] [/U]] | /T\n");
+            return 2;
+        }
+    }
+
+    if (transform)
+    {
+        wrong = CheckExponents("transform", cTransform, sizeof(cTransform) / sizeof(cTransform[0]));
+        printf(wrong ? "\n%u wrong answers.\n" : "\nEvery exponent agrees.\n", wrong);
+        return wrong ? 1 : 0;
+    }
+
+    candidates = MakeCandidates(seed);
+    printf("PerfectCheck -- %zu candidates (seed %llu), %s kernel, GPU %s\n\n", candidates.size(),
+        (unsigned long long)seed, simd_level_name(simd_level()), gpu_device_name());
+
+    wrong = CheckEngines(candidates) + CheckWidePairs()
+        + CheckExponents("schoolbook", cSchoolbook, sizeof(cSchoolbook) / sizeof(cSchoolbook[0]))
+        + CheckExponents("karatsuba", cKaratsuba, sizeof(cKaratsuba) / sizeof(cKaratsuba[0]));
+    if (wrong != 0)
+    {
+        printf("\n%u wrong answers.\n", wrong);
+        return 1;
+    }
+
+    if (*baselineFile && !ReadBaseline(baselineFile, baseline))
+        return 2;
+
+    printf("\n%-16s %14s %14s %9s\n", "Engine", "Candidates/s", "Baseline", "Change");
+    for (int engine = 0; engine < cCheckCount; engine++)
+    {
+        Timing      timing;
+        double      was = 0, change = 0;
+
+        timing.name = CheckName((CheckEngine)engine);
+        timing.perSecond = TimeEngine((CheckEngine)engine, candidates);
+        timings.push_back(timing);
+
+        for (size_t index = 0; index < baseline.size(); index++)
+            if (baseline[index].name == timing.name)
+                was = baseline[index].perSecond;
+        if (was > 0)
+            change = (timing.perSecond / was - 1) * 100;
+
+        printf("%-16s %14.6g ", timing.name.c_str(), timing.perSecond);
+        if (was > 0)
+            printf("%14.6g %+8.1f%%%s\n", was, change, change < -tolerance ? "  REGRESSION" : "");
+        else
+            printf("%14s %9s\n", "-", "-");
+        if (was > 0 && change < -tolerance)
+            regressed = true;
+    }
+
+    // the first run records the baseline, /U a passing run
+    if (*baselineFile && (baseline.empty() || (update && !regressed)))
+    {
+        if (!WriteBaseline(baselineFile, timings))
+            return 2;
+        printf("\nBaseline written to %s.\n", baselineFile);
+    }
+
+    if (regressed)
+    {
+        printf("\nAn engine fell more than %.0f%% below its baseline.\n", tolerance);
+        return 1;
+    }
+
+    printf("\nEvery engine agrees.\n");
+    return 0;
+}
+
+
+/*
+    Perfect() as it was, but for the width and for stopping once the sum
+    has passed value, which also keeps it from wrapping.
+*/
+static PerfectVerdict Original(uint64_t value)
+{
+    uint64_t    sum, index, factor, maxDivisor = isqrt<uint64_t>(value);
+
+    // main division loop
+    for (sum = 1, index = 2; index <= maxDivisor; index++)
+    {
+        // test to see if divisor is worth trying
+        if (value % index == 0)
+        {
+            // add factor
+            if (index > value - sum)
+                return cVerdictAbundant;
+            sum += index;
+
+            // get cofactor and add if the two are not the same
+            if ((factor = value / index) != index)
+            {
+                if (factor > value - sum)
+                    return cVerdictAbundant;
+                sum += factor;
+            }
+        }
+    }
+
+    return (sum == value) ? cVerdictPerfect : (sum > value) ? cVerdictAbundant : cVerdictShort;
+}
+
+
+static Candidate Plain(uint64_t value)
+{
+    Candidate   candidate = { value, 0, 0, Original(value) };
+
+    return candidate;
+}
+
+
+static Candidate Pair(unsigned hiPower, unsigned loPower)
+{
+    Candidate   candidate = Plain(pair_value<uint64_t>(hiPower, loPower));
+
+    candidate.hiPower = hiPower;
+    candidate.loPower = loPower;
+    return candidate;
+}
+
+
+/*
+    The fixed edge cases, then the random ones from seed.  Only values
+    the oracle settles in a moment are taken: up to 2^40 anything, and
+    past that the 2^64 - 2^y that are abundant within a few divisors.
+*/
+static std::vector<Candidate> MakeCandidates(uint64_t seed)
+{
+    std::vector<Candidate>  candidates;
+    std::mt19937_64         random(seed);
+    const uint64_t          perfects[] = { 6, 28, 496, 8128, 33550336 };
+    const uint64_t          roots[] = { 2, 3, 4, 5, 7, 11, 12, 30, 97, 210, 1009, 4093, 65521, 65535, 65536, 1048573 };
+
+    for (size_t index = 0; index < sizeof(perfects) / sizeof(perfects[0]); index++)
+        candidates.push_back(Plain(perfects[index]));
+    for (unsigned power = 2; power <= 13; power++)
+        candidates.push_back(Pair(2 * power - 1, power - 1));
+
+    for (size_t index = 0; index < sizeof(roots) / sizeof(roots[0]); index++)
+        candidates.push_back(Plain(roots[index] * roots[index]));
+
+    for (uint64_t value = cMaxULONG - 8; value <= cMaxULONG + 8; value++)
+        candidates.push_back(Plain(value));
+
+    // but 2^64 - 2^33, whose abundance takes the engines seconds to find
+    for (unsigned loPower = 32; loPower < 63; loPower++)
+        if (loPower != 33)
+            candidates.push_back(Pair(64, loPower));
+    candidates.push_back(Pair(64, 31));
+    candidates.push_back(Pair(63, 31));
+
+    for (int index = 0; index < cRandomSmall; index++)
+        candidates.push_back(Plain(2 + random() % (cMaxULONG - 1)));
+    for (int index = 0; index < cRandomLarge; index++)
+        candidates.push_back(Plain(2 + random() % (((uint64_t)1 << 40) - 2)));
+    for (int index = 0; index < cRandomPairs; index++)
+    {
+        unsigned    hiPower = 2 + (unsigned)(random() % 43);
+
+        candidates.push_back(Pair(hiPower, 1 + (unsigned)(random() % (hiPower - 1))));
+    }
+
+    return candidates;
+}
+
+
+static const char* CheckName(CheckEngine engine)
+{
+    static const char*  names[cCheckCount] = { "trial-division", "simd", "reciprocal", "sigma", "gpu", "row",
+                            "lucas-lehmer", "prefilter" };
+
+    return names[engine];
+}
+
+
+static bool TakesPlain(CheckEngine engine)
+{
+    return engine != cCheckRow && engine != cCheckLucasLehmer && engine != cCheckPrefilter;
+}
+
+
+/*
+    The engine's verdict on one candidate.  Those that only say perfect
+    or not say cVerdictRejected for not.
+*/
+static PerfectVerdict RunEngine(CheckEngine engine, const Candidate& candidate)
+{
+    PerfectVerdict  verdict;
+
+    switch (engine)
+    {
+    case cCheckTrialDivision:
+        return trial_verdict<uint64_t>(candidate.value, cEngineTrialDivision);
+    case cCheckSimd:
+        return trial_verdict<uint64_t>(candidate.value, cEngineSimd);
+    case cCheckReciprocal:
+        return trial_verdict<uint64_t>(candidate.value, cEngineReciprocal);
+    case cCheckSigma:
+        return is_perfect_sigma<uint64_t>(candidate.value) ? cVerdictPerfect : cVerdictRejected;
+    case cCheckGpu:
+        gpu_verdicts<uint64_t>(&candidate.value, 1, &verdict);
+        return verdict;
+    case cCheckRow:
+        return pair_verdict<uint64_t>(candidate.hiPower, candidate.loPower);
+    case cCheckLucasLehmer:
+        return is_perfect_pair(candidate.hiPower, candidate.loPower) ? cVerdictPerfect : cVerdictRejected;
+    default:
+        return (prefilter_pair(candidate.hiPower, candidate.loPower) == cPrefilterPassed)
+            ? cVerdictPerfect : cVerdictRejected;
+    }
+}
+
+
+/*
+    Perfect must match both ways.  An engine that says more must say what
+    the oracle says: abundant is abundant, and deficient and short are
+    both short of it.
+*/
+static bool Agrees(PerfectVerdict verdict, PerfectVerdict expected)
+{
+    if ((verdict == cVerdictPerfect) != (expected == cVerdictPerfect))
+        return false;
+    if (verdict == cVerdictAbundant)
+        return expected == cVerdictAbundant;
+    if (verdict == cVerdictDeficient || verdict == cVerdictShort)
+        return expected == cVerdictShort;
+
+    return true;
+}
+
+
+static unsigned CheckEngines(const std::vector<Candidate>& candidates)
+{
+    unsigned    wrong = 0;
+
+    for (int engine = 0; engine < cCheckCount; engine++)
+    {
+        unsigned    tested = 0, before = wrong;
+
+        for (size_t index = 0; index < candidates.size(); index++)
+        {
+            const Candidate&    candidate = candidates[index];
+            PerfectVerdict      verdict;
+
+            if (!TakesPlain((CheckEngine)engine) && candidate.hiPower == 0)
+                continue;
+
+            verdict = RunEngine((CheckEngine)engine, candidate);
+            tested++;
+            if (!Agrees(verdict, candidate.expected))
+            {
+                printf("WRONG: %s says %llu", CheckName((CheckEngine)engine), (unsigned long long)candidate.value);
+                if (candidate.hiPower != 0)
+                    printf(" (2^%u - 2^%u)", candidate.hiPower, candidate.loPower);
+                printf(" is %s; the original loop says %s.\n", verdict_name(verdict), verdict_name(candidate.expected));
+                wrong++;
+            }
+        }
+
+        printf("%-16s %6u candidates, %s\n", CheckName((CheckEngine)engine), tested, wrong == before ? "all agree" : "WRONG");
+    }
+
+    return wrong;
+}
+
+
+/*
+    Every Euclid pair to hiPower 128 from the Lucas-Lehmer engine and the
+    prefilter (as far as 2^64 - 1), against the Mersenne exponents known:
+    past 64 bits no division could check them.
+*/
+static unsigned CheckWidePairs(void)
+{
+    const unsigned  mersennes[] = { 2, 3, 5, 7, 13, 17, 19, 31, 61, 89, 107, 127 };
+    unsigned        wrong = 0, checked = 0;
+
+    for (unsigned exponent = 2; 2 * exponent - 1 <= cMaxPower; exponent++)
+    {
+        bool        prime = std::find(std::begin(mersennes), std::end(mersennes), exponent) != std::end(mersennes);
+        bool        lucas = is_perfect_pair(2 * exponent - 1, exponent - 1);
+        bool        passed = prefilter_pair(2 * exponent - 1, exponent - 1) == cPrefilterPassed;
+
+        checked++;
+        if (lucas != prime || (exponent <= 64 && passed != prime))
+        {
+            printf("WRONG: 2^%u - 1 is %s; Lucas-Lehmer says %s, the prefilter %s.\n", exponent,
+                prime ? "prime" : "composite", lucas ? "prime" : "composite", passed ? "prime" : "composite");
+            wrong++;
+        }
+    }
+
+    printf("%-16s %6u Euclid pairs to hiPower %u, %s\n", "mersennes", checked, cMaxPower, wrong ? "WRONG" : "all agree");
+    return wrong;
+}
+
+
+/*
+    lucas_lehmer() and fermat_prp3() on each exponent, against what is
+    known of 2^p - 1.
+*/
+static unsigned CheckExponents(const char* name, const Exponent* exponents, size_t count)
+{
+    unsigned        wrong = 0;
+
+    for (size_t index = 0; index < count; index++)
+    {
+        const Exponent& exponent = exponents[index];
+        bool            lucas = lucas_lehmer(exponent.p);
+        bool            fermat = fermat_prp3(exponent.p);
+
+        if (lucas != exponent.prime || fermat != exponent.prime)
+        {
+            printf("WRONG: 2^%u - 1 is %s; Lucas-Lehmer says %s, Fermat %s.\n", exponent.p,
+                exponent.prime ? "prime" : "composite", lucas ? "prime" : "composite", fermat ? "prime" : "composite");
+            wrong++;
+        }
+    }
+
+    printf("%-16s %6zu exponents, %zu to %zu limbs, %s\n", name, count, (size_t)(exponents[0].p + 63) / 64,
+        (size_t)(exponents[count - 1].p + 63) / 64, wrong ? "WRONG" : "all agree");
+    return wrong;
+}
+
+
+/*
+    The median of cTimedPasses passes, each over the engine's candidates
+    as many times as fill cMinSeconds.
+*/
+static double TimeEngine(CheckEngine engine, const std::vector<Candidate>& candidates)
+{
+    typedef std::chrono::steady_clock   Clock;
+    double          rates[cTimedPasses];
+    unsigned        sink = 0;
+
+    for (int pass = 0; pass < cTimedPasses; pass++)
+    {
+        Clock::time_point   start = Clock::now();
+        size_t              count = 0;
+        double              seconds;
+
+        do
+        {
+            for (size_t index = 0; index < candidates.size(); index++)
+            {
+                if (!TakesPlain(engine) && candidates[index].hiPower == 0)
+                    continue;
+                sink += RunEngine(engine, candidates[index]) == cVerdictPerfect;
+                count++;
+            }
+            seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (seconds < cMinSeconds);
+
+        rates[pass] = seconds > 0 ? count / seconds : 0;
+    }
+
+    std::sort(rates, rates + cTimedPasses);
+    return sink != 0 ? rates[cTimedPasses / 2] : 0;
+}
+
+
+/*
+    One JSON object per line, {"engine": name, "candidates_per_second": n},
+    as WriteBaseline() writes them; a file that is not there is an empty
+    baseline.
+*/
+static bool ReadBaseline(const char* fileName, std::vector<Timing>& baseline)
+{
+    FILE*   fd = fopen(fileName, "r");
+    char    line[512], name[128];
+    Timing  timing;
+
+    if (fd == nullptr)
+        return true;
+
+    while (fgets(line, sizeof(line), fd) != nullptr)
+    {
+        if (sscanf(line, "{\"engine\": \"%127[^\"]\", \"candidates_per_second\": %lf", name, &timing.perSecond) != 2
+            || timing.perSecond <= 0)
+            continue;
+        timing.name = name;
+        baseline.push_back(timing);
+    }
+
+    fclose(fd);
+    if (baseline.empty())
+    {
+        printf("ERROR: '%s' is not a baseline.\n", fileName);
+        return false;
+    }
+    return true;
+}
+
+
+static bool WriteBaseline(const char* fileName, const std::vector<Timing>& timings)
+{
+    FILE*   fd = fopen(fileName, "w");
+
+    if (fd == nullptr)
+    {
+        printf("ERROR: Cannot write '%s'.\n", fileName);
+        return false;
+    }
+
+    for (size_t index = 0; index < timings.size(); index++)
+        fprintf(fd, "{\"engine\": \"%s\", \"candidates_per_second\": %.6g}\n",
+            timings[index].name.c_str(), timings[index].perSecond);
+
+    return fclose(fd) == 0;
+}
@@ -1,14 +1,105 @@
 /*
-    PerfectNumbers.cpp -- Find as many perfect numbers as exist in 32 bits.
-
-    To use:  PerfectNumbers        (no arguments)
+    PerfectNumbers.cpp -- Find as many perfect numbers as exist in 128 bits.
+
+    To use:  PerfectNumbers                  (Lucas-Lehmer engine)
+             PerfectNumbers /V               (Verify: trial-divide every candidate)
+             PerfectNumbers /S               (trial division on the SIMD kernel)
+             PerfectNumbers /R               (trial division by table Reciprocals)
+             PerfectNumbers /F               (sigma from the prime Factorization)
+             PerfectNumbers /G               (trial division of whole rows on the GPU)
+             PerfectNumbers /B               (Batched rows: sigma(2^y) in closed form)
+             PerfectNumbers /M:p             (then on past 128 bits, to Mersenne exponent p)
+             PerfectNumbers /O:file          (stream the perfects to file, .csv or JSON lines)
+             PerfectNumbers /A               (...and every other verdict too)
+             PerfectNumbers /Y[:s]           (force the Output to disk every write, or every s seconds)
+             PerfectNumbers /T[:n]           (sweep with n Threads; all cores if no n)
+             PerfectNumbers /P[:a,b...]      (Pin the threads, spread over the NUMA nodes, or nodes a, b...)
+             PerfectNumbers /C:n             (save the Context every n seconds; 0 never)
+             PerfectNumbers /N[:port]        (coordinate a Network of workers)
+             PerfectNumbers /L:n             (re-issue a lease after n quiet seconds)
+             PerfectNumbers /W:host[:port]   (Work for the coordinator on host)
+             PerfectNumbers /I:a-b           (every perfect, abundant and amicable n In [a, b])
+             PerfectNumbers /I:a-b /O:file   (...with the class of each n mapped into file; /A adds s(n))
+             PerfectNumbers /X:a-b           (sweep only the bands hiPower = a to b)
+             PerfectNumbers /K:file          (Keep the context in file; the cache and stats take its name)
+             PerfectNumbers --quiet          (only the perfects and how the run ended; no bell)
+             PerfectNumbers --no-bell        (no bell for each perfect)
+             PerfectNumbers --verify         (test every perfect found a second way)
+             PerfectNumbers /H[:port]        (serve the progress over HTTP, for Prometheus)
+             PerfectNumbers /Q[:f]           (Queue the candidates through stages: f filter threads, /T testers)
+             PerfectNumbers /E                (only Euclid pairs whose 2^p - 1 passes Miller-Rabin reach the engine)
 
     This program uses a brute-force approach to finding perfect numbers:
     numbers whose factors (including one and the number) add to twice the
     number.
 
-    Since the largest integer supported by the C++ language is an unsigned
-    long (32 bits), the highest divisor needs to be at most 16 bits long.
+    By default only candidates of the Euclid form 2^(p-1) * (2^p - 1) are
+    examined, and 2^p - 1 is tested for primality with Lucas-Lehmer; every
+    other 2^x - 2^y pair is rejected without a single division.  The /V
+    switch restores the brute-force trial division of every candidate
+    past 2^40; below that the verdicts were worked out by the compiler
+    (PerfectTable.h), so /V and the engines like it start there at once.
+
+    With /T the candidates are spread over a work-stealing thread pool, and
+    a candidate with a long divisor range is itself split into pieces that
+    idle workers can steal.  Perfects are still reported in ascending order.
+
+    /S runs the same trial division with the divisibility test vectorized
+    (AVX-512, AVX2 or NEON, whichever the CPU has): every lane tests one
+    divisor by reciprocal multiplication instead of a hardware divide.
+
+    /R runs it with every % and / replaced by a multiply and shift, using
+    magic-number reciprocals of the divisors worked out once into a table
+    that all threads share.
+
+    /F factors each candidate against a shared, segmented prime sieve and
+    takes sigma(n) from the multiplicative formula, so a candidate costs a
+    division per prime tried rather than one per divisor, and most are out
+    at their first prime factor.
+
+    /G hands each whole loPower row to the GPU through OpenCL, which
+    sweeps a chunk of divisors of every candidate of the row per launch;
+    without a device it falls back to the SIMD kernel.
+
+    /B takes a row at a time too, on the CPU: every candidate is 2^y * m
+    with m = 2^(x-y) - 1 odd, sigma(2^y) = 2^(y+1) - 1 needs no division,
+    and a perfect needs 2^(y+1) - 1 to divide m, so only the few rows'
+    candidates with y + 1 dividing x - y are left to divide, and those by
+    the odd numbers up to the root of m alone.
+
+    /M:p carries the Lucas-Lehmer engine on past the 128-bit bands, up to
+    2^p - 1: one Euclid pair per exponent, with the residue s held in as
+    many 64-bit limbs as it takes.  The perfects are kept by exponent, so
+    they are not bounded by any word size either.
+
+    /O:file streams every perfect, as it is found, to a file that other
+    tools can tail: CSV if its name ends in .csv, JSON lines otherwise,
+    and with /A every abundant, deficient and rejected candidate as well.
+    A writer thread of its own does the writing, so a slow disk never
+    holds up the sweep.
+
+    /I:a-b leaves the 2^x - 2^y pairs and takes every n from a to b, by a
+    segmented sieve of sigma(n) (RangeScan.cpp): each perfect and amicable
+    pair is printed as it is found, with the abundant and deficient counts
+    as it goes.  It keeps no context: a stopped scan says where to start
+    again.  With /O:file the class of every n, and with /A its aliquot sum
+    s(n) too, goes into columns of a mapped file (RangeFile.h) that tools
+    index rather than parse; the file says how far it is written, so the
+    same command carries a stopped scan on.
+
+    For a batch scheduler, /X:a-b bounds the sweep to the bands of hiPower
+    a to b and /K:file names its context, so runs of different bounds
+    never share one; a context knows the bands it was saved for and is
+    refused by a run of any others.  --quiet leaves only the perfects and
+    the last word on the console, --verify checks each perfect by sigma()
+    from its factors or by a Fermat test of 2^p - 1, and the exit status
+    says how the run went: 0 done, 1 stopped, 2 not started (the command
+    line or a file), 3 a perfect that failed --verify.
+
+    The candidate type is a template parameter: each band of hiPower is
+    swept with the narrowest unsigned type that holds it (32, 64 and, where
+    the compiler has one, 128 bits), so the highest divisor is at most half
+    that width and the small bands never pay for the wide arithmetic.
 */
 /*  HISTORY:
     1.00  19-Aug-90  First version.  Used a table of prime numbers to find
@@ -70,147 +161,1240 @@
     where x > y.  Adjusted the algorithm accordingly.
 
     1.14  15-Jul-2020  Porting algorithm to Visual Studio as a console application.
+
+    1.15  14-Oct-2026  Made the candidate type a template parameter.  The
+    2^x - 2^y sweep now runs in 32-, 64- and 128-bit bands instead of
+    stopping at hiPower 31; Perfect() uses an integer square root and
+    stops as soon as the sum passes the value, so it can no longer wrap.
+
+    1.16  14-Oct-2026  Added the Lucas-Lehmer engine, now the default: a
+    candidate is tested only if it is 2^(p-1) * (2^p - 1) with p prime,
+    and then by the Lucas-Lehmer residue of 2^p - 1.  Trial division is
+    kept as the /V (verify) mode.
+
+    1.17  14-Oct-2026  Added the /T parallel sweep on a work-stealing thread
+    pool (ThreadPool.cpp).  Large candidates are split into divisor ranges;
+    results are gathered in sweep order so they still print ascending.
+
+    1.18  14-Oct-2026  Removed the global state from the tests.  The
+    reentrant is_perfect() / divisor_sum() API now lives in PerfectLib
+    (Perfect.cpp), and LoopForPerfects() in its own PerfectSweep target
+    (LoopForPerfects.cpp), which reports through a SweepListener.  This
+    file is just the console program built on top of the two.
+
+    1.19  14-Oct-2026  Added the /S SIMD trial-division engine
+    (SimdKernel.cpp): 8 or 16 divisors per step with AVX2, AVX-512 or
+    NEON, chosen at run time by CPUID.  It finds the same divisors as the
+    scalar loop and adds them through it, so the sums are identical.
+
+    1.20  14-Oct-2026  Added the /R reciprocal engine (Reciprocal.cpp):
+    libdivide-style magic numbers for every divisor up to the current
+    maximum, built on demand into read-only shared tables, turn each
+    division in the loop into a multiply and a shift.
+
+    1.21  14-Oct-2026  Back to the prime factorization of 1.00, done right:
+    the /F sigma engine (PrimeSieve.cpp) takes each prime power once and
+    multiplies up sigma(p^e) = 1 + p + ... + p^e, so no factor is repeated.
+    The primes come from a segmented sieve, built once below cMaxPrime and
+    grown on demand for the 64-bit band.
+
+    1.22  14-Oct-2026  Reinstated the "too large" filters of 1.07/1.08 as
+    early exits in the trial division: a candidate is out as soon as its
+    sum passes it (abundant), or as soon as the divisors left could not
+    make it up (deficient).  The S summary counts how each was settled.
+
+    1.23  14-Oct-2026  The context file finally records where the sweep
+    is: the last hiPower/loPower settled, which a restart resumes after.
+    It now has a header with a version and a CRC-32, is written to a
+    temporary file and renamed over the old one, and is saved on its
+    own every five minutes (/C:n to change).  Old files still load; one
+    that does not is renamed to .bad before the sweep starts over.
+
+    1.24  14-Oct-2026  The keyboard moved to a control thread of its own,
+    along with the interval saves: the sweep no longer calls _kbhit() per
+    candidate, it only reads a stop flag, and it keeps running while the
+    menu is up.  SIGINT, SIGTERM and the console close, logoff and
+    shutdown events save the context and stop, so it also runs headless.
+
+    1.25  14-Oct-2026  Builds on Linux and macOS too.  The keyboard, the
+    clock, the file calls and the stop events went behind Platform.h,
+    with a Win32 and a POSIX side, and CMakeLists.txt builds the whole
+    tree with -O3, -march=native and link-time optimization.
+
+    1.26  14-Oct-2026  Instrumented the sweep: steady-clock time, candidates,
+    trial divisors and early exits per hiPower band, and the same per
+    worker thread.  The S summary prints them, and D (or the end of the
+    run) writes them to PerfectNumbers.stats.json for scripts.
+
+    1.27  14-Oct-2026  PerfectBench: microbenchmarks of each engine on
+    fixed sets of perfect, abundant, deficient, near-perfect and prime
+    candidates, with median times, JSON output, and a baseline compare
+    that fails on a regression.
+
+    1.28  14-Oct-2026  Distributed sweep: /N coordinates workers over TCP,
+    leasing out one hiPower band (one Mersenne exponent) at a time, and
+    /W:host works for it.  Workers report progress every ten seconds; a
+    lease that goes quiet is re-issued from the last report.  The context
+    file (version 3) also lists the bands started past the position.
+
+    1.29  14-Oct-2026  /G: a GPU engine through OpenCL.  Each loPower row
+    goes to the device as one batch, swept a chunk of divisors per launch
+    with the next chunk computing while the last one's sums come back.
+    Builds without OpenCL, or runs without a device, on the SIMD kernel.
+
+    1.30  14-Oct-2026  /B: the row engine.  sigma(2^y) is taken in closed
+    form, so a pair is divided only when 2^(y+1) - 1 divides its odd part,
+    and then by odd numbers up to the odd part's square root.
+
+    1.31  14-Oct-2026  /M: Lucas-Lehmer past 64-bit exponents, on a big
+    residue squared by schoolbook, Karatsuba or a number-theoretic
+    transform by size, out of one arena allocated per exponent.  The
+    perfect array holds exponents; context file version 4.
+
+    1.32  14-Oct-2026  /O:file streams the results as JSON lines or CSV
+    through a buffered writer thread, /A with every verdict, /Y forcing
+    them to disk as often as asked.
+
+    1.33  14-Oct-2026  Every pair up to hiPower 40 (PERFECT_TABLE_POWER)
+    is settled from a table the compiler builds from sigma of the odd
+    parts, so the dividing engines do no trial division below it.
+
+    1.34  14-Oct-2026  The filters of 1.10 and 1.11 are back, as a wheel:
+    every kernel divides only by numbers coprime to those of 2, 3, 5, 7
+    and 11 that don't divide the value, which for most pairs is 42% of
+    the range and for an odd part 21%.  The SIMD lanes load their spokes
+    straight from the wheel.
+
+    1.35  14-Oct-2026  /I:a-b: a range scan of every n in [a, b], not
+    just the 2^x - 2^y pairs, on a segmented divisor-sum sieve.  It counts
+    perfect, abundant and deficient numbers and finds the amicable pairs,
+    one segment per thread.
+
+    1.36  14-Oct-2026  /I:a-b /O:file stores the scan in a mapped,
+    preallocated file: two bits of class per n and, with /A, a packed
+    s(n) column, a segment per view.  Rerun, it carries on where it
+    stopped.
+
+    1.37  14-Oct-2026  The row engine keeps how far it got with each odd
+    part 2^k - 1 in a bounded cache (SigmaCache.cpp), so the pairs of one
+    width after the first start past the divisors already summed.  It is
+    saved with the context, in PerfectNumbers.cache, and S and the stats
+    file show its hit rate.
+
+    1.38  14-Oct-2026  The engines take their buffers from a per-thread
+    scratch arena rewound between candidates (Scratch.cpp), and the big
+    residues take their limbs from a shared free list, so a warmed-up
+    sweep tests candidates without calling malloc.  A PerfectBench built
+    with PERFECT_COUNT_ALLOCATIONS fails if a timed pass allocates.
+
+    1.39  14-Oct-2026  /P pins the /T threads, a block of them to each
+    NUMA node (or to the nodes listed).  Each worker steals within its
+    node before it crosses to another, a band's candidates are dealt to
+    the nodes in turn, and the prime and reciprocal tables are copied
+    onto every node that reads them (Topology.cpp, NodeLocal.h).
+
+    1.40  14-Oct-2026  For batch runs: /X:a-b bounds the bands, /K:file
+    names the context (version 5, which records its bands), --quiet and
+    --no-bell quiet the console, --verify tests each perfect a second
+    way, and the exit status tells done, stopped, failed and unverified
+    apart; it had been 1 for done and 0 for a bad command line.
+
+    1.41  14-Oct-2026  /H[:port] serves the progress on a thread of its
+    own, as Prometheus text at /metrics (Metrics.cpp): the position, the
+    perfects, candidates and divisions a second, the sigma cache hit rate
+    and the checkpoint age, all from atomics, so a scrape never holds up
+    the sweep.
+
+    1.42  14-Oct-2026  /Q[:f]: the staged sweep.  A generator, f filter
+    threads, the /T test threads and the reporter pass the candidates
+    down bounded lock-free queues (StageQueue.h).  The filters settle
+    what the abundance bound and mod 3 settle without an engine; the
+    reporter puts the verdicts back in order, so a slow listener holds
+    up nothing but the generator.  S, the stats file and /metrics show
+    each stage's queue depth.
+
+    1.43  14-Oct-2026  /E: a prefilter ahead of the engine.  A pair can
+    be perfect only in the Euclid form with 2^p - 1 prime, so the rest
+    are rejected by a comparison, and 2^p - 1 by Miller-Rabin to twelve
+    bases (exact below 2^64, is_prime64()); only a Mersenne prime's pair
+    reaches the engine.  S, the stats file and /metrics count each step.
+
+    1.44  14-Oct-2026  PerfectCheck, run by ctest: every engine and the
+    prefilter against the original Perfect() divisor loop on a fixed set
+    of perfects, squares, values about cMaxULONG and seeded random ones,
+    the Euclid pairs to 2^128 against the known Mersenne primes, and each
+    engine's throughput against a baseline kept in the build tree.
 */
 /*
     Context File Format - since processing is so compute-intensive, the
     complete context is saved into a file for restoral and continuance.
+    Every field is little-endian; the file is replaced whole by rename.
 
+    char        magic[8];           "PerfNum" and a NUL
+    ULONG       version;            cContextVersion
+    ULONG       length;             bytes in the body that follows
+    ULONG       checksum;           CRC-32 of the body
+    body:
     double      elapsedTime;
+    ULONG       hiPower, loPower;   the last candidate settled (0, 0 for none)
     USHORT      numPerfects;
-    ULONG       PerfectArray[];
-    ULONG       curValue;
+    ULONG       PerfectArray[];     exponent p of each 2^(p-1) * (2^p - 1); versions 2 and 3
+                                    had the uint128 values, low 64 bits first
+    ULONGLONG   VerdictCount[cVerdictCount];
+    USHORT      numBands;           version 3 on
+    ULONG       hiPower, loPower;   per band past the position, its lowest loPower settled
+    ULONG       first, last;        version 5 on: the bands of hiPower the run sweeps (/X)
+
+    The sweep reports candidates in order even with /T, so the last one
+    settled is the point every worker resumes after.  The workers of /N
+    finish bands in any order; those they have started past the position
+    are listed after it.  Past cMaxPower (/M) the position is the Euclid
+    pair of the last exponent tested.
 */
-const char* cVERSION = "1.14";
+const char* cVERSION = "1.44";
 
-#include <dos.h>
-#include <conio.h>
 #include <ctype.h>
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
-#include <ATLComTime.h>
-#include <sys/timeb.h>
-#include <minwindef.h>
-
-
-const int       cMaxPerfects = 32;
-const ULONG     cMaxPrime = 0x00010000;
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "Platform.h"
+#include "Distribute.h"
+#include "LoopForPerfects.h"
+#include "Metrics.h"
+#include "RangeFile.h"
+#include "RangeScan.h"
+#include "ResultSink.h"
+#include "SigmaCache.h"
+#include "ThreadPool.h"
+
+
+const int       cMaxPerfects = 64;
+const size_t    cMaxDigitsShown = 60;           // longer perfects are shown by their exponent
 const ULONG     cMaxULONG = 0xFFFFFFFF;
 const long      cMaxLong  = 0x80000000;
 
-ULONG           PerfectArray[cMaxPerfects];     // the perfect number array
+const char      cContextFile[] = "PerfectNumbers.dat";
+const char      cContextMagic[8] = { 'P', 'e', 'r', 'f', 'N', 'u', 'm', '\0' };
+const ULONG     cContextVersion = 5;            // 1 was the headerless file before 1.23, 2 had no bands, 3 held values, 4 no bounds
+const size_t    cContextHeader = 20;            // magic, version, length, checksum
+const ULONG     cContextMaxBody = 0x00010000;
+const ULONG     cControlMillis = 50;            // how often the control thread looks at the keyboard
+const char      cStatsSuffix[] = ".stats.json";    // after the context file's name, less its extension
+const char      cCacheSuffix[] = ".cache";
+const char      cTempSuffix[] = ".tmp";
+const char      cCacheMagic[8] = { 'P', 'e', 'r', 'f', 'S', 'i', 'g', '\0' };
+const ULONG     cCacheVersion = 1;
+const size_t    cCacheEntry = 41;               // odd, sum, reached, complete
+const double    cRangeReportSeconds = 10.0;     // how often a range scan says where it is
+
+const int       cExitDone = 0;                  // the run is done, or there was nothing to do
+const int       cExitStopped = 1;               // stopped by a signal, the menu or a failing file
+const int       cExitFailed = 2;                // never started: the command line or a file would not do
+const int       cExitUnverified = 3;            // --verify: a perfect failed its second test
+
+// Console state: what the menu and the context file show.  The sweep
+// itself keeps none of this; it arrives through ConsoleListener.
+ULONG           PerfectArray[cMaxPerfects];     // the perfects found, by exponent p of 2^(p-1) * (2^p - 1)
 USHORT          numPerfects;                    // the number of perfects found
-ULONG           curValue;                       // the current, testing value
-USHORT          maxDivisor;                     // maximum divisor to test
+PerfectValue    curValue;                       // the latest tested value; 0 past cMaxPower
 ULONG           hiPower;                        // higher of the two powers of two
 ULONG           loPower;                        // lower of the two powers of two
-
-struct timeb    startTime;                      // structure for time at start of work
-struct timeb    finalTime;                      // structure for time at end of work
+ULONGLONG       VerdictCount[cVerdictCount];    // candidates settled, by how
+ULONG           BandSettled[cMaxPower + 1];     // past the position: lowest loPower settled, 0 none
+SweepStats      Stats;                          // where the sweep spends its time
+SigmaCache      OddCache;                       // the row engine's odd parts, saved with the context
+SweepOptions    Options;                        // how the sweep was started
+std::mutex      StateLock;                      // guards the state above, held only to change or copy it
+std::mutex      ConsoleLock;                    // guards the console and the elapsed time below
+
+double          startTime;                      // wall_seconds() at start of work
+double          finalTime;                      // wall_seconds() at end of work
 double          elapsedTime;                    // floating-point elapsed CPU time
-
-bool            LoopForPerfects(void);
-bool            Perfect(void);
+double          lastSaveTime;                   // when the context was last saved
+ULONG           CheckpointSeconds = 300;        // save the context this often; 0 never
+ResultSink      Results;                        // the /O file, if there is one
+
+std::atomic<bool>   StopSweep(false);           // set by the menu or a signal to stop the sweep
+std::atomic<bool>   SaveOnStop(false);          // ...and save the context once it has stopped
+std::atomic<bool>   SweepOver(false);           // the sweep is done; the control thread ends
+std::atomic<bool>   ContextSettled(false);      // the last save is on disk; the process may go
+std::vector<ThreadPlace> Places;                // /P: where each worker is pinned; empty unpinned
+std::string     ContextFile = cContextFile;     // /K: the context, and from its name the others
+std::string     CacheFile;
+std::string     StatsFile;
+ULONG           firstBand = 3;                  // /X: the bands this run sweeps
+ULONG           lastBand = cMaxPower;
+ULONG           contextFirst, contextLast;      // the bands of the context file read; 0 for none
+bool            Quiet = false;                  // --quiet: only the perfects and the outcome
+bool            Bell = true;                    // --no-bell clears it, --quiet too
+bool            Verify = false;                 // --verify: a second test for every perfect
+ULONG           Verified, Unverified;           // ...and how they came out
+MetricsServer   Metrics;                        // /H
+PipelineOptions Pipeline;                       // /Q: the staged sweep
+PipelineStats   PipelineCounts;                 // ...and its queues
+
+// What /metrics reports of the state under StateLock, copied as it
+// changes, so that a scrape reads it without the lock
+std::atomic<ULONG>      LiveHiPower(0), LiveLoPower(0), LivePerfects(0);
+std::atomic<ULONGLONG>  LiveVerdicts[cVerdictCount];
+std::atomic<double>     LiveSaveTime(0);        // 0 with no context to save
+std::atomic<double>     LiveStartTime(0);       // wall_seconds() the run began; startTime moves on
+
+int             RecordPerfect(ULONG exponent);
+void            AnnouncePerfect(ULONG exponent, int index);
+ULONG           PerfectExponent(PerfectValue value);
+std::string     PerfectText(ULONG exponent);
+std::string     PositionText(void);
+ULONG           NextBand(void);
+void            AdvancePosition(void);
 void            PrintElapsedTime(void);
-bool            ProcessInput(void);
+void            TickElapsedTime(void);
+void            PrintProgressTime(void);
+void            PrintStats(void);
+bool            DumpStats(void);
+void            PublishProgress(void);
+std::string     MetricsText(void);
+void            ControlLoop(void);
+void            OnStop(void);
+bool            ParseRange(const char* text, RangeOptions& range);
+bool            ParseNodes(const char* text, std::vector<unsigned>& nodes);
+bool            ParseBands(const char* text, ULONG& first, ULONG& last);
+void            NameFiles(const std::string& contextFile);
+bool            VerifyPerfect(ULONG exponent);
+bool            VerifyFound(uint64_t value, uint64_t partner);
+std::string     PlacesText(void);
+int             RunRangeScan(RangeOptions& range, const std::string& fileName, bool sums);
+bool            ProcessInput(int key);
+ULONG           ContextChecksum(const unsigned char* data, size_t length);
+void            PutField(std::vector<unsigned char>& buffer, ULONGLONG value, int bytes);
+ULONGLONG       GetField(const unsigned char*& data, int bytes);
+bool            ReadLegacyContext(FILE* fd);
+bool            SetAsideContext(void);
 bool            ReadContext(void);
+std::vector<unsigned char> ContextImage(void);
+bool            WriteContext(const std::vector<unsigned char>& file);
 bool            SaveContext(void);
+bool            ReadCache(void);
+bool            SaveCache(void);
+
+
+/*
+    Feeds the sweep's results into the console state.  The keyboard, the
+    signals and the checkpoint interval are the control thread's.  Every
+    settled candidate takes StateLock, which nothing holds across a write
+    or a print; only a perfect waits for the console, after it is let go.
+*/
+class ConsoleListener : public SweepListener
+{
+public:
+    void Tested(unsigned hi, unsigned lo, PerfectValue value, PerfectVerdict verdict)
+    {
+        int     index = -1;
+
+        {
+            std::lock_guard<std::mutex> guard(StateLock);
+
+            // a distributed run may have settled part of this band already
+            if (hi <= cMaxPower && BandSettled[hi] != 0 && lo >= BandSettled[hi])
+                return;
+            if (hi <= cMaxPower)
+                BandSettled[hi] = 0;
+
+            hiPower = hi;
+            loPower = lo;
+            curValue = value;
+            VerdictCount[verdict]++;
+            Results.Record(hi, lo, value, verdict);
+            if (verdict == cVerdictPerfect)
+                index = RecordPerfect(hi - lo);
+            PublishProgress();
+        }
+
+        if (index >= 0)
+        {
+            std::lock_guard<std::mutex> guard(ConsoleLock);
+
+            AnnouncePerfect(hi - lo, index);
+        }
+    }
+
+    bool Poll(void)
+    {
+        return false;           // the control thread sets StopSweep instead
+    }
+};
+
+
+/*
+    Feeds the workers' reports into the console state, as ConsoleListener
+    does for a sweep of our own.  Bands finish in any order: the position
+    moves over each one only once every band before it is done.
+*/
+class CoordinatorListener : public LeaseListener
+{
+public:
+    void Settled(unsigned hi, unsigned lo, const ULONGLONG counts[cVerdictCount], const std::vector<unsigned>& perfects)
+    {
+        std::vector<int>    found(perfects.size(), -1);
+
+        {
+            std::lock_guard<std::mutex> guard(StateLock);
+
+            for (int index = 0; index < cVerdictCount; index++)
+                VerdictCount[index] += counts[index];
+            for (size_t index = 0; index < perfects.size(); index++)
+            {
+                Results.Record(hi, perfects[index], pair_value<PerfectValue>(hi, perfects[index]), cVerdictPerfect);
+                found[index] = RecordPerfect(hi - perfects[index]);
+            }
+
+            if (lo != 0)
+                BandSettled[hi] = lo;
+            AdvancePosition();
+            if (hiPower != 0)
+                curValue = pair_value<PerfectValue>(hiPower, loPower);
+            PublishProgress();
+        }
+
+        std::lock_guard<std::mutex> guard(ConsoleLock);
+
+        for (size_t index = 0; index < perfects.size(); index++)
+            if (found[index] >= 0)
+                AnnouncePerfect(hi - perfects[index], found[index]);
+    }
+
+    void Expired(unsigned hi, const std::string& worker)
+    {
+        if (Quiet)
+            return;
+
+        std::lock_guard<std::mutex> guard(ConsoleLock);
+
+        printf("Band %u: no word from %s; it goes to the next worker.\n", hi, worker.c_str());
+        fflush(stdout);
+    }
+};
+
+
+/*
+    Prints a range scan as it goes: each perfect and amicable pair as it
+    is found, and the counts every cRangeReportSeconds, and stores each
+    segment in the /O file if there is one.  Only the scanning thread calls
+    it, so it needs no lock.
+*/
+class RangeConsole : public RangeListener
+{
+public:
+    RangeCounts     counts;                     // so far
+    uint64_t        next;                       // the first n not yet reported
+    double          lastReport;
+    RangeFile*      file;                       // the /O file; may be null
+    bool            failed;                     // a store to it failed
+    uint64_t        verified;                   // finds that passed --verify
+    uint64_t        unverified;                 // ...and that failed it
+
+    RangeConsole(uint64_t first, RangeFile* output)
+        : next(first), lastReport(wall_seconds()), file(output), failed(false), verified(0), unverified(0) {}
+
+    void Found(uint64_t value, uint64_t partner)
+    {
+        if (partner == 0)
+            std::cout << "Perfect number: " << value << ". ";
+        else
+            std::cout << "Amicable pair: " << value << " and " << partner << ". ";
+        PrintElapsedTime();
+        if (Verify && VerifyFound(value, partner))
+            verified++;
+        else if (Verify)
+        {
+            std::cout << "VERIFY FAILED: sigma() says otherwise of " << value << "." << std::endl;
+            unverified++;
+        }
+        if (Bell)
+            console_put('\a');
+    }
+
+    void Segment(uint64_t first, size_t count, const uint64_t* sigmas, const RangeCounts& segment)
+    {
+        if (file != nullptr && !failed && !file->Store(first, count, sigmas))
+        {
+            std::cout << "ERROR: Cannot store " << first << " on in the results file." << std::endl;
+            failed = true;
+            return;
+        }
+
+        counts.perfect += segment.perfect;
+        counts.abundant += segment.abundant;
+        counts.deficient += segment.deficient;
+        counts.amicable += segment.amicable;
+        next = first + count;
+
+        if (!Quiet && wall_seconds() - lastReport >= cRangeReportSeconds)
+        {
+            lastReport = wall_seconds();
+            Print();
+        }
+    }
+
+    bool Poll(void)
+    {
+        return failed;          // the signals set StopSweep
+    }
+
+    void Print(void)
+    {
+        std::cout << "Up to " << next - 1 << ": " << counts.perfect << " perfect, " << counts.abundant << " abundant, "
+            << counts.deficient << " deficient, " << counts.amicable << " amicable pairs. ";
+        PrintElapsedTime();
+    }
+};
+
+
+/*
+    The control thread: saves the context on the interval and runs the
+    menu, off the sweep's threads, so the workers never make a console
+    call and keep going while the menu is up.
+*/
+void ControlLoop(void)
+{
+    while (!SweepOver.load(std::memory_order_acquire))
+    {
+        // save the context on the interval; Tested() holds StateLock while
+        // it moves the position, so the copy is always of a settled one,
+        // and the file is written with neither lock held
+        if (CheckpointSeconds && wall_seconds() - lastSaveTime >= (double)CheckpointSeconds)
+        {
+            std::vector<unsigned char> image;
+
+            {
+                std::lock_guard<std::mutex> guard(ConsoleLock);
+
+                PrintProgressTime();
+                image = ContextImage();
+            }
+            WriteContext(image);
+        }
+
+        // check for the console and break events
+        if (!console_key_ready())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(cControlMillis));
+            continue;
+        }
+
+        int     key = console_read_key();
+        std::lock_guard<std::mutex> guard(ConsoleLock);
+
+        if (ProcessInput(key))
+            StopSweep.store(true, std::memory_order_relaxed);
+    }
+}
+
+
+/*
+    SIGINT, SIGTERM and the console events: save the context and stop, as
+    X does.  Only lock-free atomics are touched, which is safe in a signal
+    handler; main() does the saving once the sweep is down.
+*/
+void OnStop(void)
+{
+    SaveOnStop.store(true, std::memory_order_relaxed);
+    StopSweep.store(true, std::memory_order_relaxed);
+}
 
 
-int main(void)
+int main(int argc, char* argv[])
 {
+    SweepOptions&       options = Options;
+    ConsoleListener     listener;
+    LeaseOptions        leases;
+    ResultOptions       results;
+    RangeOptions        range;
+    std::string         workerHost, resultFile;
+    bool                coordinator = false;
+    bool                rangeScan = false;
+    bool                pinned = false;
+    bool                bounded = false;
+    unsigned            metricsPort = 0;        // /H; 0 serves none
+    std::vector<unsigned> nodes;
+
+    // /V (or -V) selects trial-division verify mode, /S its SIMD kernel,
+    // /R its reciprocal kernel, /F the sigma engine, /T[:n] the parallel
+    // sweep
+    for (int arg = 1; arg < argc; arg++)
+    {
+        char    option = (argv[arg][0] == '/' || argv[arg][0] == '-') ? (char)toupper(argv[arg][1]) : 0;
+
+        if (strcmp(argv[arg], "--quiet") == 0)
+            Quiet = true;
+        else if (strcmp(argv[arg], "--no-bell") == 0)
+            Bell = false;
+        else if (strcmp(argv[arg], "--verify") == 0)
+            Verify = true;
+        else if (option == 'V' && argv[arg][2] == '\0')
+            options.engine = cEngineTrialDivision;
+        else if (option == 'S' && argv[arg][2] == '\0')
+            options.engine = cEngineSimd;
+        else if (option == 'R' && argv[arg][2] == '\0')
+            options.engine = cEngineReciprocal;
+        else if (option == 'F' && argv[arg][2] == '\0')
+            options.engine = cEngineSigma;
+        else if (option == 'G' && argv[arg][2] == '\0')
+            options.engine = cEngineGpu;
+        else if (option == 'B' && argv[arg][2] == '\0')
+            options.engine = cEngineRow;
+        else if (option == 'M' && argv[arg][2] == ':' && atoi(&argv[arg][3]) > 0)
+            options.lastExponent = (unsigned)atoi(&argv[arg][3]);
+        else if (option == 'O' && argv[arg][2] == ':' && argv[arg][3] != '\0')
+            resultFile = &argv[arg][3];
+        else if (option == 'A' && argv[arg][2] == '\0')
+            results.allVerdicts = true;
+        else if (option == 'Y' && argv[arg][2] == '\0')
+            results.syncSeconds = 0;
+        else if (option == 'Y' && argv[arg][2] == ':' && atoi(&argv[arg][3]) > 0)
+            results.syncSeconds = atoi(&argv[arg][3]);
+        else if (option == 'T' && argv[arg][2] == '\0')
+            options.numThreads = WorkStealingPool::DefaultThreads();
+        else if (option == 'T' && argv[arg][2] == ':' && atoi(&argv[arg][3]) > 0)
+            options.numThreads = (unsigned)atoi(&argv[arg][3]);
+        else if (option == 'C' && argv[arg][2] == ':' && isdigit(argv[arg][3]))
+            CheckpointSeconds = (ULONG)atoi(&argv[arg][3]);
+        else if (option == 'N' && argv[arg][2] == '\0')
+            coordinator = true;
+        else if (option == 'N' && argv[arg][2] == ':' && atoi(&argv[arg][3]) > 0)
+        {
+            coordinator = true;
+            leases.port = (unsigned)atoi(&argv[arg][3]);
+        }
+        else if (option == 'L' && argv[arg][2] == ':' && (ULONG)atoi(&argv[arg][3]) > cBeatSeconds)
+            leases.leaseSeconds = (ULONG)atoi(&argv[arg][3]);
+        else if (option == 'W' && argv[arg][2] == ':' && argv[arg][3] != '\0' && argv[arg][3] != ':')
+        {
+            const char* port = strchr(&argv[arg][3], ':');
+
+            workerHost.assign(&argv[arg][3], port ? (size_t)(port - &argv[arg][3]) : strlen(&argv[arg][3]));
+            leases.port = port ? (unsigned)atoi(port + 1) : cDefaultPort;
+        }
+        else if (option == 'I' && argv[arg][2] == ':' && ParseRange(&argv[arg][3], range))
+            rangeScan = true;
+        else if (option == 'X' && argv[arg][2] == ':' && ParseBands(&argv[arg][3], firstBand, lastBand))
+            bounded = true;
+        else if (option == 'K' && argv[arg][2] == ':' && argv[arg][3] != '\0')
+            ContextFile = &argv[arg][3];
+        else if (option == 'H' && argv[arg][2] == '\0')
+            metricsPort = cDefaultMetricsPort;
+        else if (option == 'H' && argv[arg][2] == ':' && atoi(&argv[arg][3]) > 0)
+            metricsPort = (unsigned)atoi(&argv[arg][3]);
+        else if (option == 'E' && argv[arg][2] == '\0')
+            options.prefilter = true;
+        else if (option == 'Q' && argv[arg][2] == '\0')
+            options.pipeline = &Pipeline;
+        else if (option == 'Q' && argv[arg][2] == ':' && atoi(&argv[arg][3]) > 0)
+        {
+            options.pipeline = &Pipeline;
+            Pipeline.filterThreads = (unsigned)atoi(&argv[arg][3]);
+        }
+        else if (option == 'P' && argv[arg][2] == '\0')
+            pinned = true;
+        else if (option == 'P' && argv[arg][2] == ':' && ParseNodes(&argv[arg][3], nodes))
+            pinned = true;
+        else
+        {
+            std::cout << "Usage: PerfectNumbers [/V | /S | /R | /F | /G | /B | /M:p] [/X:a-b] [/T[:n] [/P[:a,b...] | /Q[:f]]] [/E]"
+                " [/C:n] [/K:file] [/O:file [/A] [/Y[:s]]] [/N[:port] [/L:n] | /W:host[:port]]"
+                " [/H[:port]] [--quiet | --no-bell] [--verify]" << std::endl;
+            std::cout << "       PerfectNumbers /I:a-b [/T[:n] [/P[:a,b...]]] [/O:file [/A]] [--quiet | --no-bell] [--verify]"
+                << std::endl;
+            return cExitFailed;
+        }
+    }
+
+    // past the bands there are only Euclid pairs, and no leases
+    if (options.lastExponent != 0 && (options.engine != cEngineLucasLehmer || coordinator || !workerHost.empty() || bounded))
+    {
+        std::cout << "/M runs the Lucas-Lehmer engine, and not with /N, /W or /X." << std::endl;
+        return cExitFailed;
+    }
+
+    // the coordinator records what its workers find
+    if (!resultFile.empty() && !workerHost.empty())
+    {
+        std::cout << "/O is for the coordinator, not for /W." << std::endl;
+        return cExitFailed;
+    }
+
+    // a worker sweeps the coordinator's bands, and keeps no context
+    if (!workerHost.empty() && (bounded || ContextFile != cContextFile))
+    {
+        std::cout << "/X and /K are for the coordinator, not for /W." << std::endl;
+        return cExitFailed;
+    }
+
+    // the stages test one candidate at a time, on threads of their own
+    if (options.pipeline != nullptr && (options.engine == cEngineGpu || options.engine == cEngineRow || coordinator || pinned))
+    {
+        std::cout << "/Q stages the candidates one by one: not with /G or /B, which take rows, /N or /P." << std::endl;
+        return cExitFailed;
+    }
+    Pipeline.testThreads = options.numThreads;
+
+    // the engines that take rows never see a pair alone
+    if (options.prefilter && (options.engine == cEngineGpu || options.engine == cEngineRow || coordinator))
+    {
+        std::cout << "/E prefilters the engines that take one pair at a time: not /G or /B, nor /N." << std::endl;
+        return cExitFailed;
+    }
+    Pipeline.stats = &PipelineCounts;
+
+    // the workers go where /P says, a block of them to each node
+    if (pinned && (options.numThreads == 0 || coordinator))
+    {
+        std::cout << "/P pins the /T threads; the coordinator has none." << std::endl;
+        return cExitFailed;
+    }
+    if (pinned)
+    {
+        std::string     error;
+
+        Places = place_threads(options.numThreads, nodes, error);
+        if (Places.empty())
+        {
+            std::cout << "ERROR: Cannot pin the threads: " << error << "." << std::endl;
+            return cExitFailed;
+        }
+        options.places = &Places;
+        range.places = &Places;
+    }
+
+    // a range scan is not a sweep: none of its engines or leases
+    if (rangeScan && (options.engine != cEngineLucasLehmer || options.lastExponent != 0 || results.syncSeconds != -1
+                      || options.pipeline != nullptr || options.prefilter
+                      || coordinator || !workerHost.empty() || bounded || ContextFile != cContextFile || metricsPort != 0))
+    {
+        std::cout << "/I takes only /T, /P, /O, /A and the -- switches." << std::endl;
+        return cExitFailed;
+    }
+    if (rangeScan)
+    {
+        range.numThreads = options.numThreads;
+        return RunRangeScan(range, resultFile, results.allVerdicts);
+    }
+
+    // a worker keeps no context: the coordinator has it all
+    if (!workerHost.empty())
+    {
+        bool    done;
+
+        if (!Quiet)
+        {
+            std::cout << "PerfectNumbers -- perfect number generator, v" << cVERSION << std::endl;
+            std::cout << "Worker for " << workerHost << ":" << leases.port;
+            if (options.numThreads)
+                std::cout << ", " << options.numThreads << " threads" << PlacesText();
+            std::cout << "." << std::endl << std::endl;
+        }
+
+        startTime = wall_seconds();
+        LiveStartTime.store(startTime, std::memory_order_relaxed);
+        if (metricsPort != 0 && !Metrics.Start(metricsPort, MetricsText))
+        {
+            std::cout << "ERROR: Cannot serve the metrics on port " << metricsPort << "." << std::endl;
+            return cExitFailed;
+        }
+
+        install_stop_handlers(OnStop, &ContextSettled);
+        options.stop = &StopSweep;
+        options.stats = &Stats;
+        options.cache = &OddCache;
+        done = WorkLeases(workerHost.c_str(), leases.port, options, Quiet);
+        Metrics.Stop();
+        ContextSettled = true;
+        std::cout << (done ? "Done." : "Stopped.") << std::endl;
+        return done ? cExitDone : cExitStopped;
+    }
+
     // now some processing for the actual algorithm
     PerfectArray[0] = 0;
     numPerfects = 0;
     curValue = 4;
-    maxDivisor = 2;
 
-    // Print startup message.
-    std::cout << "PerfectNumbers -- perfect number generator, v" << cVERSION << std::endl << std::endl;
+    // Print startup message, unless --quiet
+    if (!Quiet)
+    {
+        std::cout << "PerfectNumbers -- perfect number generator, v" << cVERSION << std::endl;
+        if (options.engine == cEngineLucasLehmer && options.lastExponent > cMaxPower / 2)
+            std::cout << "Lucas-Lehmer engine, Mersenne exponents up to " << options.lastExponent;
+        else if (options.engine == cEngineLucasLehmer)
+            std::cout << "Lucas-Lehmer engine";
+        else if (options.engine == cEngineSimd)
+            std::cout << "Trial-division engine, " << simd_level_name(simd_level()) << " kernel";
+        else if (options.engine == cEngineReciprocal)
+            std::cout << "Trial-division engine, reciprocal kernel";
+        else if (options.engine == cEngineSigma)
+            std::cout << "Sigma (prime factorization) engine";
+        else if (options.engine == cEngineGpu && gpu_available())
+            std::cout << "GPU trial-division engine on " << gpu_device_name();
+        else if (options.engine == cEngineGpu)
+            std::cout << "GPU trial-division engine, no device: " << simd_level_name(simd_level()) << " kernel on the CPU";
+        else if (options.engine == cEngineRow)
+            std::cout << "Row engine (odd cofactors only)";
+        else
+            std::cout << "Trial-division (verify) engine";
+        if (coordinator)
+            std::cout << ", coordinating workers on port " << leases.port;
+        else if (options.pipeline != nullptr)
+            std::cout << ", staged: " << Pipeline.filterThreads << " filter and "
+                << (options.numThreads ? options.numThreads : WorkStealingPool::DefaultThreads()) << " test threads";
+        else if (options.numThreads && options.engine != cEngineGpu)
+            std::cout << ", " << options.numThreads << " threads" << PlacesText();
+        if (options.prefilter)
+            std::cout << ", Miller-Rabin prefilter";
+        if (bounded)
+            std::cout << ", hiPower " << firstBand << " to " << lastBand;
+        std::cout << "." << std::endl << std::endl;
+    }
+
+    // Read context file if available, and resume right after the last
+    // candidate it had settled; a context of other bands is another run's
+    NameFiles(ContextFile);
+    if (!ReadContext())
+        return cExitFailed;
+    if (contextFirst != 0 && (contextFirst != firstBand || contextLast != lastBand))
+    {
+        std::cout << "ERROR: Context file '" << ContextFile << "' is of hiPower " << contextFirst << " to " << contextLast
+            << "; give this run its own with /K:file." << std::endl;
+        return cExitFailed;
+    }
+    if (options.engine == cEngineRow)
+        ReadCache();
+    if (hiPower == 0 && firstBand > 3)
+    {
+        hiPower = firstBand - 1;
+        loPower = 1;
+        curValue = pair_value<PerfectValue>(hiPower, loPower);
+    }
+    options.lastPower = lastBand;
+    if (hiPower != 0)
+    {
+        options.firstPower = (loPower > 1) ? hiPower : hiPower + 1;
+        options.firstLoPower = (loPower > 1) ? loPower - 1 : 0;
+    }
 
-    // Read context file if available
-    ReadContext();
+    // the results file picks up where the context does
+    results.format = ResultSink::FormatOf(resultFile.c_str());
+    if (!resultFile.empty() && !Results.Open(resultFile.c_str(), results))
+    {
+        std::cout << "ERROR: Cannot open results file '" << resultFile << "'." << std::endl;
+        return cExitFailed;
+    }
 
     // Print start-of-processing status
-    std::cout << "Currently at " << curValue << ", working on perfect #" << numPerfects + 1 << std::endl;
+    if (!Quiet)
+        std::cout << "Currently at " << PositionText() << ", working on perfect #" << numPerfects + 1 << std::endl;
 
     // Grab starting time here, before the REAL processing starts
-    ftime(&startTime);
-    PrintElapsedTime();
+    startTime = wall_seconds();
+    lastSaveTime = startTime;
+    LiveSaveTime.store(lastSaveTime, std::memory_order_relaxed);
+    LiveStartTime.store(startTime, std::memory_order_relaxed);
+    PublishProgress();
+    PrintProgressTime();
+
+    // the scrapes read only atomics, so they run beside the sweep
+    if (metricsPort != 0 && !Metrics.Start(metricsPort, MetricsText))
+    {
+        std::cout << "ERROR: Cannot serve the metrics on port " << metricsPort << "." << std::endl;
+        return cExitFailed;
+    }
+
+    // the control thread takes the keyboard, the signals stop the sweep
+    install_stop_handlers(OnStop, &ContextSettled);
+    options.stop = &StopSweep;
+    options.stats = &Stats;
+    options.cache = &OddCache;
+    console_open();
+    std::thread control(ControlLoop);
 
-    // Loop through values, looking for perfect numbers
-    if (LoopForPerfects())
+    // Loop through values, looking for perfect numbers, or have the
+    // workers do it; both start from the context
+    bool    finished;
+
+    if (coordinator)
+    {
+        CoordinatorListener     workers;
+
+        leases.engine = options.engine;
+        leases.stop = &StopSweep;
+        for (ULONG power = 3; power <= cMaxPower; power++)
+            leases.settled[power] = (power < NextBand() || power > lastBand) ? 1
+                                        : (power == hiPower) ? loPower : BandSettled[power];
+        finished = ServeLeases(leases, workers);
+    }
+    else
+        finished = LoopForPerfects(options, listener);
+
+    SweepOver.store(true, std::memory_order_release);
+    control.join();
+    console_close();
+    Metrics.Stop();
+    if (Results.IsOpen())
+    {
+        Results.Close();
+        if (Results.Dropped() != 0)
+            std::cout << Results.Dropped() << " results were dropped: the results file fell behind." << std::endl;
+    }
+
+    if (finished)
     {
         PrintElapsedTime();
         std::cout << "Done." << std::endl;
         SaveContext();
+        DumpStats();
     }
     else
+    {
+        if (SaveOnStop)
+        {
+            PrintElapsedTime();
+            SaveContext();
+            DumpStats();
+        }
         std::cout << "Cancelled." << std::endl;
+    }
+    ContextSettled = true;
 
-    return true;
+    if (Verify)
+        std::cout << Verified << " perfects verified, " << Unverified << " failed." << std::endl;
+
+    return (Verify && Unverified != 0) ? cExitUnverified : finished ? cExitDone : cExitStopped;
+}
+
+
+/*
+    /I:a-b, in decimal: 1 <= a <= b < cMaxRangeValue.
+*/
+bool ParseRange(const char* text, RangeOptions& range)
+{
+    char*       end;
+
+    if (!isdigit(text[0]))
+        return false;
+    range.first = strtoull(text, &end, 10);
+    if (*end != '-' || !isdigit(end[1]))
+        return false;
+    range.last = strtoull(end + 1, &end, 10);
+
+    return *end == '\0' && range.first >= 1 && range.first <= range.last && range.last < cMaxRangeValue;
 }
 
 
 /*
-    Loop through values, looking for perfect numbers.
+    /P:a,b...: NUMA node numbers, in decimal, in the order the blocks of
+    workers go to them.
 */
-bool LoopForPerfects(void)
+bool ParseNodes(const char* text, std::vector<unsigned>& nodes)
 {
-    for (hiPower = 3; hiPower < 32; hiPower++)
+    char*       end;
+
+    nodes.clear();
+    for (;;)
     {
-        ULONG   hiNum = (1L << hiPower);
+        if (!isdigit(text[0]))
+            return false;
+        nodes.push_back((unsigned)strtoul(text, &end, 10));
+        if (*end == '\0')
+            return true;
+        if (*end != ',')
+            return false;
+        text = end + 1;
+    }
+}
 
-        for (loPower = hiPower - 1; loPower > 0; loPower--)
-        {
-            curValue = hiNum - (1L << loPower);
 
-            // check for the console and break events
-            if (_kbhit() && ProcessInput())
-                return false;
+/*
+    /X:a-b, in decimal: 3 <= a <= b <= cMaxPower.
+*/
+bool ParseBands(const char* text, ULONG& first, ULONG& last)
+{
+    char*       end;
+
+    if (!isdigit(text[0]))
+        return false;
+    first = (ULONG)strtoul(text, &end, 10);
+    if (*end != '-' || !isdigit(end[1]))
+        return false;
+    last = (ULONG)strtoul(end + 1, &end, 10);
 
-            // else continue processing
-            // calculate the highest test number to use
-            maxDivisor = (USHORT)sqrt(curValue);
+    return *end == '\0' && first >= 3 && first <= last && last <= cMaxPower;
+}
 
-            // test for perfection and report if true
-            if (Perfect())
-            {
-                PerfectArray[numPerfects] = curValue;
-                std::cout << "Perfect number #" << numPerfects + 1 << " is " << PerfectArray[numPerfects] << ". ";
-                PrintElapsedTime();
-                numPerfects++;
-                _putch('\a');            // sounds the bell!
-            }
-        }
+
+/*
+    The cache and stats files are named after the context, less its
+    extension: PerfectNumbers.dat gives PerfectNumbers.cache.
+*/
+void NameFiles(const std::string& contextFile)
+{
+    size_t      dot = contextFile.find_last_of('.');
+    size_t      slash = contextFile.find_last_of("/\\");
+    std::string stem = (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+                        ? contextFile.substr(0, dot) : contextFile;
+
+    ContextFile = contextFile;
+    CacheFile = stem + cCacheSuffix;
+    StatsFile = stem + cStatsSuffix;
+}
+
+
+/*
+    ", pinned on nodes 0 and 1" and the like, for the startup line; empty
+    when nothing is pinned.
+*/
+std::string PlacesText(void)
+{
+    std::vector<unsigned>   used;
+    std::vector<CpuNode>    machine = cpu_nodes();
+    std::string             text;
+
+    for (size_t index = 0; index < Places.size(); index++)
+    {
+        unsigned    cpu = (unsigned)Places[index].cpu;
+
+        // the places say a processor; the machine says whose it is
+        for (size_t node = 0; node < machine.size(); node++)
+            if (std::find(machine[node].cpus.begin(), machine[node].cpus.end(), cpu) != machine[node].cpus.end()
+                && std::find(used.begin(), used.end(), machine[node].id) == used.end())
+                used.push_back(machine[node].id);
     }
+    if (used.empty())
+        return text;
 
-    return true;
+    text = (used.size() == 1) ? ", pinned on node " : ", pinned on nodes ";
+    for (size_t index = 0; index < used.size(); index++)
+        text += (index == 0 ? "" : index + 1 == used.size() ? " and " : ", ") + std::to_string(used[index]);
+
+    return text;
 }
 
 
 /*
-    Test curValue for perfection.
+    The /I scan.  Like a worker it keeps no context; a stop says where
+    it got to, and /I from there picks it up.  The /O file knows that
+    itself, so a scan into one starts from where the file is written to.
 */
-bool Perfect(void)
+int RunRangeScan(RangeOptions& range, const std::string& fileName, bool sums)
 {
-    ULONG   index, sum, factor;
+    RangeFile       output;
+    bool            done;
 
-    // main division loop
-    for (sum = 1, index = 2; index <= maxDivisor; index++)
+    if (!Quiet)
+        std::cout << "PerfectNumbers -- perfect number generator, v" << cVERSION << std::endl;
+    if (!fileName.empty() && !output.Create(fileName.c_str(), range.first, range.last, sums))
     {
-        // test to see if divisor is worth trying
-        if (curValue % index == 0)
-        {
-            // add factor
-            sum += index;
+        std::cout << "ERROR: Cannot open results file '" << fileName << "', or it holds another scan." << std::endl;
+        return cExitFailed;
+    }
+    if (output.Written() > range.last - range.first)
+    {
+        std::cout << "'" << fileName << "' holds the whole scan already." << std::endl;
+        return cExitDone;
+    }
+    // a is left alone: a pair whose smaller number was stored already
+    // was reported then, and must not be again at the larger
+    range.resume = range.first + output.Written();
+
+    RangeConsole    listener(range.resume, output.IsOpen() ? &output : nullptr);
+
+    if (!Quiet)
+    {
+        std::cout << "Range scan of " << range.resume << " to " << range.last;
+        if (range.numThreads)
+            std::cout << ", " << range.numThreads << " threads" << PlacesText();
+        if (output.IsOpen())
+            std::cout << ", into " << fileName << (sums ? " with s(n)" : "");
+        std::cout << "." << std::endl << std::endl;
+    }
+
+    startTime = wall_seconds();
+    install_stop_handlers(OnStop, &ContextSettled);
+    range.stop = &StopSweep;
+    done = ScanRange(range, listener);
+    ContextSettled = true;
+
+    listener.Print();
+    if (elapsedTime > 0)
+        printf("%.0f numbers a second.\n", (double)(listener.next - range.resume) / elapsedTime);
+    output.Close();
+    if (done)
+        std::cout << "Done." << std::endl;
+    else if (!fileName.empty())
+        std::cout << "Stopped; the same command carries on." << std::endl;
+    else
+        std::cout << "Stopped; /I:" << listener.next << "-" << range.last << " carries on." << std::endl;
 
-            // get cofactor and add if the two are not the same
-            if ((factor = curValue / index) != index)
-                sum += factor;
+    if (Verify)
+        std::cout << listener.verified << " finds verified, " << listener.unverified << " failed." << std::endl;
+
+    return (Verify && listener.unverified != 0) ? cExitUnverified : done ? cExitDone : cExitStopped;
+}
+
+
+/*
+    Record the perfect of this exponent, with StateLock held: its place in
+    the list, or -1 if it was there already or the list is full.
+*/
+int RecordPerfect(ULONG exponent)
+{
+    int     index;
+
+    if (numPerfects >= cMaxPerfects)
+        return -1;
+
+    // the workers of a distributed run find them in any order
+    for (index = numPerfects; index > 0 && PerfectArray[index - 1] >= exponent; index--)
+        if (PerfectArray[index - 1] == exponent)
+            return -1;
+    memmove(&PerfectArray[index + 1], &PerfectArray[index], (numPerfects - index) * sizeof(ULONG));
+
+    PerfectArray[index] = exponent;
+    numPerfects++;
+    return index;
+}
+
+
+/*
+    Announce the perfect RecordPerfect() put at index, with ConsoleLock
+    held, and --verify it.
+*/
+void AnnouncePerfect(ULONG exponent, int index)
+{
+    std::cout << "Perfect number #" << index + 1 << " is " << PerfectText(exponent) << ". ";
+    PrintElapsedTime();
+    if (Verify)
+    {
+        if (VerifyPerfect(exponent))
+            Verified++;
+        else
+        {
+            Unverified++;
+            std::cout << "VERIFY FAILED: 2^(p-1) * (2^p - 1) with p = " << exponent << " fails its second test." << std::endl;
         }
     }
+    if (Bell)
+        console_put('\a');      // sounds the bell!
+}
+
+
+/*
+    --verify: a second opinion on the perfect of exponent p, by a test
+    that shares no code with the engine that found it: sigma() from the
+    factorization while the perfect fits 64 bits (unless /F found it),
+    the Fermat test of 2^p - 1 past that.
+*/
+bool VerifyPerfect(ULONG exponent)
+{
+    if (exponent <= 32 && Options.engine != cEngineSigma)
+        return is_perfect_sigma<uint64_t>((((uint64_t)1 << exponent) - 1) << (exponent - 1));
+
+    return fermat_prp3(exponent);
+}
+
+
+/*
+    --verify for a range scan, whose sieve never factors: sigma() from
+    the factorization, of the perfect or of both halves of the pair.
+*/
+bool VerifyFound(uint64_t value, uint64_t partner)
+{
+    if (partner == 0)
+        return is_perfect_sigma<uint64_t>(value);
 
-    return (sum == curValue);
+    return sigma<uint64_t>(value) == value + partner && sigma<uint64_t>(partner) == value + partner;
+}
+
+
+/*
+    The exponent p of a Euclid perfect 2^(p-1) * (2^p - 1), from a
+    context file that kept the value: it has 2p - 1 bits.
+*/
+ULONG PerfectExponent(PerfectValue value)
+{
+    ULONG       bits = 0;
+
+    for (; value != 0; value >>= 1)
+        bits++;
+
+    return (bits + 1) / 2;
+}
+
+
+/*
+    A perfect in decimal, or by its exponent once that runs too long.
+*/
+std::string PerfectText(ULONG exponent)
+{
+    std::string     digits = format_perfect(exponent);
+    char            text[80];
+
+    if (digits.size() <= cMaxDigitsShown)
+        return digits;
+
+    snprintf(text, sizeof(text), "2^%lu * (2^%lu - 1), %lu digits",
+        (unsigned long)exponent - 1, (unsigned long)exponent, (unsigned long)digits.size());
+    return text;
+}
+
+
+/*
+    The last candidate settled, as a number while it fits one.
+*/
+std::string PositionText(void)
+{
+    char    text[48];
+
+    if (hiPower <= cMaxPower)
+        return format_value(curValue);
+
+    snprintf(text, sizeof(text), "2^%lu - 2^%lu", (unsigned long)hiPower, (unsigned long)loPower);
+    return text;
+}
+
+
+/*
+    The band after the position: the one it is in, or the next if that is
+    done.
+*/
+ULONG NextBand(void)
+{
+    if (hiPower == 0)
+        return 3;
+
+    return (loPower > 1) ? hiPower : hiPower + 1;
+}
+
+
+/*
+    Move the position over what the workers have settled right after it.
+*/
+void AdvancePosition(void)
+{
+    ULONG       band;
+
+    while ((band = NextBand()) <= cMaxPower && BandSettled[band] != 0)
+    {
+        hiPower = band;
+        loPower = BandSettled[band];
+        BandSettled[band] = 0;
+    }
 }
 
 
@@ -219,10 +1403,7 @@ bool Perfect(void)
 */
 void PrintElapsedTime(void)
 {
-    ftime(&finalTime);
-    elapsedTime += (double)(finalTime.time - startTime.time) +
-        (double)(finalTime.millitm - startTime.millitm) * 0.001;
-    startTime = finalTime;
+    TickElapsedTime();
 
     USHORT      hours = (USHORT)(elapsedTime / 3600);
     USHORT      minutes = ((ULONG)elapsedTime % 3600) / 60;
@@ -241,6 +1422,289 @@ void PrintElapsedTime(void)
 }
 
 
+void TickElapsedTime(void)
+{
+    finalTime = wall_seconds();
+    elapsedTime += finalTime - startTime;
+    startTime = finalTime;
+}
+
+
+/*
+    The time on a line of its own, as progress; --quiet only keeps the
+    count.
+*/
+void PrintProgressTime(void)
+{
+    if (Quiet)
+        TickElapsedTime();
+    else
+        PrintElapsedTime();
+}
+
+
+/*
+    The band and worker counters, as a table.
+*/
+void PrintStats(void)
+{
+    double      busy = 0;
+
+    printf("\n  hi      tested        divisors   early   seconds    cand/s\n");
+    for (unsigned power = 0; power <= cMaxPower; power++)
+    {
+        const SweepCounters&    band = Stats.bands[power];
+        ULONGLONG   tested = band.tested.load(std::memory_order_relaxed);
+        double      seconds = band.nanoseconds.load(std::memory_order_relaxed) * 1e-9;
+
+        if (tested == 0)
+            continue;
+        printf("%4u %11llu %15llu %7llu %9.3f %9.0f\n", power, tested,
+            (ULONGLONG)band.divisors.load(std::memory_order_relaxed),
+            (ULONGLONG)band.earlyExits.load(std::memory_order_relaxed),
+            seconds, seconds > 0 ? tested / seconds : 0.0);
+    }
+
+    for (unsigned worker = 0; worker < cMaxStatsThreads; worker++)
+    {
+        const SweepCounters&    counters = Stats.workers[worker];
+        double      seconds = counters.nanoseconds.load(std::memory_order_relaxed) * 1e-9;
+
+        if (seconds == 0)
+            continue;
+        busy += seconds;
+        printf("Worker %u: %llu tested, %.3f seconds busy, %.0f candidates per second.\n", worker,
+            (ULONGLONG)counters.tested.load(std::memory_order_relaxed), seconds,
+            counters.tested.load(std::memory_order_relaxed) / seconds);
+    }
+    printf("All workers: %.3f seconds busy.\n", busy);
+    if (OddCache.Lookups() != 0)
+        printf("Sigma cache: %llu lookups, %llu hits (%.1f%%).\n", (ULONGLONG)OddCache.Lookups(),
+            (ULONGLONG)OddCache.Hits(), 100.0 * OddCache.Hits() / OddCache.Lookups());
+    if (Options.prefilter)
+        printf("Prefilter: %llu not of the Euclid form, %llu failed Miller-Rabin, %llu passed to the engine.\n",
+            (ULONGLONG)Stats.prefilter[cPrefilterForm].load(std::memory_order_relaxed),
+            (ULONGLONG)Stats.prefilter[cPrefilterPrime].load(std::memory_order_relaxed),
+            (ULONGLONG)Stats.prefilter[cPrefilterPassed].load(std::memory_order_relaxed));
+    for (int stage = 0; Options.pipeline != nullptr && stage < cStageCount; stage++)
+    {
+        const StageCounters&    counters = PipelineCounts.stages[stage];
+
+        printf("Stage %s: %llu taken, %llu settled; queue %llu deep, at most %llu, full %llu times.\n",
+            stage_name((PipelineStage)stage),
+            (ULONGLONG)counters.items.load(std::memory_order_relaxed),
+            (ULONGLONG)counters.settled.load(std::memory_order_relaxed),
+            (ULONGLONG)counters.depth.load(std::memory_order_relaxed),
+            (ULONGLONG)counters.peak.load(std::memory_order_relaxed),
+            (ULONGLONG)counters.stalls.load(std::memory_order_relaxed));
+    }
+}
+
+
+/*
+    The counters as JSON, for scripts that track the sweep from run to
+    run.  Only the bands a worker has touched are listed.
+*/
+bool DumpStats(void)
+{
+    FILE*       fd;
+    bool        first = true;
+    double      elapsed = elapsedTime + (wall_seconds() - startTime);
+
+    if ((fd = open_file(StatsFile.c_str(), "w")) == nullptr)
+    {
+        printf("\nCannot open statistics file '%s'.\n", StatsFile.c_str());
+        return false;
+    }
+
+    fprintf(fd, "{\n  \"version\": \"%s\",\n  \"engine\": \"%s\",\n  \"threads\": %u,\n",
+        cVERSION, engine_name(Options.engine), Options.numThreads);
+    fprintf(fd, "  \"elapsed_seconds\": %.6f,\n  \"perfects\": %u,\n  \"verdicts\": {", elapsed, numPerfects);
+    for (int index = 0; index < cVerdictCount; index++)
+        fprintf(fd, "%s\"%s\": %llu", index ? ", " : " ", verdict_name((PerfectVerdict)index), VerdictCount[index]);
+    fprintf(fd, " },\n  \"sigma_cache\": { \"lookups\": %llu, \"hits\": %llu, \"hit_rate\": %.6f },\n",
+        (ULONGLONG)OddCache.Lookups(), (ULONGLONG)OddCache.Hits(),
+        OddCache.Lookups() ? (double)OddCache.Hits() / OddCache.Lookups() : 0.0);
+    fprintf(fd, "  \"bands\": [");
+    for (unsigned power = 0; power <= cMaxPower; power++)
+    {
+        const SweepCounters&    band = Stats.bands[power];
+
+        if (band.tested.load(std::memory_order_relaxed) == 0 && band.nanoseconds.load(std::memory_order_relaxed) == 0)
+            continue;
+        fprintf(fd, "%s\n    { \"hi\": %u, \"tested\": %llu, \"divisors\": %llu, \"early_exits\": %llu, \"seconds\": %.9f }",
+            first ? "" : ",", power,
+            (ULONGLONG)band.tested.load(std::memory_order_relaxed),
+            (ULONGLONG)band.divisors.load(std::memory_order_relaxed),
+            (ULONGLONG)band.earlyExits.load(std::memory_order_relaxed),
+            band.nanoseconds.load(std::memory_order_relaxed) * 1e-9);
+        first = false;
+    }
+    fprintf(fd, "\n  ],\n  \"workers\": [");
+    first = true;
+    for (unsigned worker = 0; worker < cMaxStatsThreads; worker++)
+    {
+        const SweepCounters&    counters = Stats.workers[worker];
+        double      seconds = counters.nanoseconds.load(std::memory_order_relaxed) * 1e-9;
+
+        if (seconds == 0)
+            continue;
+        fprintf(fd, "%s\n    { \"worker\": %u, \"tested\": %llu, \"divisors\": %llu, \"seconds\": %.9f, \"per_second\": %.3f }",
+            first ? "" : ",", worker,
+            (ULONGLONG)counters.tested.load(std::memory_order_relaxed),
+            (ULONGLONG)counters.divisors.load(std::memory_order_relaxed),
+            seconds, counters.tested.load(std::memory_order_relaxed) / seconds);
+        first = false;
+    }
+    fprintf(fd, "\n  ]");
+    if (Options.prefilter)
+        fprintf(fd, ",\n  \"prefilter\": { \"form\": %llu, \"miller_rabin\": %llu, \"passed\": %llu }",
+            (ULONGLONG)Stats.prefilter[cPrefilterForm].load(std::memory_order_relaxed),
+            (ULONGLONG)Stats.prefilter[cPrefilterPrime].load(std::memory_order_relaxed),
+            (ULONGLONG)Stats.prefilter[cPrefilterPassed].load(std::memory_order_relaxed));
+    if (Options.pipeline != nullptr)
+    {
+        fprintf(fd, ",\n  \"stages\": [");
+        for (int stage = 0; stage < cStageCount; stage++)
+        {
+            const StageCounters&    counters = PipelineCounts.stages[stage];
+
+            fprintf(fd, "%s\n    { \"stage\": \"%s\", \"items\": %llu, \"settled\": %llu, \"depth\": %llu, \"peak\": %llu,"
+                " \"stalls\": %llu }",
+                stage ? "," : "", stage_name((PipelineStage)stage),
+                (ULONGLONG)counters.items.load(std::memory_order_relaxed),
+                (ULONGLONG)counters.settled.load(std::memory_order_relaxed),
+                (ULONGLONG)counters.depth.load(std::memory_order_relaxed),
+                (ULONGLONG)counters.peak.load(std::memory_order_relaxed),
+                (ULONGLONG)counters.stalls.load(std::memory_order_relaxed));
+        }
+        fprintf(fd, "\n  ]");
+    }
+    fprintf(fd, "\n}\n");
+
+    return fclose(fd) == 0;
+}
+
+
+/*
+    Copies the position, the perfects and the verdict counts for the
+    scrapes; call with StateLock held.  A handful of relaxed stores, so
+    Tested() can afford it for every candidate.
+*/
+void PublishProgress(void)
+{
+    LiveHiPower.store(hiPower, std::memory_order_relaxed);
+    LiveLoPower.store(loPower, std::memory_order_relaxed);
+    LivePerfects.store(numPerfects, std::memory_order_relaxed);
+    for (int index = 0; index < cVerdictCount; index++)
+        LiveVerdicts[index].store(VerdictCount[index], std::memory_order_relaxed);
+}
+
+
+/*
+    The /metrics page, in the Prometheus text format.  Called on the
+    metrics thread, so it reads only atomics and what was set before the
+    server started: the rates are over this run, the counters since the
+    context began.  A /W worker has no position or context of its own, so
+    it leaves those out.
+*/
+std::string MetricsText(void)
+{
+    std::ostringstream  text;
+    double      now = wall_seconds(), seconds = now - LiveStartTime.load(std::memory_order_relaxed);
+    double      saved = LiveSaveTime.load(std::memory_order_relaxed);
+    ULONGLONG   tested = 0, divisors = 0, earlyExits = 0, nanoseconds = 0;
+    const char* engine = engine_name(Options.engine);
+
+    for (unsigned worker = 0; worker < cMaxStatsThreads; worker++)
+    {
+        tested += Stats.workers[worker].tested.load(std::memory_order_relaxed);
+        divisors += Stats.workers[worker].divisors.load(std::memory_order_relaxed);
+        earlyExits += Stats.workers[worker].earlyExits.load(std::memory_order_relaxed);
+        nanoseconds += Stats.workers[worker].nanoseconds.load(std::memory_order_relaxed);
+    }
+
+    text << std::setprecision(9);
+    text << "# HELP perfect_info The program and the engine it runs.\n# TYPE perfect_info gauge\n";
+    text << "perfect_info{version=\"" << cVERSION << "\",engine=\"" << engine << "\"} 1\n";
+    text << "# HELP perfect_uptime_seconds Seconds since this run started.\n# TYPE perfect_uptime_seconds gauge\n";
+    text << "perfect_uptime_seconds " << seconds << "\n";
+    if (saved != 0)
+    {
+        text << "# HELP perfect_hi_power hiPower of the last candidate settled.\n# TYPE perfect_hi_power gauge\n";
+        text << "perfect_hi_power " << LiveHiPower.load(std::memory_order_relaxed) << "\n";
+        text << "# HELP perfect_lo_power loPower of the last candidate settled.\n# TYPE perfect_lo_power gauge\n";
+        text << "perfect_lo_power " << LiveLoPower.load(std::memory_order_relaxed) << "\n";
+        text << "# HELP perfect_perfects_found Perfect numbers found.\n# TYPE perfect_perfects_found gauge\n";
+        text << "perfect_perfects_found " << LivePerfects.load(std::memory_order_relaxed) << "\n";
+        text << "# HELP perfect_verdicts_total Candidates settled, by verdict.\n# TYPE perfect_verdicts_total counter\n";
+        for (int index = 0; index < cVerdictCount; index++)
+            text << "perfect_verdicts_total{verdict=\"" << verdict_name((PerfectVerdict)index) << "\"} "
+                << LiveVerdicts[index].load(std::memory_order_relaxed) << "\n";
+        text << "# HELP perfect_checkpoint_age_seconds Seconds since the context was last saved.\n"
+            "# TYPE perfect_checkpoint_age_seconds gauge\n";
+        text << "perfect_checkpoint_age_seconds " << now - saved << "\n";
+    }
+    text << "# HELP perfect_candidates_total Candidates tested by the workers.\n# TYPE perfect_candidates_total counter\n";
+    text << "perfect_candidates_total{engine=\"" << engine << "\"} " << tested << "\n";
+    text << "# HELP perfect_divisions_total Trial divisors tried by the workers.\n# TYPE perfect_divisions_total counter\n";
+    text << "perfect_divisions_total{engine=\"" << engine << "\"} " << divisors << "\n";
+    text << "# HELP perfect_early_exits_total Candidates settled before their last divisor.\n"
+        "# TYPE perfect_early_exits_total counter\n";
+    text << "perfect_early_exits_total{engine=\"" << engine << "\"} " << earlyExits << "\n";
+    text << "# HELP perfect_busy_seconds_total Seconds the workers spent testing.\n# TYPE perfect_busy_seconds_total counter\n";
+    text << "perfect_busy_seconds_total{engine=\"" << engine << "\"} " << nanoseconds * 1e-9 << "\n";
+    text << "# HELP perfect_candidates_per_second Candidates tested a second, over this run.\n"
+        "# TYPE perfect_candidates_per_second gauge\n";
+    text << "perfect_candidates_per_second{engine=\"" << engine << "\"} " << (seconds > 0 ? tested / seconds : 0.0) << "\n";
+    text << "# HELP perfect_divisions_per_second Trial divisors tried a second, over this run.\n"
+        "# TYPE perfect_divisions_per_second gauge\n";
+    text << "perfect_divisions_per_second{engine=\"" << engine << "\"} " << (seconds > 0 ? divisors / seconds : 0.0) << "\n";
+    text << "# HELP perfect_sigma_cache_lookups_total Row engine odd parts looked up.\n"
+        "# TYPE perfect_sigma_cache_lookups_total counter\n";
+    text << "perfect_sigma_cache_lookups_total " << OddCache.Lookups() << "\n";
+    text << "# HELP perfect_sigma_cache_hits_total ...and found with a sum already started.\n"
+        "# TYPE perfect_sigma_cache_hits_total counter\n";
+    text << "perfect_sigma_cache_hits_total " << OddCache.Hits() << "\n";
+    text << "# HELP perfect_sigma_cache_hit_ratio Hits over lookups.\n# TYPE perfect_sigma_cache_hit_ratio gauge\n";
+    text << "perfect_sigma_cache_hit_ratio " << (OddCache.Lookups() ? (double)OddCache.Hits() / OddCache.Lookups() : 0.0) << "\n";
+    if (Options.prefilter)
+    {
+        static const char*  results[cPrefilterCount] = { "form", "miller_rabin", "passed" };
+
+        text << "# HELP perfect_prefilter_total Pairs the prefilter ruled out, by the step, or passed to the engine.\n"
+            "# TYPE perfect_prefilter_total counter\n";
+        for (int result = 0; result < cPrefilterCount; result++)
+            text << "perfect_prefilter_total{result=\"" << results[result] << "\"} "
+                << Stats.prefilter[result].load(std::memory_order_relaxed) << "\n";
+    }
+    if (Options.pipeline != nullptr)
+    {
+        static const char*  names[] = { "items_total", "settled_total", "queue_depth", "queue_peak", "stalls_total" };
+        static const char*  helps[] = { "Candidates taken off the stage's queue.", "...and settled by the stage.",
+                                "Candidates waiting in the stage's queue.", "The most ever waiting there.",
+                                "Pushes that found the stage's queue full." };
+
+        for (int metric = 0; metric < 5; metric++)
+        {
+            text << "# HELP perfect_stage_" << names[metric] << " " << helps[metric] << "\n# TYPE perfect_stage_"
+                << names[metric] << ((metric == 2 || metric == 3) ? " gauge\n" : " counter\n");
+            for (int stage = 0; stage < cStageCount; stage++)
+            {
+                const StageCounters&    counters = PipelineCounts.stages[stage];
+                const std::atomic<uint64_t>* values[] = { &counters.items, &counters.settled, &counters.depth,
+                                                    &counters.peak, &counters.stalls };
+
+                text << "perfect_stage_" << names[metric] << "{stage=\"" << stage_name((PipelineStage)stage) << "\"} "
+                    << values[metric]->load(std::memory_order_relaxed) << "\n";
+            }
+        }
+    }
+
+    return text.str();
+}
+
+
 void PrintMenu(void)
 {
     // Print menu of choices
@@ -249,39 +1713,65 @@ void PrintMenu(void)
     printf("    S - Display status and Summary\n");
     printf("    C - Save context and Continue\n");
     printf("    F - Print list of filters\n");
+    printf("    D - Dump statistics to %s\n", StatsFile.c_str());
     printf("    X - Save context and eXit\n");
     printf("    Q - Quit without saving context\n");
     printf("Enter your choice: ");
 }
 
 
-bool ProcessInput(void)
+bool ProcessInput(int key)
 {
-    /* process the signals received.
+    /* process the key received.
     */
     int         index;
     char        in_char;
+    std::vector<ULONG> perfects;                // copies of the state, so StateLock
+    ULONGLONG   counts[cVerdictCount];          // is not held across a print
+    std::string position;
+    int         found;
 
-    // get and filter user input
-    in_char = toupper(_getch());
+    // filter user input
+    in_char = (char)toupper(key);
 
-    _putch('\n');
+    console_put('\n');
 
     // process filtered input
     switch (in_char)
     {
     case 'S':    // print summary and fall through
-        for (index = 0; index < numPerfects; index++)
-            printf("\n#%d = %lu", index + 1, PerfectArray[index]);
+        {
+            std::lock_guard<std::mutex> guard(StateLock);
+
+            perfects.assign(PerfectArray, PerfectArray + numPerfects);
+            memcpy(counts, VerdictCount, sizeof(counts));
+        }
+        for (index = 0; index < (int)perfects.size(); index++)
+            printf("\n#%d = %s", index + 1, PerfectText(perfects[index]).c_str());
         printf("\n");
-        // fall through on purpose
+        for (index = 0; index < cVerdictCount; index++)
+            printf("%s%llu %s", index ? ", " : "Tested: ", counts[index], verdict_name((PerfectVerdict)index));
+        printf(".\n");
+        PrintStats();
+        // fall through - on purpose
 
     case 'T':   // print out time/computation status
-        printf("Currently at %lu, working on perfect #%d.\n",
-            curValue, numPerfects + 1);
+        {
+            std::lock_guard<std::mutex> guard(StateLock);
+
+            position = PositionText();
+            found = numPerfects;
+        }
+        printf("Currently at %s, working on perfect #%d.\n", position.c_str(), found + 1);
         PrintElapsedTime();
         break;
 
+    case 'D':    // dump the statistics for scripts
+        PrintStats();
+        if (DumpStats())
+            printf("Statistics written to %s.\n", StatsFile.c_str());
+        break;
+
     case 'C':    // save context and return
         PrintElapsedTime();
         SaveContext();
@@ -290,6 +1780,7 @@ bool ProcessInput(void)
     case 'X':    // save context and fall through
         PrintElapsedTime();
         SaveContext();
+        // fall through
 
     case 'Q':    // quit the program
         PrintElapsedTime();
@@ -302,107 +1793,418 @@ bool ProcessInput(void)
 }
 
 
+/*
+    CRC-32 (the zip/Ethernet polynomial, reflected), bit by bit: the
+    context file is small and written every few minutes at most.
+*/
+ULONG ContextChecksum(const unsigned char* data, size_t length)
+{
+    ULONG       crc = 0xFFFFFFFF;
+
+    for (size_t index = 0; index < length; index++)
+    {
+        crc ^= data[index];
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+
+    return ~crc;
+}
+
+
+// little-endian fields of the context file
+void PutField(std::vector<unsigned char>& buffer, ULONGLONG value, int bytes)
+{
+    for (int index = 0; index < bytes; index++, value >>= 8)
+        buffer.push_back((unsigned char)value);
+}
+
+
+ULONGLONG GetField(const unsigned char*& data, int bytes)
+{
+    ULONGLONG   value = 0;
+
+    for (int index = 0; index < bytes; index++)
+        value |= (ULONGLONG)*data++ << (8 * index);
+
+    return value;
+}
+
+
+/*
+    A context file from before version 1.23: elapsed time, USHORT count
+    and the perfects themselves as 32-bit ULONGs, then the last value
+    tried, with no header.  The perfects are kept; the sweep starts over.
+*/
+bool ReadLegacyContext(FILE* fd)
+{
+    uint32_t        values[cMaxPerfects];
+
+    rewind(fd);
+    if (fread(&elapsedTime, sizeof(double), 1, fd) != 1
+        || fread(&numPerfects, sizeof(USHORT), 1, fd) != 1
+        || numPerfects > cMaxPerfects
+        || fread(values, sizeof(uint32_t), numPerfects, fd) != numPerfects)
+    {
+        std::cout << "ERROR: Cannot read the old context file." << std::endl;
+        elapsedTime = 0;
+        numPerfects = 0;
+        return false;
+    }
+
+    for (int index = 0; index < numPerfects; index++)
+        PerfectArray[index] = PerfectExponent((PerfectValue)values[index]);
+    std::cout << "Old context file: " << numPerfects << " perfects kept, sweep restarted." << std::endl;
+    return true;
+}
+
+
 bool ReadContext(void)
 {
     /* Open context file and load relevant parameters.
     */
-    FILE* fd;
-
-    if (fopen_s(&fd, "PerfectNumbers.dat", "rb"))
+    FILE*           fd;
+    unsigned char   header[cContextHeader];
+    const unsigned char* field = header;
+    std::vector<unsigned char> body;
+    ULONG           version, length, crc;
+
+    contextFirst = contextLast = 0;
+    if ((fd = open_file(ContextFile.c_str(), "rb")) == nullptr)
     {
-        printf("\nCannot open context file 'PerfectNumbers.dat'.");
-        printf("\nStarting from scratch...\n");
+        if (!Quiet)
+        {
+            printf("\nCannot open context file '%s'.", ContextFile.c_str());
+            printf("\nStarting from scratch...\n");
+        }
         return true;
     }
 
-    // Read elapsed time
-    if (fread(&elapsedTime, sizeof(double), 1, fd) != 1)
+    // check the header, and the body against its checksum
+    if (fread(header, 1, cContextHeader, fd) != cContextHeader || memcmp(header, cContextMagic, 8) != 0)
     {
-        std::cout << "ERROR: Cannot read elapsed time." << std::endl;
+        bool    legacy = ReadLegacyContext(fd);
+
         fclose(fd);
-        return false;
+        if (!legacy)
+            return SetAsideContext();
+        contextFirst = 3;
+        contextLast = cMaxPower;
+        return true;
     }
- 
-    // Read number of perfects
-    if (fread(&numPerfects, sizeof(USHORT), 1, fd) != 1)
+
+    field += 8;
+    version = (ULONG)GetField(field, 4);
+    length = (ULONG)GetField(field, 4);
+    crc = (ULONG)GetField(field, 4);
+    if (version < 2 || version > cContextVersion || length > cContextMaxBody)
     {
-        std::cout << "ERROR: Cannot read nuber of perfects found." << std::endl;
+        std::cout << "ERROR: Context file version " << version << " is not " << cContextVersion << "." << std::endl;
         fclose(fd);
-        return false;
+        return SetAsideContext();
     }
 
-    // Read perfect array
-    if (fread(PerfectArray, sizeof(ULONG), numPerfects, fd) != numPerfects)
+    body.resize(length);
+    if (fread(body.data(), 1, length, fd) != length || ContextChecksum(body.data(), length) != crc)
     {
-        std::cout << "ERROR: Cannot read perfect numbers." << std::endl;
+        std::cout << "ERROR: Context file is damaged; starting from scratch." << std::endl;
         fclose(fd);
-        return false;
+        return SetAsideContext();
+    }
+    fclose(fd);
+
+    // the body's layout is fixed by the version; its length is checked
+    // before every field that depends on a count
+    field = body.data();
+    if (length < 18)
+    {
+        std::cout << "ERROR: Context file does not make sense; starting from scratch." << std::endl;
+        return SetAsideContext();
+    }
+
+    ULONGLONG   timeBits = GetField(field, 8);
+    ULONG       hi = (ULONG)GetField(field, 4);
+    ULONG       lo = (ULONG)GetField(field, 4);
+    ULONG       count = (ULONG)GetField(field, 2);
+
+    ULONG       perfectBytes = (version >= 4) ? 4 : 16;
+    ULONG       fixed = 18 + perfectBytes * count + 8 * cVerdictCount;
+    ULONG       bands = 0;
+
+    // version 3 lists the bands the workers of a distributed run started
+    if (version >= 3 && count <= cMaxPerfects && length >= fixed + 2)
+        bands = body[fixed] | (body[fixed + 1] << 8);
+
+    if (count > cMaxPerfects || length != fixed + (version >= 3 ? 2 + 8 * bands : 0) + (version >= 5 ? 8 : 0)
+        || (hi > cMaxPower && hi != 2 * lo + 1) || (hi != 0 && (lo == 0 || lo >= hi)))
+    {
+        std::cout << "ERROR: Context file does not make sense; starting from scratch." << std::endl;
+        return SetAsideContext();
+    }
+
+    // version 5 ends with the bands the run was of; before that, all of them
+    const unsigned char*    bounds = body.data() + length - 8;
+    ULONG       first = (version >= 5) ? (ULONG)GetField(bounds, 4) : 3;
+    ULONG       last = (version >= 5) ? (ULONG)GetField(bounds, 4) : cMaxPower;
+
+    if (first < 3 || first > last || last > cMaxPower)
+    {
+        std::cout << "ERROR: Context file does not make sense; starting from scratch." << std::endl;
+        return SetAsideContext();
+    }
+    contextFirst = first;
+    contextLast = last;
+
+    memcpy(&elapsedTime, &timeBits, sizeof(double));
+    numPerfects = (USHORT)count;
+    for (ULONG index = 0; index < count; index++)
+    {
+        if (version >= 4)
+        {
+            PerfectArray[index] = (ULONG)GetField(field, 4);
+            continue;
+        }
+
+        ULONGLONG       low = GetField(field, 8);
+        ULONGLONG       high = GetField(field, 8);
+        PerfectValue    value = (PerfectValue)low;
+
+        if (high != 0)
+            value |= (PerfectValue)high << 32 << 32;
+        PerfectArray[index] = PerfectExponent(value);
     }
+    for (int index = 0; index < cVerdictCount; index++)
+        VerdictCount[index] = GetField(field, 8);
 
-#if 0
-    // now read the current value for testing
-    if (fread(&curValue, sizeof(ULONG), 1, fd) != 1)
+    if (version >= 3)
+        field += 2;
+    for (ULONG index = 0; index < bands; index++)
+    {
+        ULONG   band = (ULONG)GetField(field, 4);
+        ULONG   lowest = (ULONG)GetField(field, 4);
+
+        if (band > hi && band <= cMaxPower && lowest != 0 && lowest < band)
+            BandSettled[band] = lowest;
+    }
+
+    // the last candidate settled; the sweep picks up right after it
+    hiPower = hi;
+    loPower = lo;
+    if (hiPower != 0)
+        curValue = (hiPower <= cMaxPower) ? pair_value<PerfectValue>(hiPower, loPower) : 0;
+
+    return true;
+}
+
+
+/*
+    A context that would not load is renamed to .bad, so the first save of
+    the fresh sweep cannot overwrite it; false, and the run does not
+    start, if it cannot be moved or there is a .bad already.
+*/
+bool SetAsideContext(void)
+{
+    std::string     aside = ContextFile + ".bad";
+    FILE*           fd = open_file(aside.c_str(), "rb");
+
+    // nor an earlier one moved aside
+    if (fd != nullptr)
     {
-        std::cout << "ERROR: Cannot read the current value." << std::endl;
         fclose(fd);
+        std::cout << "ERROR: '" << aside << "' is in the way; not overwriting '" << ContextFile << "'." << std::endl;
+        return false;
+    }
+    if (!replace_file(ContextFile.c_str(), aside.c_str()))
+    {
+        std::cout << "ERROR: Cannot move context file '" << ContextFile << "' aside; not overwriting it." << std::endl;
         return false;
     }
-#endif
 
-    // Close file and return
-    fclose(fd);
+    std::cout << "The unreadable context file is now '" << aside << "'." << std::endl;
     return true;
 }
 
 
+/*
+    Write the whole context to a temporary file, flush it to disk, and
+    only then rename it over the old one, so a crash at any point leaves
+    either the old context or the new one, never half of each.
+*/
 bool SaveContext(void)
+{
+    return WriteContext(ContextImage());
+}
+
+
+/*
+    The context file's bytes, copied under StateLock so that the file can
+    be written without it.  The caller holds ConsoleLock, or is the only
+    thread left, for the elapsed time.
+*/
+std::vector<unsigned char> ContextImage(void)
+{
+    std::lock_guard<std::mutex> guard(StateLock);
+    std::vector<unsigned char> file, body;
+    std::vector<ULONG> bands;
+    ULONGLONG       timeBits;
+
+    memcpy(&timeBits, &elapsedTime, sizeof(double));
+    PutField(body, timeBits, 8);
+    PutField(body, hiPower, 4);
+    PutField(body, loPower, 4);
+    PutField(body, numPerfects, 2);
+    for (int index = 0; index < numPerfects; index++)
+        PutField(body, PerfectArray[index], 4);
+    for (int index = 0; index < cVerdictCount; index++)
+        PutField(body, VerdictCount[index], 8);
+    for (ULONG power = hiPower + 1; power <= cMaxPower; power++)
+        if (BandSettled[power] != 0)
+            bands.push_back(power);
+    PutField(body, bands.size(), 2);
+    for (size_t index = 0; index < bands.size(); index++)
+    {
+        PutField(body, bands[index], 4);
+        PutField(body, BandSettled[bands[index]], 4);
+    }
+    PutField(body, firstBand, 4);
+    PutField(body, lastBand, 4);
+
+    file.assign(cContextMagic, cContextMagic + 8);
+    PutField(file, cContextVersion, 4);
+    PutField(file, body.size(), 4);
+    PutField(file, ContextChecksum(body.data(), body.size()), 4);
+    file.insert(file.end(), body.begin(), body.end());
+
+    return file;
+}
+
+
+/*
+    Write a ContextImage() out, and the sigma cache with it.
+*/
+bool WriteContext(const std::vector<unsigned char>& file)
 {
     /* Open context file and save relevant parameters.
     */
-    FILE* fd;
+    FILE*           fd;
+    std::string     temp = ContextFile + cTempSuffix;
+
+    lastSaveTime = wall_seconds();
+    LiveSaveTime.store(lastSaveTime, std::memory_order_relaxed);
 
-    if (fopen_s(&fd, "PerfectNumbers.dat", "wb"))
+    if ((fd = open_file(temp.c_str(), "wb")) == nullptr)
     {
-        printf("\nCannot open context file 'PerfectNumbers.dat'.");
+        printf("\nCannot open context file '%s'.", temp.c_str());
         printf("\nData will be lost...\n");
         return false;
     }
 
-    // Write elapsed time
-    if (fwrite(&elapsedTime, sizeof(double), 1, fd) != 1)
+    if (fwrite(file.data(), 1, file.size(), fd) != file.size() || !flush_file(fd))
     {
-        std::cout << "ERROR: Cannot write elasped time." << std::endl;
+        std::cout << "ERROR: Cannot write the context file." << std::endl;
         fclose(fd);
+        remove(temp.c_str());
         return false;
     }
+    fclose(fd);
 
-    // Write number of perfects
-    if (fwrite(&numPerfects, sizeof(USHORT), 1, fd) != 1)
+    if (!replace_file(temp.c_str(), ContextFile.c_str()))
     {
-        std::cout << "ERROR: Cannot number of perfects." << std::endl;
-        fclose(fd);
+        std::cout << "ERROR: Cannot replace the context file." << std::endl;
         return false;
     }
 
-    // Write perfect array
-    if (fwrite(PerfectArray, sizeof(ULONG), numPerfects, fd) != numPerfects)
-    {
-        std::cout << "ERROR: Cannot write perfects array." << std::endl;
-        fclose(fd);
+    return Options.engine != cEngineRow || SaveCache();
+}
+
+
+/*
+    The sigma cache, next to the context and written the same way:
+
+    char        magic[8];           "PerfSig" and a NUL
+    ULONG       version;            cCacheVersion
+    ULONG       length;             bytes in the body that follows
+    ULONG       checksum;           CRC-32 of the body
+    body, per entry:
+    ULONGLONG   odd[2], sum[2];     low 64 bits first
+    ULONGLONG   reached;
+    UCHAR       complete;
+
+    It only saves work, so a file that is missing or does not check out
+    is passed over and the cache starts empty.
+*/
+bool ReadCache(void)
+{
+    FILE*           fd;
+    std::vector<unsigned char> file;
+    const unsigned char* field;
+    unsigned char   buffer[0x1000];
+    size_t          length;
+    ULONG           bodyLength;
+
+    if ((fd = open_file(CacheFile.c_str(), "rb")) == nullptr)
+        return false;
+    while ((length = fread(buffer, 1, sizeof(buffer), fd)) != 0)
+        file.insert(file.end(), buffer, buffer + length);
+    fclose(fd);
+
+    field = file.data() + 8;
+    if (file.size() < cContextHeader || memcmp(file.data(), cCacheMagic, 8) != 0 || GetField(field, 4) != cCacheVersion
+        || (bodyLength = (ULONG)GetField(field, 4)) != file.size() - cContextHeader || bodyLength % cCacheEntry != 0
+        || GetField(field, 4) != ContextChecksum(file.data() + cContextHeader, bodyLength))
         return false;
+
+    for (field = file.data() + cContextHeader; field < file.data() + file.size(); )
+    {
+        OddProgress     progress;
+
+        progress.odd = (PerfectValue)GetField(field, 8);
+        progress.odd |= (PerfectValue)GetField(field, 8) << 32 << 32;
+        progress.sum = (PerfectValue)GetField(field, 8);
+        progress.sum |= (PerfectValue)GetField(field, 8) << 32 << 32;
+        progress.reached = GetField(field, 8);
+        progress.complete = GetField(field, 1) != 0;
+        if (progress.odd != 0)
+            OddCache.Store(progress);
     }
 
-#if 0
-    // Now write the current value for testing
-    if (fwrite(&curValue, sizeof(ULONG), 1, fd) != 1)
+    return true;
+}
+
+
+bool SaveCache(void)
+{
+    FILE*           fd;
+    std::vector<unsigned char> file, body;
+    std::vector<OddProgress> entries;
+    std::string     temp = CacheFile + cTempSuffix;
+
+    OddCache.Entries(entries);
+    for (size_t index = 0; index < entries.size(); index++)
+    {
+        PutField(body, (ULONGLONG)entries[index].odd, 8);
+        PutField(body, (ULONGLONG)(entries[index].odd >> 32 >> 32), 8);
+        PutField(body, (ULONGLONG)entries[index].sum, 8);
+        PutField(body, (ULONGLONG)(entries[index].sum >> 32 >> 32), 8);
+        PutField(body, entries[index].reached, 8);
+        PutField(body, entries[index].complete ? 1 : 0, 1);
+    }
+
+    file.assign(cCacheMagic, cCacheMagic + 8);
+    PutField(file, cCacheVersion, 4);
+    PutField(file, body.size(), 4);
+    PutField(file, ContextChecksum(body.data(), body.size()), 4);
+    file.insert(file.end(), body.begin(), body.end());
+
+    if ((fd = open_file(temp.c_str(), "wb")) == nullptr)
+        return false;
+    if (fwrite(file.data(), 1, file.size(), fd) != file.size() || !flush_file(fd))
     {
-        std::cout << "ERROR: Cannot write current value." << std::endl;
         fclose(fd);
+        remove(temp.c_str());
         return false;
-}
-#endif
-
-    // Close file and return
+    }
     fclose(fd);
-    return true;
+
+    return replace_file(temp.c_str(), CacheFile.c_str());
 }
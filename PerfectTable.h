@@ -0,0 +1,106 @@
+/*
+    PerfectTable.h -- The verdict of every small 2^x - 2^y pair, worked
+    out by the compiler (part of PerfectLib).
+
+    2^x - 2^y = 2^y * m with m = 2^(x-y) - 1 odd, so sigma of the pair is
+    (2^(y+1) - 1) * sigma(m), and below cTablePower there are only
+    cTablePower - 1 odd parts to factor.  Each is factored by constexpr
+    trial division over the odd numbers; the hardest, 2^46 - 1, needs a
+    little under 10^5 steps, which every compiler's constexpr budget
+    allows.  Past 2^49 - 1 (a large prime factor) they would not, which is
+    what caps cTablePower.
+
+    The sweep answers every pair with hiPower <= cTablePower from the
+    table, so a run starts above it at once even with /V.  A verdict from
+    the table is perfect, abundant or deficient: with no divisors tried
+    there is no short.
+
+    PERFECT_TABLE_POWER sets the bound at build time (the CMake option of
+    the same name); 0 turns the table off.
+*/
+#pragma once
+
+#include "Perfect.h"
+
+#ifndef PERFECT_TABLE_POWER
+#define PERFECT_TABLE_POWER 40
+#endif
+
+
+const unsigned  cTablePower = PERFECT_TABLE_POWER;  // highest hiPower in the table
+
+static_assert(cTablePower <= 48, "the constexpr factoring runs out of steps past 2^48 - 1");
+
+
+struct PairTable
+{
+    uint64_t        oddSigma[cTablePower + 1];                  // sigma(2^k - 1) by k
+    PerfectVerdict  verdicts[cTablePower + 1][cTablePower + 1]; // by hiPower, loPower
+};
+
+
+// sigma(m) for odd m, from its factorization by trial division.
+constexpr uint64_t odd_sigma(uint64_t value)
+{
+    uint64_t    sigma = 1;
+
+    for (uint64_t prime = 3; prime * prime <= value; prime += 2)
+    {
+        uint64_t    power = 1, term = 1;
+
+        while (value % prime == 0)
+        {
+            value /= prime;
+            power *= prime;
+            term += power;
+        }
+        sigma *= term;
+    }
+
+    return (value > 1) ? sigma * (value + 1) : sigma;
+}
+
+
+// sigma of 2^hiPower - 2^loPower against twice the value decides it.
+constexpr PairTable make_pair_table(void)
+{
+    PairTable   table = {};
+
+    for (unsigned power = 1; power <= cTablePower; power++)
+        table.oddSigma[power] = odd_sigma((1ULL << power) - 1);
+
+    for (unsigned hiPower = 2; hiPower <= cTablePower; hiPower++)
+    {
+        for (unsigned loPower = 1; loPower < hiPower; loPower++)
+        {
+            uint64_t    value = ((1ULL << (hiPower - loPower)) - 1) << loPower;
+            uint64_t    sigma = ((1ULL << (loPower + 1)) - 1) * table.oddSigma[hiPower - loPower];
+
+            table.verdicts[hiPower][loPower] = (sigma == 2 * value) ? cVerdictPerfect
+                : (sigma > 2 * value) ? cVerdictAbundant : cVerdictDeficient;
+        }
+    }
+
+    return table;
+}
+
+
+constexpr PairTable cPairTable = make_pair_table();
+
+// the Euclid perfects, as the compiler found them
+static_assert(cTablePower < 3 || cPairTable.verdicts[3][1] == cVerdictPerfect, "6");
+static_assert(cTablePower < 5 || cPairTable.verdicts[5][2] == cVerdictPerfect, "28");
+static_assert(cTablePower < 9 || cPairTable.verdicts[9][4] == cVerdictPerfect, "496");
+static_assert(cTablePower < 13 || cPairTable.verdicts[13][6] == cVerdictPerfect, "8128");
+static_assert(cTablePower < 25 || cPairTable.verdicts[25][12] == cVerdictPerfect, "33550336");
+static_assert(cTablePower < 33 || cPairTable.verdicts[33][16] == cVerdictPerfect, "8589869056");
+static_assert(cTablePower < 37 || cPairTable.verdicts[37][18] == cVerdictPerfect, "137438691328");
+static_assert(cTablePower < 4 || cPairTable.verdicts[4][2] == cVerdictAbundant, "12");
+
+
+// The verdict of 2^hiPower - 2^loPower, 0 < loPower < hiPower <=
+// cTablePower.
+constexpr PerfectVerdict table_verdict(unsigned hiPower, unsigned loPower)
+{
+    return cPairTable.verdicts[hiPower][loPower];
+}
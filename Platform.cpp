@@ -0,0 +1,543 @@
+/*
+    Platform.cpp -- What the console program needs from the OS (Win32
+    and POSIX).
+*/
+#include "Platform.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <chrono>
+#include <mutex>
+
+#if defined(_WIN32)
+#include <conio.h>
+#include <io.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+
+const size_t    cMaxLine = 0x1000;              // longest line net_read_line() takes
+
+
+static void     (*StopHandler)(void);
+static const std::atomic<bool>* StopSettled;
+static std::once_flag   NetStarted;
+
+extern "C" void OnSignal(int);
+static void     NetStartup(void);
+static void     CloseSocket(net_socket socket);
+static bool     WaitReadable(net_socket socket, ULONG millis);
+
+
+extern "C" void OnSignal(int)
+{
+    if (StopHandler != nullptr)
+        StopHandler();
+}
+
+
+double wall_seconds(void)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+#if defined(_WIN32)
+
+static BOOL WINAPI OnConsoleEvent(DWORD event);
+
+
+void console_open(void)
+{
+}
+
+
+void console_close(void)
+{
+}
+
+
+bool console_key_ready(void)
+{
+    return _kbhit() != 0;
+}
+
+
+int console_read_key(void)
+{
+    return _getch();
+}
+
+
+void console_put(int ch)
+{
+    _putch(ch);
+}
+
+
+FILE* open_file(const char* name, const char* mode)
+{
+    FILE*   fd;
+
+    return fopen_s(&fd, name, mode) ? nullptr : fd;
+}
+
+
+bool flush_file(FILE* fd)
+{
+    return fflush(fd) == 0 && _commit(_fileno(fd)) == 0;
+}
+
+
+bool replace_file(const char* from, const char* to)
+{
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+
+bool map_open(const char* name, uint64_t size, bool writable, mapped_file& file)
+{
+    HANDLE          handle, mapping;
+    LARGE_INTEGER   length;
+
+    handle = CreateFileA(name, writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                         writable ? FILE_SHARE_READ : FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                         writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+
+    // setting the end allocates the space on NTFS
+    if (!GetFileSizeEx(handle, &length)
+        || (writable && (uint64_t)length.QuadPart < size
+            && (length.QuadPart = (LONGLONG)size, !SetFilePointerEx(handle, length, nullptr, FILE_BEGIN) || !SetEndOfFile(handle))))
+    {
+        CloseHandle(handle);
+        return false;
+    }
+
+    mapping = CreateFileMappingA(handle, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        CloseHandle(handle);
+        return false;
+    }
+
+    file.handle = (intptr_t)handle;
+    file.mapping = (intptr_t)mapping;
+    file.writable = writable;
+    file.size = (uint64_t)length.QuadPart;
+    return true;
+}
+
+
+bool map_view(mapped_file& file, uint64_t offset, size_t length, mapped_view& view)
+{
+    SYSTEM_INFO     system;
+    uint64_t        base;
+
+    GetSystemInfo(&system);
+    base = offset - offset % system.dwAllocationGranularity;
+    view.length = (size_t)(offset - base) + length;
+    view.base = MapViewOfFile((HANDLE)file.mapping, file.writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+                              (DWORD)(base >> 32), (DWORD)base, view.length);
+    view.data = view.base ? (unsigned char*)view.base + (offset - base) : nullptr;
+    return view.base != nullptr;
+}
+
+
+bool map_release(mapped_view& view, bool flush)
+{
+    bool    flushed = !flush || FlushViewOfFile(view.base, view.length) != 0;
+    bool    released = UnmapViewOfFile(view.base) != 0;
+
+    view = mapped_view();
+    return flushed && released;
+}
+
+
+void map_close(mapped_file& file)
+{
+    if (file.handle == -1)
+        return;
+    if (file.writable)
+        FlushFileBuffers((HANDLE)file.handle);
+    CloseHandle((HANDLE)file.mapping);
+    CloseHandle((HANDLE)file.handle);
+    file = mapped_file();
+}
+
+
+/*
+    Ctrl+C, Ctrl+Break, closing the console window, logoff and shutdown.
+*/
+static BOOL WINAPI OnConsoleEvent(DWORD event)
+{
+    OnSignal(0);
+    if (event == CTRL_CLOSE_EVENT || event == CTRL_LOGOFF_EVENT || event == CTRL_SHUTDOWN_EVENT)
+        for (int wait = 0; wait < 80 && StopSettled != nullptr && !StopSettled->load(); wait++)
+            Sleep(50);
+
+    return TRUE;
+}
+
+
+void install_stop_handlers(void (*stop)(void), const std::atomic<bool>* settled)
+{
+    StopHandler = stop;
+    StopSettled = settled;
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    SetConsoleCtrlHandler(OnConsoleEvent, TRUE);
+}
+
+
+static void NetStartup(void)
+{
+    WSADATA     data;
+
+    WSAStartup(MAKEWORD(2, 2), &data);
+}
+
+
+static void CloseSocket(net_socket socket)
+{
+    closesocket((SOCKET)socket);
+}
+
+#else
+
+static bool             ConsoleRaw;             // stdin is a terminal in single-key mode
+static struct termios   ConsoleSaved;           // its mode before
+
+
+void console_open(void)
+{
+    struct termios  raw;
+
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &ConsoleSaved) != 0)
+        return;
+
+    raw = ConsoleSaved;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    ConsoleRaw = (tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0);
+}
+
+
+void console_close(void)
+{
+    if (ConsoleRaw)
+        tcsetattr(STDIN_FILENO, TCSANOW, &ConsoleSaved);
+    ConsoleRaw = false;
+}
+
+
+bool console_key_ready(void)
+{
+    struct pollfd   input = { STDIN_FILENO, POLLIN, 0 };
+
+    return ConsoleRaw && poll(&input, 1, 0) > 0 && (input.revents & POLLIN) != 0;
+}
+
+
+int console_read_key(void)
+{
+    unsigned char   key;
+
+    return (read(STDIN_FILENO, &key, 1) == 1) ? key : 0;
+}
+
+
+void console_put(int ch)
+{
+    putchar(ch);
+    fflush(stdout);
+}
+
+
+FILE* open_file(const char* name, const char* mode)
+{
+    return fopen(name, mode);
+}
+
+
+bool flush_file(FILE* fd)
+{
+    return fflush(fd) == 0 && fsync(fileno(fd)) == 0;
+}
+
+
+bool replace_file(const char* from, const char* to)
+{
+    return rename(from, to) == 0;
+}
+
+
+bool map_open(const char* name, uint64_t size, bool writable, mapped_file& file)
+{
+    int             handle = open(name, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    struct stat     status;
+
+    if (handle < 0)
+        return false;
+    if (fstat(handle, &status) != 0)
+    {
+        close(handle);
+        return false;
+    }
+
+    // reserve the blocks where the file system can, or a store into a
+    // hole on a full disk is a SIGBUS; elsewhere the file is sparse
+    if (writable && (uint64_t)status.st_size < size)
+    {
+#if defined(__linux__)
+        int     error = posix_fallocate(handle, 0, (off_t)size);
+
+        if (error == EINVAL || error == EOPNOTSUPP)
+            error = ftruncate(handle, (off_t)size);
+#else
+        int     error = ftruncate(handle, (off_t)size);
+#endif
+        if (error != 0)
+        {
+            close(handle);
+            return false;
+        }
+        status.st_size = (off_t)size;
+    }
+
+    file.handle = handle;
+    file.mapping = -1;
+    file.writable = writable;
+    file.size = (uint64_t)status.st_size;
+    return true;
+}
+
+
+bool map_view(mapped_file& file, uint64_t offset, size_t length, mapped_view& view)
+{
+    uint64_t    base = offset - offset % (uint64_t)sysconf(_SC_PAGESIZE);
+    int         flags = MAP_SHARED;
+    void*       mapped;
+
+    // a view to be written is faulted in whole, not a page per store
+#if defined(MAP_POPULATE)
+    if (file.writable)
+        flags |= MAP_POPULATE;
+#endif
+    view.length = (size_t)(offset - base) + length;
+    mapped = mmap(nullptr, view.length, file.writable ? PROT_READ | PROT_WRITE : PROT_READ, flags,
+                  (int)file.handle, (off_t)base);
+    view.base = (mapped != MAP_FAILED) ? mapped : nullptr;
+    view.data = view.base ? (unsigned char*)view.base + (offset - base) : nullptr;
+    return view.base != nullptr;
+}
+
+
+bool map_release(mapped_view& view, bool flush)
+{
+    bool    flushed = !flush || msync(view.base, view.length, MS_SYNC) == 0;
+    bool    released = munmap(view.base, view.length) == 0;
+
+    view = mapped_view();
+    return flushed && released;
+}
+
+
+void map_close(mapped_file& file)
+{
+    if (file.handle == -1)
+        return;
+    if (file.writable)
+        fsync((int)file.handle);
+    close((int)file.handle);
+    file = mapped_file();
+}
+
+
+void install_stop_handlers(void (*stop)(void), const std::atomic<bool>* settled)
+{
+    struct sigaction    action = {};
+
+    StopHandler = stop;
+    StopSettled = settled;
+    action.sa_handler = OnSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+}
+
+
+// a worker whose coordinator hung up gets an error from send(), not a
+// SIGPIPE that ends the process
+static void NetStartup(void)
+{
+    signal(SIGPIPE, SIG_IGN);
+}
+
+
+static void CloseSocket(net_socket socket)
+{
+    close((int)socket);
+}
+
+#endif
+
+
+/*
+    The sockets are the same on both sides once they are started; a
+    SOCKET fits in a net_socket, and INVALID_SOCKET comes out as -1.
+*/
+static bool WaitReadable(net_socket socket, ULONG millis)
+{
+    fd_set          readable;
+    struct timeval  timeout = { (long)(millis / 1000), (long)(millis % 1000) * 1000 };
+
+    FD_ZERO(&readable);
+    FD_SET(socket, &readable);
+
+    return select((int)socket + 1, &readable, nullptr, nullptr, &timeout) > 0;
+}
+
+
+net_socket net_listen(unsigned port)
+{
+    struct sockaddr_in  address;
+    net_socket          server;
+    int                 reuse = 1;
+
+    std::call_once(NetStarted, NetStartup);
+    if ((server = (net_socket)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) == cNoSocket)
+        return cNoSocket;
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons((unsigned short)port);
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+    if (bind(server, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(server, SOMAXCONN) != 0)
+    {
+        CloseSocket(server);
+        return cNoSocket;
+    }
+
+    return server;
+}
+
+
+net_socket net_accept(net_socket server, ULONG millis)
+{
+    if (!WaitReadable(server, millis))
+        return cNoSocket;
+
+    return (net_socket)accept(server, nullptr, nullptr);
+}
+
+
+net_socket net_connect(const char* host, unsigned port)
+{
+    struct addrinfo     hints, *found, *address;
+    net_socket          client = cNoSocket;
+    char                service[16];
+
+    std::call_once(NetStarted, NetStartup);
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(service, sizeof(service), "%u", port);
+    if (getaddrinfo(host, service, &hints, &found) != 0)
+        return cNoSocket;
+
+    for (address = found; address != nullptr; address = address->ai_next)
+    {
+        client = (net_socket)socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (client == cNoSocket)
+            continue;
+        if (connect(client, address->ai_addr, (int)address->ai_addrlen) == 0)
+            break;
+        CloseSocket(client);
+        client = cNoSocket;
+    }
+
+    freeaddrinfo(found);
+    return client;
+}
+
+
+bool net_send_line(net_socket socket, const std::string& line)
+{
+    std::string     text = line + "\n";
+    size_t          sent = 0;
+
+    while (sent < text.size())
+    {
+        int     count = (int)send(socket, text.data() + sent, (int)(text.size() - sent), 0);
+
+        if (count <= 0)
+            return false;
+        sent += (size_t)count;
+    }
+
+    return true;
+}
+
+
+/*
+    A byte at a time: the lines are short and one goes each way per
+    connection, so there is never anything past the newline to keep.
+*/
+bool net_read_line(net_socket socket, std::string& line, ULONG millis)
+{
+    double      deadline = wall_seconds() + millis / 1000.0;
+    char        ch;
+
+    line.clear();
+    while (line.size() < cMaxLine)
+    {
+        double  left = deadline - wall_seconds();
+
+        if (left <= 0 || !WaitReadable(socket, (ULONG)(left * 1000) + 1) || recv(socket, &ch, 1, 0) != 1)
+            return false;
+        if (ch == '\n')
+            return true;
+        if (ch != '\r')
+            line += ch;
+    }
+
+    return false;
+}
+
+
+void net_close(net_socket socket)
+{
+    if (socket != cNoSocket)
+        CloseSocket(socket);
+}
+
+
+std::string net_host_name(void)
+{
+    char    name[256];
+
+    std::call_once(NetStarted, NetStartup);
+    if (gethostname(name, sizeof(name)) != 0)
+        return "unknown";
+
+    name[sizeof(name) - 1] = '\0';
+    return name;
+}
@@ -0,0 +1,119 @@
+/*
+    Platform.h -- What the console program needs from the OS: the
+    keyboard, a clock, durable file replacement, mapped files, the stop
+    events and the TCP lines of the distributed sweep.
+
+    PerfectNumbers.cpp calls only these, so it builds the same with the
+    Visual Studio project on Windows and with CMake on Linux and macOS.
+    The libraries never needed any of it.
+*/
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+typedef uint32_t            ULONG;
+typedef uint16_t            USHORT;
+typedef unsigned long long  ULONGLONG;
+#endif
+
+typedef intptr_t            net_socket;         // a SOCKET or a file descriptor
+const net_socket            cNoSocket = -1;
+
+// A file mapped a view at a time, for files larger than one view.
+struct mapped_file
+{
+    intptr_t        handle;                     // a HANDLE or a file descriptor; -1 when closed
+    intptr_t        mapping;                    // the file-mapping HANDLE on Windows
+    bool            writable;
+    uint64_t        size;                       // bytes in the file
+
+    mapped_file() : handle(-1), mapping(-1), writable(false), size(0) {}
+};
+
+// Part of a mapped file: data is the byte asked for, base and length
+// what was mapped around it.
+struct mapped_view
+{
+    unsigned char*  data;
+    void*           base;
+    size_t          length;
+
+    mapped_view() : data(nullptr), base(nullptr), length(0) {}
+};
+
+
+// Put the console in single-key mode (no echo, no line buffering) if
+// there is one; console_close() puts it back.
+void        console_open(void);
+void        console_close(void);
+
+// True when a key is waiting.  Never true without a console, so the
+// program runs headless with its input redirected.
+bool        console_key_ready(void);
+
+// The waiting key; call only after console_key_ready().
+int         console_read_key(void);
+
+// Write one character straight to the console.
+void        console_put(int ch);
+
+// Seconds on a monotonic clock, for elapsed times.
+double      wall_seconds(void);
+
+// fopen(); null if the file cannot be opened.
+FILE*       open_file(const char* name, const char* mode);
+
+// Flush a file and force it to the disk.
+bool        flush_file(FILE* fd);
+
+// Rename from over to, replacing it in a single step.
+bool        replace_file(const char* from, const char* to);
+
+// Open name for mapping.  Writable, it is created if need be and its
+// disk space reserved up to size bytes, so a store through a view never
+// finds the disk full; read-only, size is ignored and the file must be
+// there.  false if it cannot be had.
+bool        map_open(const char* name, uint64_t size, bool writable, mapped_file& file);
+
+// Map length bytes at any offset of the file; false if they cannot be.
+bool        map_view(mapped_file& file, uint64_t offset, size_t length, mapped_view& view);
+
+// Unmap a view, forcing its stores to the disk first if flush.
+bool        map_release(mapped_view& view, bool flush);
+
+// Close the file; its views must be released first.
+void        map_close(mapped_file& file);
+
+// Call stop() on SIGINT and SIGTERM, and on Windows on the console
+// events too.  The close, logoff and shutdown events end the process
+// once their handler returns, so they wait for settled first.
+void        install_stop_handlers(void (*stop)(void), const std::atomic<bool>* settled);
+
+// A TCP socket listening on port, on every interface; cNoSocket if the
+// port cannot be had.
+net_socket  net_listen(unsigned port);
+
+// The next connection to server, waiting at most millis for one;
+// cNoSocket if none came.
+net_socket  net_accept(net_socket server, ULONG millis);
+
+// A connection to host:port; cNoSocket if there is no answer.
+net_socket  net_connect(const char* host, unsigned port);
+
+// Send text and a newline.
+bool        net_send_line(net_socket socket, const std::string& line);
+
+// Read up to a newline, which is dropped, waiting at most millis in all.
+bool        net_read_line(net_socket socket, std::string& line, ULONG millis);
+
+void        net_close(net_socket socket);
+
+// This machine's name, to tell the workers apart.
+std::string net_host_name(void);
@@ -0,0 +1,364 @@
+/*
+    PrimeSieve.cpp -- Shared prime table and the sigma engine (part of
+    PerfectLib).
+*/
+#include "PrimeSieve.h"
+#include "NodeLocal.h"
+#include "Scratch.h"
+
+#include <string.h>
+#include <atomic>
+#include <mutex>
+
+
+const size_t    cSieveCachePrimes = 1077871;        // primes below cSieveCacheLimit
+const uint64_t  cSegmentsEnd = (uint64_t)1 << 32;   // the base primes sieve up to here
+
+static uint32_t*        Table;                      // allocated whole, filled in order
+static size_t           BaseCount;                  // primes below cMaxPrime; read-only once built
+static std::once_flag   BaseBuilt;
+static std::atomic<size_t>   Count(0);              // entries 0..Count-1 are valid
+static std::atomic<uint64_t> Sieved(0);             // every prime below this is present
+static std::mutex       GrowLock;
+static NodeReplicas<uint32_t> Copies;               // of Table, for the workers of other nodes
+
+static void     SieveBase(void);
+template <typename T, typename Sink>
+static bool     FactorInto(T value, Sink& sink);
+template <typename T, typename Sink>
+static inline bool PullPower(T& rest, T prime, Sink& sink);
+template <typename T> static bool SigmaPerfect(T value);
+
+
+/*
+    Plain Sieve of Eratosthenes below cMaxPrime, into the front of the
+    table.
+*/
+static void SieveBase(void)
+{
+    std::vector<bool>   composite(cMaxPrime, false);
+
+    Table = new uint32_t[cSieveCachePrimes];
+    for (uint32_t index = 2; index < cMaxPrime; index++)
+    {
+        if (composite[index])
+            continue;
+
+        Table[BaseCount++] = index;
+        for (uint32_t multiple = index * index; multiple < cMaxPrime; multiple += index)
+            composite[multiple] = true;
+    }
+
+    Count.store(BaseCount, std::memory_order_release);
+    Sieved.store(cMaxPrime, std::memory_order_release);
+}
+
+
+const uint32_t* prime_table(uint64_t limit, size_t& count)
+{
+    std::call_once(BaseBuilt, SieveBase);
+
+    if (limit >= cSieveCacheLimit)
+        limit = cSieveCacheLimit - 1;
+
+    if (Sieved.load(std::memory_order_acquire) <= limit)
+    {
+        std::lock_guard<std::mutex> guard(GrowLock);
+        std::vector<uint32_t>       segment;
+        uint64_t                    low = Sieved.load(std::memory_order_relaxed);
+        size_t                      have = Count.load(std::memory_order_relaxed);
+
+        // sieve on past what is there; readers only look below Count
+        while (low <= limit)
+        {
+            uint64_t    high = (low + cSieveSegment < cSieveCacheLimit) ? low + cSieveSegment : cSieveCacheLimit;
+
+            segment.clear();
+            sieve_segment(low, high, segment);
+            for (size_t index = 0; index < segment.size(); index++)
+                Table[have++] = segment[index];
+
+            Count.store(have, std::memory_order_release);
+            Sieved.store(low = high, std::memory_order_release);
+        }
+    }
+
+    count = Count.load(std::memory_order_acquire);
+    return Copies.Local(Table, count, cSieveCachePrimes);
+}
+
+
+void sieve_segment(uint64_t low, uint64_t high, std::vector<uint32_t>& primes)
+{
+    size_t      have = primes.size();
+
+    primes.resize(have + cSegmentPrimes);
+    primes.resize(have + sieve_segment(low, high, &primes[have]));
+}
+
+
+/*
+    The marks are the thread's scratch, a byte a number, so a sigma test
+    past the shared table sieves without allocating.
+*/
+size_t sieve_segment(uint64_t low, uint64_t high, uint32_t* primes)
+{
+    ScratchScope    scope;
+    unsigned char*  composite;
+    size_t          count = 0;
+
+    std::call_once(BaseBuilt, SieveBase);
+
+    if (low < 2)
+        low = 2;
+    if (high <= low)
+        return 0;
+
+    // cross off the multiples of each base prime, from its square up
+    composite = scope.Arena().Take<unsigned char>((size_t)(high - low));
+    memset(composite, 0, (size_t)(high - low));
+    for (size_t index = 0; index < BaseCount; index++)
+    {
+        uint64_t    prime = Table[index];
+        uint64_t    multiple = (low + prime - 1) / prime * prime;
+
+        if (prime * prime >= high)
+            break;
+        if (multiple < prime * prime)
+            multiple = prime * prime;
+
+        for (; multiple < high; multiple += prime)
+            composite[(size_t)(multiple - low)] = 1;
+    }
+
+    for (uint64_t number = low; number < high; number++)
+        if (!composite[(size_t)(number - low)])
+            primes[count++] = (uint32_t)number;
+
+    return count;
+}
+
+
+/*
+    The running product of sigma(p^e), saturated at the largest T.
+*/
+template <typename T>
+struct SigmaProduct
+{
+    T       product;
+
+    bool Add(T term, bool overflow)
+    {
+        if (overflow || product > (T)~(T)0 / term)
+        {
+            product = (T)~(T)0;
+            return false;
+        }
+
+        product *= term;
+        return true;
+    }
+
+    bool Rest(T)
+    {
+        return true;
+    }
+};
+
+
+/*
+    What is left of 2 * value, as 2^twos * odd so it cannot overflow.
+    sigma(value) == 2 * value only if every sigma(p^e) divides it.
+*/
+template <typename T>
+struct PerfectBudget
+{
+    unsigned    twos;
+    T           odd;
+    bool        possible;
+
+    bool Add(T term, bool overflow)
+    {
+        if (overflow)
+            return possible = false;
+
+        for (; (term & 1) == 0; term >>= 1)
+        {
+            if (twos == 0)
+                return possible = false;
+            twos--;
+        }
+
+        if (odd % term != 0)
+            return possible = false;
+        odd /= term;
+        return true;
+    }
+
+    // sigma(rest) must come to exactly what is left, so it must pass rest
+    // itself, and with no 2s left every prime of rest needs an even power
+    bool Rest(T rest)
+    {
+        T       root;
+
+        if (rest == 1)
+            return true;
+        if (twos < sizeof(T) * 8 && odd <= (rest >> twos))
+            return possible = false;
+        if (twos == 0 && ((root = isqrt<T>(rest)), root * root != rest))
+            return possible = false;
+
+        return true;
+    }
+};
+
+
+/*
+    Divide every power of prime out of rest and hand sigma(prime^e) to
+    the sink, then let it look at what is left; the caller has checked
+    that prime divides rest.
+*/
+template <typename T, typename Sink>
+static inline bool PullPower(T& rest, T prime, Sink& sink)
+{
+    T       term = 1;
+    bool    overflow = false;
+
+    do
+    {
+        rest /= prime;
+        if (term > ((T)~(T)0 - 1) / prime)
+            overflow = true;
+        else
+            term = term * prime + 1;
+    } while (rest % prime == 0);
+
+    return sink.Add(term, overflow) && sink.Rest(rest);
+}
+
+
+/*
+    Factor value by trial division by primes only, handing each sigma(p^e)
+    to the sink; returns false as soon as the sink has seen enough.  What
+    is left once p * p passes it is 1 or a prime.
+*/
+template <typename T, typename Sink>
+static bool FactorInto(T value, Sink& sink)
+{
+    ScratchScope        scope;
+    uint32_t*           segment = nullptr;
+    const uint32_t*     primes;
+    size_t              count, index, found;
+    T                   rest = value, prime;
+    uint64_t            low, high;
+
+    primes = prime_table((uint64_t)isqrt<T>(value), count);
+    for (index = 0; index < count; index++)
+    {
+        prime = primes[index];
+        if (prime > rest / prime)
+            goto last;
+        if (rest % prime == 0 && !PullPower(rest, prime, sink))
+            return false;
+    }
+
+    // past the shared table: sieve segments of our own, on scratch
+    for (low = (uint64_t)primes[count - 1] + 1; low < cSegmentsEnd; low = high)
+    {
+        high = (low + cSieveSegment < cSegmentsEnd) ? low + cSieveSegment : cSegmentsEnd;
+        if (segment == nullptr)
+            segment = scope.Arena().Take<uint32_t>(cSegmentPrimes);
+        found = sieve_segment(low, high, segment);
+
+        for (index = 0; index < found; index++)
+        {
+            prime = segment[index];
+            if (prime > rest / prime)
+                goto last;
+            if (rest % prime == 0 && !PullPower(rest, prime, sink))
+                return false;
+        }
+    }
+
+    // past 2^32 the base primes cannot sieve: try every odd number, which
+    // is still exact since a composite's primes are already divided out
+    for (prime = (T)cSegmentsEnd + 1; prime <= rest / prime; prime += 2)
+        if (rest % prime == 0 && !PullPower(rest, prime, sink))
+            return false;
+
+last:
+    if (rest > 1)
+        return sink.Add(rest + 1, rest == (T)~(T)0);
+
+    return true;
+}
+
+
+template <typename T>
+T sigma(T value)
+{
+    SigmaProduct<T>     sink = { 1 };
+
+    if (value < 2)
+        return value;
+
+    FactorInto<T>(value, sink);
+    return sink.product;
+}
+
+
+/*
+    The sigma test in the arithmetic of T itself.  The budget starts at
+    2 * value = 2^(twos) * odd; the factor 2 comes first, so a candidate
+    2^y * m is out at once unless 2^(y+1) - 1 divides m.
+*/
+template <typename T>
+static bool SigmaPerfect(T value)
+{
+    PerfectBudget<T>    sink = { 1, value, true };
+
+    if (value < 2)
+        return false;
+
+    for (; (sink.odd & 1) == 0; sink.odd >>= 1)
+        sink.twos++;
+
+    return FactorInto<T>(value, sink) && sink.possible && sink.twos == 0 && sink.odd == 1;
+}
+
+
+template <>
+bool is_perfect_sigma<uint32_t>(uint32_t value)
+{
+    return SigmaPerfect<uint32_t>(value);
+}
+
+
+template <>
+bool is_perfect_sigma<uint64_t>(uint64_t value)
+{
+    if (value <= UINT32_MAX)
+        return SigmaPerfect<uint32_t>((uint32_t)value);
+
+    return SigmaPerfect<uint64_t>(value);
+}
+
+
+#if defined(__SIZEOF_INT128__)
+template <>
+bool is_perfect_sigma<uint128_t>(uint128_t value)
+{
+    if (value <= UINT64_MAX)
+        return is_perfect_sigma<uint64_t>((uint64_t)value);
+
+    return SigmaPerfect<uint128_t>(value);
+}
+#endif
+
+
+// the instantiations PerfectLib provides
+template uint32_t   sigma<uint32_t>(uint32_t);
+template uint64_t   sigma<uint64_t>(uint64_t);
+#if defined(__SIZEOF_INT128__)
+template uint128_t  sigma<uint128_t>(uint128_t);
+#endif
@@ -0,0 +1,46 @@
+/*
+    PrimeSieve.h -- Shared prime table for the sigma engine (part of
+    PerfectLib).
+
+    sigma(n), the sum of all the divisors of n, is multiplicative: for
+    n = p1^e1 * p2^e2 * ..., sigma(n) = sigma(p1^e1) * sigma(p2^e2) * ...
+    with sigma(p^e) = 1 + p + ... + p^e.  Each prime power is counted
+    exactly once, so the factors are never repeated, and a candidate costs
+    about one division per prime tried instead of one per divisor.
+
+    The primes come from a segmented Sieve of Eratosthenes.  The primes
+    below cMaxPrime are sieved once; they are enough to sieve any segment
+    below 2^32.  Past them the table grows on demand, one segment at a
+    time, up to cSieveCacheLimit.  Factoring past that sieves segments on
+    the caller's own buffer instead, so the shared table stays small.
+
+    Like the reciprocal tables, the prime table only ever grows, and an
+    entry never changes once it is published, so any number of threads
+    read it without locking.
+*/
+#pragma once
+
+#include "Perfect.h"
+
+#include <stddef.h>
+#include <vector>
+
+
+const uint32_t  cMaxPrime = 0x00010000;             // base primes: enough to sieve below 2^32
+const uint32_t  cSieveCacheLimit = 0x01000000;      // the shared table grows up to here
+const uint32_t  cSieveSegment = 0x00040000;         // numbers sieved per segment
+const size_t    cSegmentPrimes = cSieveSegment / 2 + 1; // room for the primes of one
+
+
+// The shared primes, in order, with every prime <= limit present (limit
+// is clamped to cSieveCacheLimit - 1).  Returns how many there are, which
+// may be more than asked for.
+const uint32_t* prime_table(uint64_t limit, size_t& count);
+
+// Append the primes p with low <= p < high to primes, for high - low <=
+// cSieveSegment and high <= 2^32.  Uses only the base primes.
+void        sieve_segment(uint64_t low, uint64_t high, std::vector<uint32_t>& primes);
+
+// The same into primes, which has room for cSegmentPrimes; returns how
+// many there are.  Allocates nothing once the thread's scratch has grown.
+size_t      sieve_segment(uint64_t low, uint64_t high, uint32_t* primes);
@@ -0,0 +1,241 @@
+/*
+    RangeFile.cpp -- The mapped class and s(n) columns of a range scan.
+*/
+#include "RangeFile.h"
+
+#include <string.h>
+
+
+const size_t    cRangeFields = 64;              // bytes of the header that are used
+const uint64_t  cRangePage = 0x1000;            // the s(n) column starts on one of these
+
+static void     PutField(unsigned char* data, uint64_t value, unsigned bytes);
+static uint64_t GetField(const unsigned char* data, unsigned bytes);
+static unsigned BitLength(uint64_t value);
+
+
+RangeFile::RangeFile()
+    : first_(0), last_(0), written_(0), sumBytes_(0), sumOffset_(0)
+{
+}
+
+
+RangeFile::~RangeFile()
+{
+    Close();
+}
+
+
+bool RangeFile::Create(const char* fileName, uint64_t first, uint64_t last, bool sums)
+{
+    uint64_t        count = last - first + 1;
+    uint64_t        size;
+    unsigned char   fields[cRangeFields];
+    FILE*           fd;
+
+    Close();
+    first_ = first;
+    last_ = last;
+    written_ = 0;
+    sumBytes_ = sums ? (BitLength(last) + 3 + 7) / 8 : 0;
+    sumOffset_ = sums ? (cRangeHeader + (count + 3) / 4 + cRangePage - 1) / cRangePage * cRangePage : 0;
+    size = sums ? sumOffset_ + count * sumBytes_ : cRangeHeader + (count + 3) / 4;
+
+    // a file of our own is carried on; any other is left alone
+    if ((fd = open_file(fileName, "rb")) != nullptr)
+    {
+        size_t  length = fread(fields, 1, cRangeFields, fd);
+
+        fclose(fd);
+        if (length != 0)
+        {
+            if (length != cRangeFields || memcmp(fields, cRangeMagic, sizeof(cRangeMagic)) != 0
+                || GetField(fields + 8, 4) != cRangeFileVersion || GetField(fields + 12, 4) != (sums ? cRangeSums : 0)
+                || GetField(fields + 16, 8) != first || GetField(fields + 24, 8) != last)
+                return false;
+            written_ = GetField(fields + 32, 8);
+            if (written_ > count)
+                return false;
+        }
+    }
+
+    if (!map_open(fileName, size, true, file_))
+        return false;
+    if (file_.size < size || !map_view(file_, 0, cRangeHeader, header_))
+    {
+        map_close(file_);
+        return false;
+    }
+
+    WriteHeader();
+    return true;
+}
+
+
+bool RangeFile::Open(const char* fileName)
+{
+    Close();
+    if (!map_open(fileName, 0, false, file_))
+        return false;
+    if (file_.size < cRangeHeader || !map_view(file_, 0, (size_t)file_.size, header_) || !ReadHeader())
+    {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+
+void RangeFile::Close(void)
+{
+    if (!IsOpen())
+        return;
+
+    if (header_.base != nullptr)
+    {
+        if (file_.writable)
+            WriteHeader();
+        map_release(header_, file_.writable);
+    }
+    map_close(file_);
+}
+
+
+/*
+    Each byte of the class column takes four numbers; a short last
+    segment leaves the rest of its last byte unscanned.
+*/
+bool RangeFile::Store(uint64_t low, size_t count, const uint64_t* sigmas)
+{
+    uint64_t        start = low - first_;
+    mapped_view     classes, sums;
+
+    if (!IsOpen() || !file_.writable || low != first_ + written_ || low + count - 1 > last_ || start % 4 != 0)
+        return false;
+
+    if (!map_view(file_, cRangeHeader + start / 4, (count + 3) / 4, classes))
+        return false;
+    for (size_t index = 0; index < count; index += 4)
+    {
+        unsigned char   codes = 0;
+
+        for (size_t lane = 0; lane < 4 && index + lane < count; lane++)
+        {
+            uint64_t    value = low + index + lane;
+            uint64_t    sigma = sigmas[index + lane];
+            RangeClass  kind = (sigma > 2 * value) ? cRangeAbundant : (sigma == 2 * value) ? cRangePerfect : cRangeDeficient;
+
+            codes |= (unsigned char)(kind << (2 * lane));
+        }
+        classes.data[index / 4] = codes;
+    }
+    if (!map_release(classes, false))
+        return false;
+
+    if (sumOffset_ != 0)
+    {
+        if (!map_view(file_, sumOffset_ + start * sumBytes_, count * sumBytes_, sums))
+            return false;
+        for (size_t index = 0; index < count; index++)
+            PutField(sums.data + index * sumBytes_, sigmas[index] - (low + index), sumBytes_);
+        if (!map_release(sums, false))
+            return false;
+    }
+
+    written_ += count;
+    WriteHeader();
+    return true;
+}
+
+
+RangeClass RangeFile::ClassOf(uint64_t value) const
+{
+    uint64_t    index = value - first_;
+
+    if (value < first_ || index >= written_ || file_.writable)
+        return cRangeUnscanned;
+
+    return (RangeClass)((header_.data[cRangeHeader + index / 4] >> (2 * (index % 4))) & 3);
+}
+
+
+uint64_t RangeFile::SumOf(uint64_t value) const
+{
+    uint64_t    index = value - first_;
+
+    if (value < first_ || index >= written_ || file_.writable || sumOffset_ == 0)
+        return 0;
+
+    return GetField(header_.data + sumOffset_ + index * sumBytes_, sumBytes_);
+}
+
+
+/*
+    The fields of a file opened by Open(), checked against its size.
+*/
+bool RangeFile::ReadHeader(void)
+{
+    const unsigned char*    fields = header_.data;
+    uint64_t                count;
+
+    if (memcmp(fields, cRangeMagic, sizeof(cRangeMagic)) != 0 || GetField(fields + 8, 4) != cRangeFileVersion)
+        return false;
+
+    first_ = GetField(fields + 16, 8);
+    last_ = GetField(fields + 24, 8);
+    written_ = GetField(fields + 32, 8);
+    sumBytes_ = (unsigned)GetField(fields + 40, 4);
+    sumOffset_ = (GetField(fields + 12, 4) & cRangeSums) ? GetField(fields + 56, 8) : 0;
+    count = last_ - first_ + 1;
+
+    return first_ >= 1 && first_ <= last_ && written_ <= count && GetField(fields + 48, 8) == cRangeHeader
+        && file_.size >= cRangeHeader + (count + 3) / 4
+        && (sumOffset_ == 0 || (sumBytes_ >= 1 && sumBytes_ <= 8 && file_.size >= sumOffset_ + count * sumBytes_));
+}
+
+
+void RangeFile::WriteHeader(void)
+{
+    unsigned char*  fields = header_.data;
+
+    memcpy(fields, cRangeMagic, sizeof(cRangeMagic));
+    PutField(fields + 8, cRangeFileVersion, 4);
+    PutField(fields + 12, sumOffset_ ? cRangeSums : 0, 4);
+    PutField(fields + 16, first_, 8);
+    PutField(fields + 24, last_, 8);
+    PutField(fields + 32, written_, 8);
+    PutField(fields + 40, sumBytes_, 4);
+    PutField(fields + 44, 0, 4);
+    PutField(fields + 48, cRangeHeader, 8);
+    PutField(fields + 56, sumOffset_, 8);
+}
+
+
+static void PutField(unsigned char* data, uint64_t value, unsigned bytes)
+{
+    for (unsigned index = 0; index < bytes; index++)
+        data[index] = (unsigned char)(value >> (8 * index));
+}
+
+
+static uint64_t GetField(const unsigned char* data, unsigned bytes)
+{
+    uint64_t    value = 0;
+
+    for (unsigned index = bytes; index-- > 0; )
+        value = (value << 8) | data[index];
+
+    return value;
+}
+
+
+static unsigned BitLength(uint64_t value)
+{
+    unsigned    bits = 0;
+
+    for (; value != 0; value >>= 1)
+        bits++;
+
+    return bits;
+}
@@ -0,0 +1,94 @@
+/*
+    RangeFile.h -- The classes of a /I range scan, two bits an n, and if
+    asked its aliquot sums s(n) = sigma(n) - n, in a file that analysis
+    tools map and index rather than parse.
+
+    The file is reserved at its full size when it is opened, and each
+    segment of the scan is stored straight into a view of it mapped for
+    that segment, then unmapped; the segments are whole sieve blocks, so
+    every one starts on a byte of the class column.  A header page says
+    how far the columns are written, so a stopped scan is taken up where
+    it left off by running it again on the same file, and the class of an
+    n not yet scanned reads as cRangeUnscanned.
+
+    Layout, every field little-endian:
+
+    char        magic[8];           "PerfRng" and a NUL
+    ULONG       version;            cRangeFileVersion
+    ULONG       flags;              cRangeSums: the s(n) column is there
+    ULONGLONG   first, last;        the range, [a, b]
+    ULONGLONG   written;            n = first .. first + written - 1 are stored
+    ULONG       sumBytes;           bytes per s(n)
+    ULONG       reserved;
+    ULONGLONG   classOffset;        cRangeHeader: the class column
+    ULONGLONG   sumOffset;          the s(n) column, on a page after the class column; 0 without one
+
+    The class of n is bits 2k and 2k + 1 of byte k / 4 of the class
+    column, k = n - first, counting from the low bit; s(n) is sumBytes
+    bytes at sumOffset + k * sumBytes, low byte first.  sigma(n) < 8n
+    below 2^47, so s(n) takes three bits more than b does.
+*/
+#pragma once
+
+#include "Platform.h"
+#include "RangeScan.h"
+
+
+const char      cRangeMagic[8] = { 'P', 'e', 'r', 'f', 'R', 'n', 'g', '\0' };
+const ULONG     cRangeFileVersion = 1;
+const ULONG     cRangeSums = 0x00000001;        // flags: the s(n) column is there
+const size_t    cRangeHeader = 0x1000;          // the header page; the class column starts after it
+
+
+enum RangeClass
+{
+    cRangeUnscanned,                            // 0, as the reserved file reads
+    cRangeDeficient,
+    cRangePerfect,
+    cRangeAbundant
+};
+
+
+class RangeFile
+{
+public:
+    RangeFile();
+    ~RangeFile();
+
+    // Open the file of the scan of [first, last] for writing, with the
+    // s(n) column if sums.  A file left by the same scan is carried on
+    // from Written(); false if it cannot be had or holds another scan.
+    bool        Create(const char* fileName, uint64_t first, uint64_t last, bool sums);
+
+    // Open a file read-only, mapping it whole, for ClassOf() and SumOf().
+    bool        Open(const char* fileName);
+
+    // Record how far it is written and close it.
+    void        Close(void);
+
+    bool        IsOpen(void) const { return file_.handle != -1; }
+    uint64_t    First(void) const { return first_; }
+    uint64_t    Last(void) const { return last_; }
+    uint64_t    Written(void) const { return written_; }
+    bool        HasSums(void) const { return sumOffset_ != 0; }
+
+    // Store the segment of count numbers from low, which must be
+    // First() + Written(), from their sigmas; false if the store fails.
+    bool        Store(uint64_t low, size_t count, const uint64_t* sigmas);
+
+    // What a file opened by Open() says of n in [First(), Last()].
+    RangeClass  ClassOf(uint64_t value) const;
+    uint64_t    SumOf(uint64_t value) const;
+
+private:
+    bool        ReadHeader(void);
+    void        WriteHeader(void);
+
+    mapped_file     file_;
+    mapped_view     header_;                    // the header page while writing, the whole file while reading
+    uint64_t        first_;
+    uint64_t        last_;
+    uint64_t        written_;
+    unsigned        sumBytes_;
+    uint64_t        sumOffset_;
+};
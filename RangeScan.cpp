@@ -0,0 +1,346 @@
+/*
+    RangeScan.cpp -- The range scan and its divisor-sum sieve (the
+    PerfectSweep library).
+*/
+#include "RangeScan.h"
+#include "PrimeSieve.h"
+#include "Scratch.h"
+#include "ThreadPool.h"
+
+#include <math.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+
+const uint64_t  cAmicablePrimes = 0x00010000;   // primes tried before sigma() takes over
+
+// One divisor past cRangeBlock, waiting for the block of its next
+// multiple.  Below cMaxRangeValue both fit 32 bits.
+struct Stride
+{
+    uint32_t        cofactor;                   // k of the next multiple k * d
+    uint32_t        divisor;                    // d <= k
+};
+
+// What a worker hands back for one segment.
+struct RangeSegment
+{
+    uint64_t        low;
+    uint64_t        high;
+    std::vector<uint64_t> sigmas;
+    RangeCounts     counts;
+    std::vector<std::pair<uint64_t, uint64_t> > found;
+};
+
+static inline bool Stopped(const RangeOptions& options);
+static uint64_t SegmentLength(const RangeOptions& options);
+static void     ScanSegment(const RangeOptions& options, RangeSegment& segment);
+static bool     SigmaIs(uint64_t value, uint64_t target);
+static bool     Reachable(uint64_t rest, uint64_t left, uint64_t prime);
+static void     Report(RangeListener& listener, const RangeSegment& segment);
+
+
+bool ScanRange(const RangeOptions& options, RangeListener& listener)
+{
+    uint64_t    first = options.first < 1 ? 1 : options.first;
+    uint64_t    last = options.last < cMaxRangeValue ? options.last : cMaxRangeValue - 1;
+    uint64_t    length = SegmentLength(options);
+    unsigned    width = options.numThreads ? options.numThreads : 1;
+
+    std::unique_ptr<WorkStealingPool>   pool;
+    std::vector<RangeSegment>           round(width);
+
+    if (options.numThreads)
+        pool.reset(new WorkStealingPool(options.numThreads, options.places));
+
+    for (uint64_t low = options.resume > first ? options.resume : first; low <= last; )
+    {
+        unsigned    count = 0;
+
+        // one segment per thread; the last one may be short
+        for (; count < width && low <= last; count++)
+        {
+            round[count].low = low;
+            round[count].high = (last - low >= length) ? low + length : last + 1;
+            low = round[count].high;
+        }
+
+        if (!pool)
+        {
+            if (Stopped(options) || listener.Poll())
+                return false;
+            ScanSegment(options, round[0]);
+        }
+        else
+        {
+            bool    cancel = false;
+
+            for (unsigned index = 0; index < count; index++)
+                pool->Submit([&options, &round, index] { ScanSegment(options, round[index]); });
+            while (!pool->WaitFor(100))
+                if (!cancel && (Stopped(options) || listener.Poll()))
+                    cancel = true;
+            if (cancel || Stopped(options))
+                return false;
+        }
+
+        for (unsigned index = 0; index < count; index++)
+            Report(listener, round[index]);
+    }
+
+    return true;
+}
+
+
+static inline bool Stopped(const RangeOptions& options)
+{
+    return options.stop != nullptr && options.stop->load(std::memory_order_relaxed);
+}
+
+
+/*
+    Finding where each divisor starts costs a division, once a segment, so
+    a segment is at least four times as long as there are divisors.
+*/
+static uint64_t SegmentLength(const RangeOptions& options)
+{
+    uint64_t    length = 4 * isqrt<uint64_t>(options.last < cMaxRangeValue ? options.last : cMaxRangeValue - 1);
+
+    if (length < cRangeSegment)
+        length = cRangeSegment;
+
+    return (length + cRangeBlock - 1) / cRangeBlock * cRangeBlock;
+}
+
+
+/*
+    The divisors up to cRangeBlock have a multiple in every block, so they
+    keep their next multiple and cofactor in two arrays walked in order,
+    block after block.  The larger ones land in a block at most once: each
+    waits in the bucket of the block of its next multiple, and the buckets
+    are a ring as long as the largest divisor is blocks, so they are
+    reused rather than regrown.  The square d * d adds d once.
+
+    The arrays are the thread's scratch and the ring is the thread's own,
+    kept from segment to segment, so after the first segment a thread
+    sieves without allocating.
+*/
+void sieve_sigmas(uint64_t low, uint64_t high, uint64_t* sigmas)
+{
+    static thread_local std::vector<std::vector<Stride> > Ring;
+
+    size_t      length = (size_t)(high - low);
+    size_t      blocks = (size_t)((length + cRangeBlock - 1) / cRangeBlock);
+    uint64_t    top = isqrt<uint64_t>(high - 1);
+    uint64_t    small = (top < cRangeBlock) ? top : cRangeBlock;
+    size_t      ring = (size_t)(top / cRangeBlock + 2);
+    size_t      spokes = ring < blocks ? ring : blocks;
+    ScratchScope    scope;
+    uint64_t*   multiples = scope.Arena().Take<uint64_t>((size_t)small + 1);
+    uint64_t*   cofactors = scope.Arena().Take<uint64_t>((size_t)small + 1);
+    std::vector<Stride>*    buckets;
+
+    // grown only, so every bucket keeps what it has reserved
+    if (Ring.size() < spokes)
+        Ring.resize(spokes);
+    buckets = Ring.data();
+    for (size_t index = 0; index < spokes; index++)
+        buckets[index].clear();
+
+    std::fill(sigmas, sigmas + length, 0);
+
+    for (uint64_t divisor = 1; divisor <= top; divisor++)
+    {
+        uint64_t    cofactor = (low + divisor - 1) / divisor;
+        Stride      stride;
+
+        if (cofactor < divisor)
+            cofactor = divisor;
+        if (divisor <= small)
+        {
+            multiples[divisor] = cofactor * divisor;
+            cofactors[divisor] = cofactor;
+            continue;
+        }
+        if (cofactor * divisor >= high)
+            continue;
+
+        stride.cofactor = (uint32_t)cofactor;
+        stride.divisor = (uint32_t)divisor;
+        buckets[(size_t)((cofactor * divisor - low) / cRangeBlock) % spokes].push_back(stride);
+    }
+
+    for (size_t block = 0; block < blocks; block++)
+    {
+        uint64_t    end = (block + 1 < blocks) ? low + (block + 1) * cRangeBlock : high;
+        std::vector<Stride>&    bucket = buckets[block % spokes];
+
+        for (uint64_t divisor = 1; divisor <= small; divisor++)
+        {
+            uint64_t    multiple = multiples[divisor], cofactor = cofactors[divisor];
+
+            if (multiple >= end)
+                continue;
+            if (cofactor == divisor)
+            {
+                sigmas[multiple - low] += divisor;
+                multiple += divisor;
+                cofactor++;
+            }
+            for (; multiple < end; multiple += divisor, cofactor++)
+                sigmas[multiple - low] += divisor + cofactor;
+
+            multiples[divisor] = multiple;
+            cofactors[divisor] = cofactor;
+        }
+
+        // a stride moves on at most ring - 1 blocks, never back to this one
+        for (size_t index = 0; index < bucket.size(); index++)
+        {
+            Stride      stride = bucket[index];
+            uint64_t    multiple = (uint64_t)stride.cofactor * stride.divisor;
+
+            sigmas[multiple - low] += (stride.cofactor == stride.divisor) ? stride.divisor
+                                        : (uint64_t)stride.divisor + stride.cofactor;
+            multiple += stride.divisor;
+            stride.cofactor++;
+            if (multiple < high)
+                buckets[(size_t)((multiple - low) / cRangeBlock) % spokes].push_back(stride);
+        }
+        bucket.clear();
+    }
+}
+
+
+/*
+    Sieve one segment and sort its numbers.  The perfects and amicable
+    pairs go into the segment's list, which is in ascending order.
+*/
+static void ScanSegment(const RangeOptions& options, RangeSegment& segment)
+{
+    uint64_t    first = options.first < 1 ? 1 : options.first;
+    size_t      length = (size_t)(segment.high - segment.low);
+
+    segment.counts = RangeCounts();
+    segment.found.clear();
+    if (Stopped(options))
+        return;
+
+    segment.sigmas.resize(length);
+    sieve_sigmas(segment.low, segment.high, segment.sigmas.data());
+
+    for (size_t index = 0; index < length; index++)
+    {
+        uint64_t    value = segment.low + index;
+        uint64_t    sigma = segment.sigmas[index];
+        uint64_t    partner = sigma - value;
+        bool        amicable;
+
+        if (partner == value)
+        {
+            segment.counts.perfect++;
+            segment.found.push_back(std::make_pair(value, (uint64_t)0));
+            continue;
+        }
+        if (partner > value)
+            segment.counts.abundant++;
+        else
+            segment.counts.deficient++;
+
+        // the pair was reported at the partner if that is in the range
+        if (partner <= 1 || (partner < value && partner >= first))
+            continue;
+
+        if (partner >= segment.low && partner < segment.high)
+            amicable = segment.sigmas[(size_t)(partner - segment.low)] == sigma;
+        else
+            amicable = SigmaIs(partner, sigma);
+
+        if (amicable)
+        {
+            segment.counts.amicable++;
+            segment.found.push_back(std::make_pair(value, partner));
+        }
+    }
+}
+
+
+/*
+    sigma(value) == target, without factoring value unless the answer is
+    very nearly yes.  Each sigma(p^e) must divide what is left of the
+    target, and what is left must stay within reach of sigma of what is
+    left of the value; almost every value fails one or the other within
+    its first few primes.
+*/
+static bool SigmaIs(uint64_t value, uint64_t target)
+{
+    size_t          count;
+    const uint32_t* primes = prime_table(cAmicablePrimes, count);
+    uint64_t        rest = value, left = target, term = 1;
+
+    // the 2s by shifting
+    while ((rest & 1) == 0)
+    {
+        rest >>= 1;
+        term = 2 * term + 1;
+    }
+    if (left % term != 0)
+        return false;
+    left /= term;
+
+    for (size_t index = 1; index < count; index++)
+    {
+        uint64_t    prime = primes[index];
+
+        // what is left is 1 or a prime
+        if (prime * prime > rest)
+            return left == ((rest > 1) ? rest + 1 : 1);
+
+        if (rest % prime == 0)
+        {
+            uint64_t    power = 1;
+
+            term = 1;
+            do
+            {
+                rest /= prime;
+                power *= prime;
+                term += power;
+            } while (rest % prime == 0);
+
+            if (left % term != 0)
+                return false;
+            left /= term;
+        }
+
+        if (left <= rest || (index + 1 < count && !Reachable(rest, left, primes[index + 1])))
+            return left == 1 && rest == 1;
+    }
+
+    return sigma<uint64_t>(rest) == left;
+}
+
+
+/*
+    rest has no prime factor below prime, so it has at most k = log_prime
+    (rest) of them, and sigma(p^e) / p^e < p / (p - 1) < e^(1 / (prime -
+    1)) for each: sigma(rest) is below rest * e^y with y = k / (prime - 1).
+    k is overestimated from the bit lengths, and e^y <= 1 + y + y^2 while
+    y <= 1; past that nothing is ruled out.
+*/
+static bool Reachable(uint64_t rest, uint64_t left, uint64_t prime)
+{
+    double  y = (double)(ilogb((double)rest) + 1) / ((double)ilogb((double)prime) * (double)(prime - 1));
+
+    return y > 1 || (double)left <= (double)rest * (1 + y + y * y) * 1.000001 + 1;
+}
+
+
+static void Report(RangeListener& listener, const RangeSegment& segment)
+{
+    for (size_t index = 0; index < segment.found.size(); index++)
+        listener.Found(segment.found[index].first, segment.found[index].second);
+
+    listener.Segment(segment.low, (size_t)(segment.high - segment.low), segment.sigmas.data(), segment.counts);
+}
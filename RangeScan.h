@@ -0,0 +1,89 @@
+/*
+    RangeScan.h -- Every perfect, abundant and amicable number in [a, b]
+    (part of the PerfectSweep library).
+
+    LoopForPerfects() only visits 2^x - 2^y.  The range scan takes every n
+    by a segmented divisor-sum sieve instead: for each d up to the root of
+    a segment's top, d and its cofactor k = n / d >= d are added to the
+    sum of each multiple n = k * d in the segment.  That is additions
+    only, about ln sqrt(b) of them per n, where a trial division of n
+    costs sqrt(n) divisions.  The segment is walked cRangeBlock numbers
+    at a time, a block of sums small enough to stay in a core's L2, and
+    every d waits in the bucket of the next block it has a multiple in,
+    so a block only touches the divisors that land in it.
+
+    A segment is one worker's task: a round of the scan hands one segment
+    to every thread, and reports them in order once the round is done.
+
+    n and m = sigma(n) - n are amicable when sigma(m) = sigma(n) too.  m
+    is looked up in the segment when it is there; otherwise sigma(m) is
+    checked against its target prime by prime, and the check gives up as
+    soon as what is left of it cannot be sigma of what is left of m.  A
+    pair is reported at its smaller number, or at n when m is below a.
+*/
+#pragma once
+
+#include "Perfect.h"
+#include "Topology.h"
+
+#include <atomic>
+
+
+const uint64_t  cRangeBlock = 0x00010000;       // numbers per sieve block: 512 KB of sums
+const uint64_t  cRangeSegment = 0x00400000;     // numbers per segment, at least
+const uint64_t  cMaxRangeValue = (uint64_t)1 << 47; // b must be below this
+
+
+// Numbers of each kind; an amicable number is also abundant or deficient.
+struct RangeCounts
+{
+    uint64_t        perfect;
+    uint64_t        abundant;
+    uint64_t        deficient;
+    uint64_t        amicable;                   // pairs, counted at the number they are reported at
+
+    RangeCounts() : perfect(0), abundant(0), deficient(0), amicable(0) {}
+};
+
+
+struct RangeOptions
+{
+    uint64_t        first;                      // a, at least 1
+    uint64_t        last;                       // b, below cMaxRangeValue
+    uint64_t        resume;                     // the first n to sieve, past a when a scan carries on; 0 for a
+    unsigned        numThreads;                 // worker threads; 0 scans on the calling thread
+    const std::atomic<bool>* stop;              // set from any thread to stop the scan; may be null
+    const std::vector<ThreadPlace>* places;     // where the workers run (Topology.h); null for anywhere
+
+    RangeOptions() : first(1), last(0), resume(0), numThreads(0), stop(nullptr), places(nullptr) {}
+};
+
+
+class RangeListener
+{
+public:
+    virtual ~RangeListener() {}
+
+    // Every perfect number (partner 0) and every amicable pair, in
+    // ascending order of value, on the scanning thread.
+    virtual void    Found(uint64_t value, uint64_t partner) = 0;
+
+    // Each segment in ascending order, after its Found() calls: sigma(n)
+    // for n = first .. first + count - 1, and the segment's counts.
+    virtual void    Segment(uint64_t first, size_t count, const uint64_t* sigmas, const RangeCounts& counts) = 0;
+
+    // Asked between segments, and every tenth of a second during a
+    // parallel round; returning true stops the scan.
+    virtual bool    Poll(void) = 0;
+};
+
+
+// Scan [options.first, options.last], from options.resume if that is
+// past first; returns false if it was stopped, with every segment
+// before the stop reported.  A pair is still reported at its smaller
+// number when that is at least first, even if it is before resume.
+bool        ScanRange(const RangeOptions& options, RangeListener& listener);
+
+// sigma(n) for every n in [low, high) into sigmas, by the segmented
+// sieve; high - low <= 2^32, high <= cMaxRangeValue.
+void        sieve_sigmas(uint64_t low, uint64_t high, uint64_t* sigmas);
@@ -0,0 +1,361 @@
+/*
+    Reciprocal.cpp -- Invariant-divisor reciprocals (part of PerfectLib).
+*/
+#include "Reciprocal.h"
+#include "NodeLocal.h"
+#include "Wheel.h"
+
+#include <atomic>
+#include <mutex>
+
+
+static uint64_t         Magic32[cReciprocal32Limit];    // read-only once built
+static std::once_flag   Magic32Built;
+
+static uint64_t*        Table64;                        // allocated whole, filled in order
+static std::atomic<uint64_t> Present64(0);              // entries 0..Present64-1 are valid
+static std::mutex       Grow64Lock;
+static NodeReplicas<uint64_t> Copies32, Copies64;       // for the workers of other nodes
+
+static void     BuildMagic32(void);
+static uint64_t DivideWide(uint64_t high, uint64_t divisor, uint64_t& remainder);
+static inline bool AddPair(uint32_t value, uint32_t index, uint32_t factor, uint32_t& sum);
+static inline bool AddPair(uint64_t value, uint64_t index, uint64_t factor, uint64_t& sum);
+
+
+static void BuildMagic32(void)
+{
+    Magic32[0] = Magic32[1] = 0;        // never used: the loop starts at 2
+    for (uint32_t index = 2; index < cReciprocal32Limit; index++)
+        Magic32[index] = UINT64_MAX / index + 1;
+}
+
+
+const uint64_t* reciprocals32(void)
+{
+    std::call_once(Magic32Built, BuildMagic32);
+    return Copies32.Local(Magic32, cReciprocal32Limit, cReciprocal32Limit);
+}
+
+
+const uint64_t* reciprocals64(uint64_t limit, uint64_t& present)
+{
+    uint64_t    have = Present64.load(std::memory_order_acquire);
+
+    if (limit >= cReciprocal64Limit)
+        limit = cReciprocal64Limit - 1;
+
+    if (have <= limit)
+    {
+        std::lock_guard<std::mutex> guard(Grow64Lock);
+
+        // fill in past what is there; readers only look below Present64
+        have = Present64.load(std::memory_order_relaxed);
+        if (Table64 == nullptr)
+        {
+            Table64 = new uint64_t[cReciprocal64Limit];
+            Table64[0] = Table64[1] = 0;    // never used: the loop starts at 2
+            have = 2;
+        }
+        for (uint64_t index = have; index <= limit; index++)
+            Table64[index] = make_magic64(index);
+        if (have <= limit)
+            Present64.store(have = limit + 1, std::memory_order_release);
+    }
+
+    present = have - 1;
+    return Copies64.Local(Table64, (size_t)have, cReciprocal64Limit);
+}
+
+
+/*
+    floor(high * 2^64 / divisor) for high < divisor, with the remainder.
+*/
+static uint64_t DivideWide(uint64_t high, uint64_t divisor, uint64_t& remainder)
+{
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128   numerator = (unsigned __int128)high << 64;
+
+    remainder = (uint64_t)(numerator % divisor);
+    return (uint64_t)(numerator / divisor);
+#else
+    // shift-and-subtract long division; only ever run to build the table
+    uint64_t    quotient = 0;
+
+    for (int bit = 0; bit < 64; bit++)
+    {
+        bool    carry = (high >> 63) != 0;
+
+        high <<= 1;
+        quotient <<= 1;
+        if (carry || high >= divisor)
+        {
+            high -= divisor;
+            quotient |= 1;
+        }
+    }
+
+    remainder = high;
+    return quotient;
+#endif
+}
+
+
+uint32_t reciprocal_shift64(uint64_t divisor)
+{
+    uint32_t    log2 = 0;
+
+    while ((divisor >> log2) > 1)
+        log2++;
+
+    return ((divisor & (divisor - 1)) == 0) ? log2 - 1 : log2;
+}
+
+
+/*
+    The 65-bit magic floor(2^(64 + log2) / d) * 2 + 1, less its top bit,
+    which the add-and-halve step of reciprocal_divide() puts back.  A
+    power of two needs no magic at all: a zero magic leaves just shifts.
+*/
+uint64_t make_magic64(uint64_t divisor)
+{
+    uint32_t    log2 = 0;
+    uint64_t    proposed, remainder, twice;
+
+    if ((divisor & (divisor - 1)) == 0)
+        return 0;
+
+    while ((divisor >> log2) > 1)
+        log2++;
+
+    proposed = DivideWide((uint64_t)1 << log2, divisor, remainder);
+    twice = remainder + remainder;
+    proposed += proposed;
+    if (twice >= divisor || twice < remainder)
+        proposed++;
+
+    return proposed + 1;
+}
+
+
+/*
+    The checked additions of divisor_sum_range(), for an index and factor
+    already known to divide value.
+*/
+static inline bool AddPair(uint32_t value, uint32_t index, uint32_t factor, uint32_t& sum)
+{
+    if (index > value - sum)
+        return false;
+    sum += index;
+    if (factor != index)
+    {
+        if (factor > value - sum)
+            return false;
+        sum += factor;
+    }
+
+    return true;
+}
+
+
+static inline bool AddPair(uint64_t value, uint64_t index, uint64_t factor, uint64_t& sum)
+{
+    if (index > value - sum)
+        return false;
+    sum += index;
+    if (factor != index)
+    {
+        if (factor > value - sum)
+            return false;
+        sum += factor;
+    }
+
+    return true;
+}
+
+
+template <>
+bool divisor_sum_range_reciprocal<uint32_t>(uint32_t value, uint32_t first, uint32_t last, uint32_t& sum)
+{
+    const uint64_t* magic = reciprocals32();
+    uint32_t        top = (last < cReciprocal32Limit) ? last : cReciprocal32Limit - 1;
+    uint32_t        index;
+
+    if (first < 2)
+        return divisor_sum_range<uint32_t>(value, first, last, sum);
+
+    // M * n (mod 2^64) below M means no remainder; the quotient is mulhi
+    for (index = first; index <= top; index++)
+        if (magic[index] * value < magic[index]
+            && !AddPair(value, index, (uint32_t)mul_high64(magic[index], value), sum))
+            return false;
+
+    return index > last || divisor_sum_range<uint32_t>(value, index, last, sum);
+}
+
+
+template <>
+bool divisor_sum_range_reciprocal<uint64_t>(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum)
+{
+    uint64_t            present;
+    const uint64_t*     magic;
+    uint64_t            top, index, factor, boundary;
+    uint32_t            shift;
+
+    if (value <= UINT32_MAX && last < cReciprocal32Limit)
+    {
+        uint32_t    narrowSum = (uint32_t)sum;
+        bool        within = divisor_sum_range_reciprocal<uint32_t>((uint32_t)value, (uint32_t)first, (uint32_t)last, narrowSum);
+
+        sum = narrowSum;
+        return within;
+    }
+
+    if (first < 2)
+        return divisor_sum_range<uint64_t>(value, first, last, sum);
+
+    magic = reciprocals64(last, present);
+    top = (last < present) ? last : present;
+
+    // the shift is ceil(log2 d) - 1: it steps up just past each power of two
+    shift = reciprocal_shift64(first);
+    boundary = (uint64_t)2 << shift;
+
+    for (index = first; index <= top; index++)
+    {
+        if (index > boundary)
+        {
+            shift++;
+            boundary <<= 1;
+        }
+
+        factor = reciprocal_divide(value, magic[index], shift);
+        if (factor * index == value && !AddPair(value, index, factor, sum))
+            return false;
+    }
+
+    return index > last || divisor_sum_range<uint64_t>(value, index, last, sum);
+}
+
+
+/*
+    The same loops over the spokes of a wheel.  A spoke can step past
+    more than one power of two only while the spokes are still below the
+    modulus, so the shift catches up in a loop.
+*/
+template <>
+bool divisor_sum_range_reciprocal<uint32_t>(uint32_t value, uint32_t first, uint32_t last, uint32_t& sum,
+    const DivisorWheel& wheel)
+{
+    const uint64_t* magic = reciprocals32();
+    uint32_t        top = (last < cReciprocal32Limit) ? last : cReciprocal32Limit - 1;
+    uint32_t        index;
+
+    if (first < 2)
+        first = 2;
+
+    WheelCursor<uint32_t>   spoke(wheel, first);
+
+    for (; (index = *spoke) <= top; ++spoke)
+        if (magic[index] * value < magic[index]
+            && !AddPair(value, index, (uint32_t)mul_high64(magic[index], value), sum))
+            return false;
+
+    return index > last || divisor_sum_range<uint32_t>(value, index, last, sum, wheel);
+}
+
+
+template <>
+bool divisor_sum_range_reciprocal<uint64_t>(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum,
+    const DivisorWheel& wheel)
+{
+    uint64_t            present;
+    const uint64_t*     magic;
+    uint64_t            top, index, factor, boundary;
+    uint32_t            shift;
+
+    if (value <= UINT32_MAX && last < cReciprocal32Limit)
+    {
+        uint32_t    narrowSum = (uint32_t)sum;
+        bool        within = divisor_sum_range_reciprocal<uint32_t>((uint32_t)value, (uint32_t)first, (uint32_t)last,
+                        narrowSum, wheel);
+
+        sum = narrowSum;
+        return within;
+    }
+
+    if (first < 2)
+        first = 2;
+
+    magic = reciprocals64(last, present);
+    top = (last < present) ? last : present;
+
+    WheelCursor<uint64_t>   spoke(wheel, first);
+
+    shift = reciprocal_shift64(*spoke);
+    boundary = (uint64_t)2 << shift;
+
+    for (; (index = *spoke) <= top; ++spoke)
+    {
+        while (index > boundary)
+        {
+            shift++;
+            boundary <<= 1;
+        }
+
+        factor = reciprocal_divide(value, magic[index], shift);
+        if (factor * index == value && !AddPair(value, index, factor, sum))
+            return false;
+    }
+
+    return index > last || divisor_sum_range<uint64_t>(value, index, last, sum, wheel);
+}
+
+
+#if defined(__SIZEOF_INT128__)
+template <>
+bool divisor_sum_range_reciprocal<uint128_t>(uint128_t value, uint128_t first, uint128_t last, uint128_t& sum)
+{
+    uint64_t    narrowSum = (uint64_t)sum;
+    bool        within;
+
+    // the reciprocals work on 64-bit values; anything wider divides
+    if (value > UINT64_MAX)
+        return divisor_sum_range<uint128_t>(value, first, last, sum);
+
+    within = divisor_sum_range_reciprocal<uint64_t>((uint64_t)value, (uint64_t)first, (uint64_t)last, narrowSum);
+    sum = narrowSum;
+    return within;
+}
+
+
+template <>
+bool divisor_sum_range_reciprocal<uint128_t>(uint128_t value, uint128_t first, uint128_t last, uint128_t& sum,
+    const DivisorWheel& wheel)
+{
+    uint64_t    narrowSum = (uint64_t)sum;
+    bool        within;
+
+    if (value > UINT64_MAX)
+        return divisor_sum_range<uint128_t>(value, first, last, sum, wheel);
+
+    within = divisor_sum_range_reciprocal<uint64_t>((uint64_t)value, (uint64_t)first, (uint64_t)last, narrowSum, wheel);
+    sum = narrowSum;
+    return within;
+}
+#endif
+
+
+template <typename T>
+bool is_perfect_reciprocal(T value)
+{
+    return trial_verdict<T>(value, cEngineReciprocal) == cVerdictPerfect;
+}
+
+
+// the instantiations PerfectLib provides
+template bool   is_perfect_reciprocal<uint32_t>(uint32_t);
+template bool   is_perfect_reciprocal<uint64_t>(uint64_t);
+#if defined(__SIZEOF_INT128__)
+template bool   is_perfect_reciprocal<uint128_t>(uint128_t);
+#endif
@@ -0,0 +1,72 @@
+/*
+    Reciprocal.h -- Invariant-divisor reciprocals (part of PerfectLib).
+
+    The trial-division loop divides a fixed value by every divisor 2, 3,
+    4, ...; across candidates those same divisors come up over and over.
+    Each divisor's reciprocal is worked out once into a shared table, and
+    from then on a % or / by it is a multiply and a shift:
+
+    - Divisors below 2^16 of 32-bit values use the Lemire-Kaser-Kurz
+      magic M = floor((2^64 - 1) / d) + 1: n / d is the high word of
+      M * n, and d divides n exactly when the low word is below M.
+    - Divisors of 64-bit values use the Granlund-Montgomery magic in the
+      form libdivide calls "u64 branchfree": with q = mulhi(magic, n),
+      n / d = (((n - q) >> 1) + q) >> shift.  The shift is floor(log2 d),
+      less one for a power of two, so the loop tracks it as it counts and
+      the table holds nothing but the 64-bit magic.
+
+    The tables only ever grow, and an entry never changes once it is
+    published, so any number of threads read them without locking.
+*/
+#pragma once
+
+#include "Perfect.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+
+const uint32_t  cReciprocal32Limit = 0x00010000;    // 32-bit table covers every 16-bit divisor
+const uint64_t  cReciprocal64Limit = 0x00200000;    // 64-bit table grows up to here
+
+
+// The magic of d for 32-bit values, d < cReciprocal32Limit.
+const uint64_t* reciprocals32(void);
+
+// The 64-bit magics, with every d <= limit filled in (limit is clamped to
+// cReciprocal64Limit - 1).  Returns the highest d present.
+const uint64_t* reciprocals64(uint64_t limit, uint64_t& present);
+
+// One 64-bit magic, for divisors past the table; d >= 2.
+uint64_t    make_magic64(uint64_t divisor);
+
+// The shift that goes with the magic of d; d >= 2.
+uint32_t    reciprocal_shift64(uint64_t divisor);
+
+
+// High 64 bits of the 128-bit product a * b.
+inline uint64_t mul_high64(uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+    return (uint64_t)(((unsigned __int128)a * b) >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    return __umulh(a, b);
+#else
+    uint64_t    aLo = a & 0xFFFFFFFF, aHi = a >> 32;
+    uint64_t    bLo = b & 0xFFFFFFFF, bHi = b >> 32;
+    uint64_t    cross = aLo * bHi + ((aLo * bLo) >> 32);
+    uint64_t    carry = (cross & 0xFFFFFFFF) + aHi * bLo;
+
+    return aHi * bHi + (cross >> 32) + (carry >> 32);
+#endif
+}
+
+
+// n / d by the magic and shift of d.
+inline uint64_t reciprocal_divide(uint64_t value, uint64_t magic, uint32_t shift)
+{
+    uint64_t    quotient = mul_high64(magic, value);
+
+    return (((value - quotient) >> 1) + quotient) >> shift;
+}
@@ -0,0 +1,166 @@
+/*
+    ResultSink.cpp -- The streamed results file and its writer thread.
+*/
+#include "ResultSink.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+
+
+ResultSink::ResultSink() : fd_(nullptr), closing_(false), dropped_(0)
+{
+}
+
+
+ResultSink::~ResultSink()
+{
+    Close();
+}
+
+
+bool ResultSink::Open(const char* fileName, const ResultOptions& options)
+{
+    Close();
+    if ((fd_ = open_file(fileName, "ab")) == nullptr)
+        return false;
+
+    options_ = options;
+    closing_ = false;
+
+    // "ab" starts at the end, so an empty file is one of our own making
+    fseek(fd_, 0, SEEK_END);
+    if (options_.format == cFormatCsv && ftell(fd_) == 0)
+        fputs("time,hi,lo,value,verdict\n", fd_);
+
+    writer_ = std::thread(&ResultSink::WriterLoop, this);
+    return true;
+}
+
+
+void ResultSink::Close(void)
+{
+    if (fd_ == nullptr)
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+
+        closing_ = true;
+    }
+    wake_.notify_one();
+    writer_.join();
+
+    if (options_.syncSeconds >= 0)
+        flush_file(fd_);
+    fclose(fd_);
+    fd_ = nullptr;
+}
+
+
+void ResultSink::Record(unsigned hiPower, unsigned loPower, PerfectValue value, PerfectVerdict verdict)
+{
+    Result      result;
+    bool        full;
+
+    if (fd_ == nullptr || (verdict != cVerdictPerfect && !options_.allVerdicts))
+        return;
+
+    result.time = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    result.hiPower = hiPower;
+    result.loPower = loPower;
+    result.value = value;
+    result.verdict = verdict;
+
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+
+        if (closing_)
+            return;
+        if (pending_.size() >= cMaxPending && verdict != cVerdictPerfect)
+        {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        pending_.push_back(result);
+        full = (pending_.size() == cBatchRecords);
+    }
+
+    if (full)
+        wake_.notify_one();
+}
+
+
+ResultFormat ResultSink::FormatOf(const char* fileName)
+{
+    size_t      length = strlen(fileName);
+
+    if (length >= 4 && fileName[length - 4] == '.' && tolower(fileName[length - 3]) == 'c'
+        && tolower(fileName[length - 2]) == 's' && tolower(fileName[length - 1]) == 'v')
+        return cFormatCsv;
+
+    return cFormatJsonLines;
+}
+
+
+/*
+    Swap the batch out under the lock, and format and write it with the
+    lock released, so Record() only ever waits for another Record().
+*/
+void ResultSink::WriterLoop(void)
+{
+    std::vector<Result> batch;
+    std::string         text;
+    double              lastSync = wall_seconds();
+    bool                closing = false;
+
+    while (!closing)
+    {
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+
+            wake_.wait_for(guard, std::chrono::milliseconds(cFlushMillis),
+                [this] { return closing_ || pending_.size() >= cBatchRecords; });
+            batch.swap(pending_);
+            closing = closing_;
+        }
+        if (batch.empty())
+            continue;
+
+        text.clear();
+        for (size_t index = 0; index < batch.size(); index++)
+            Format(batch[index], text);
+        batch.clear();
+
+        fwrite(text.data(), 1, text.size(), fd_);
+        if (options_.syncSeconds == 0
+            || (options_.syncSeconds > 0 && wall_seconds() - lastSync >= options_.syncSeconds))
+        {
+            flush_file(fd_);
+            lastSync = wall_seconds();
+        }
+        else
+            fflush(fd_);
+    }
+}
+
+
+// One record as a line of the file's format.  Values are strings in the
+// JSON: 128 bits is past what a JSON number can carry.
+void ResultSink::Format(const Result& result, std::string& text) const
+{
+    char        line[160];
+    std::string value = (result.hiPower <= cMaxPower) ? format_value(result.value) : std::string();
+
+    if (options_.format == cFormatCsv)
+        snprintf(line, sizeof(line), "%.3f,%u,%u,%s,%s\n", result.time, result.hiPower, result.loPower,
+            value.c_str(), verdict_name(result.verdict));
+    else if (value.empty())
+        snprintf(line, sizeof(line), "{\"time\": %.3f, \"hi\": %u, \"lo\": %u, \"value\": null, \"verdict\": \"%s\"}\n",
+            result.time, result.hiPower, result.loPower, verdict_name(result.verdict));
+    else
+        snprintf(line, sizeof(line), "{\"time\": %.3f, \"hi\": %u, \"lo\": %u, \"value\": \"%s\", \"verdict\": \"%s\"}\n",
+            result.time, result.hiPower, result.loPower, value.c_str(), verdict_name(result.verdict));
+    text += line;
+}
@@ -0,0 +1,97 @@
+/*
+    ResultSink.h -- Every perfect found, and if asked every other verdict,
+    streamed to a JSON-lines or CSV file that other tools can tail.
+
+    Record() only appends to a pending batch under a lock held for that
+    push, so the sweep's workers never wait on the disk.  A writer thread
+    of its own swaps the batch out, formats it and writes it, every
+    cFlushMillis or sooner once cBatchRecords are waiting.  If the disk
+    falls so far behind that cMaxPending records are waiting, the other
+    verdicts are dropped and counted; a perfect never is.
+
+    The file is appended to, so a resumed run carries on the same one;
+    a CSV file gets its header only when it is new.
+*/
+#pragma once
+
+#include "Perfect.h"
+#include "Platform.h"
+
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+const ULONG     cFlushMillis = 200;             // the writer writes at least this often
+const size_t    cBatchRecords = 4096;           // ...or as soon as this many are waiting
+const size_t    cMaxPending = 0x00100000;       // past this, only perfects are kept
+
+
+enum ResultFormat
+{
+    cFormatJsonLines,                           // one JSON object per line
+    cFormatCsv                                  // a header line, then comma-separated fields
+};
+
+
+struct ResultOptions
+{
+    ResultFormat    format;
+    bool            allVerdicts;                // every candidate, not just the perfects
+    int             syncSeconds;                // force to disk: -1 never, 0 every write, else at most this often
+
+    ResultOptions() : format(cFormatJsonLines), allVerdicts(false), syncSeconds(-1) {}
+};
+
+
+class ResultSink
+{
+public:
+    ResultSink();
+    ~ResultSink();
+
+    // Open (or append to) the file and start the writer; false if it
+    // cannot be opened.
+    bool        Open(const char* fileName, const ResultOptions& options);
+
+    // Write what is waiting, force it to disk unless the policy is never,
+    // and stop the writer.
+    void        Close(void);
+
+    bool        IsOpen(void) const { return fd_ != nullptr; }
+
+    // Queue one settled candidate; value is 0 past cMaxPower.  Safe from
+    // any thread; never waits on the writer.
+    void        Record(unsigned hiPower, unsigned loPower, PerfectValue value, PerfectVerdict verdict);
+
+    // Records dropped because the writer fell behind.
+    ULONGLONG   Dropped(void) const { return dropped_.load(std::memory_order_relaxed); }
+
+    // The format a file name asks for: CSV for .csv, JSON lines otherwise.
+    static ResultFormat FormatOf(const char* fileName);
+
+private:
+    struct Result
+    {
+        double          time;                   // seconds since 1970
+        unsigned        hiPower;
+        unsigned        loPower;
+        PerfectValue    value;
+        PerfectVerdict  verdict;
+    };
+
+    void        WriterLoop(void);
+    void        Format(const Result& result, std::string& text) const;
+
+    ResultOptions           options_;
+    FILE*                   fd_;
+    std::thread             writer_;
+    std::mutex              lock_;              // guards pending_ and closing_
+    std::condition_variable wake_;
+    std::vector<Result>     pending_;
+    bool                    closing_;
+    std::atomic<ULONGLONG>  dropped_;
+};
@@ -0,0 +1,122 @@
+/*
+    Scratch.cpp -- The per-thread arenas and the limb pool.
+*/
+#include "Scratch.h"
+
+
+ScratchArena::ScratchArena()
+    : block_(0), used_(0), grown_(0)
+{
+}
+
+
+ScratchArena::~ScratchArena()
+{
+    for (size_t index = 0; index < blocks_.size(); index++)
+        delete[] blocks_[index].memory;
+}
+
+
+/*
+    The blocks past the one being carved are free, so the first of them
+    with room is carved next; only when none has room is a block added,
+    twice the size of the last, or the request if that is larger.
+*/
+void* ScratchArena::TakeBytes(size_t bytes)
+{
+    Block       block;
+
+    bytes = (bytes + cScratchAlign - 1) / cScratchAlign * cScratchAlign;
+    for (; block_ < blocks_.size(); block_++, used_ = 0)
+    {
+        if (blocks_[block_].size - used_ >= bytes)
+        {
+            void*   data = blocks_[block_].data + used_;
+
+            used_ += bytes;
+            return data;
+        }
+    }
+
+    block.size = blocks_.empty() ? cScratchBlock : 2 * blocks_.back().size;
+    if (block.size < bytes)
+        block.size = bytes;
+    block.memory = new unsigned char[block.size + cScratchAlign];
+    block.data = block.memory + (cScratchAlign - (uintptr_t)block.memory % cScratchAlign) % cScratchAlign;
+    blocks_.push_back(block);
+    grown_++;
+
+    block_ = blocks_.size() - 1;
+    used_ = bytes;
+    return block.data;
+}
+
+
+ScratchArena& thread_scratch(void)
+{
+    static thread_local ScratchArena    arena;
+
+    return arena;
+}
+
+
+LimbPool::~LimbPool()
+{
+    for (unsigned size = 0; size < cLimbClasses; size++)
+        for (size_t index = 0; index < free_[size].size(); index++)
+            delete[] free_[size][index];
+}
+
+
+uint64_t* LimbPool::Take(size_t count, size_t& capacity)
+{
+    unsigned    size = 0;
+
+    while (size + 1 < cLimbClasses && ((size_t)64 << size) < count)
+        size++;
+    capacity = (size_t)64 << size;
+
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+
+        if (!free_[size].empty())
+        {
+            uint64_t*   limbs = free_[size].back();
+
+            free_[size].pop_back();
+            return limbs;
+        }
+        grown_++;
+    }
+
+    return new uint64_t[capacity];
+}
+
+
+void LimbPool::Give(uint64_t* limbs, size_t capacity)
+{
+    unsigned    size = 0;
+
+    while (size + 1 < cLimbClasses && ((size_t)64 << size) < capacity)
+        size++;
+
+    std::lock_guard<std::mutex> guard(lock_);
+
+    free_[size].push_back(limbs);
+}
+
+
+uint64_t LimbPool::Grown(void)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    return grown_;
+}
+
+
+LimbPool& limb_pool(void)
+{
+    static LimbPool     pool;
+
+    return pool;
+}
@@ -0,0 +1,120 @@
+/*
+    Scratch.h -- Per-thread scratch memory and pooled limbs (part of
+    PerfectLib).
+
+    An engine needs buffers for a candidate, the primes of a sieve
+    segment, the values and verdicts of a batch, and is done with them
+    by the next.  Each thread has a ScratchArena of its own: blocks it
+    carves in order and rewinds, a ScratchScope at a time, so once the
+    first candidates have grown it to its high-water mark a candidate
+    costs no malloc at all.  The thread that first takes a block is the
+    one that writes it first, so under the first-touch policy (Linux and
+    Windows both) its pages come from that thread's own NUMA node.
+
+    The big residues of lucas_lehmer() want one block of limbs per
+    exponent, of a size that only grows.  Those come from a LimbPool: a
+    free list per power-of-two size, shared by every thread, so the
+    next exponent takes back the block the last one handed in.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+#include <vector>
+
+
+const size_t    cScratchAlign = 64;             // every Take() starts on a cache line
+const size_t    cScratchBlock = 0x00040000;     // bytes in a thread's first block
+const unsigned  cLimbClasses = 48;              // LimbPool sizes: 2^6 .. 2^53 limbs
+
+
+// A point to rewind a ScratchArena to.
+struct ScratchMark
+{
+    size_t          block;
+    size_t          used;
+};
+
+
+class ScratchArena
+{
+public:
+    ScratchArena();
+    ~ScratchArena();
+
+    // count uninitialized T, aligned to cScratchAlign; good until the
+    // arena is rewound past them
+    template <typename T>
+    T*          Take(size_t count) { return (T*)TakeBytes(count * sizeof(T)); }
+
+    ScratchMark Mark(void) const { ScratchMark mark = { block_, used_ }; return mark; }
+    void        Release(const ScratchMark& mark) { block_ = mark.block; used_ = mark.used; }
+
+    // Blocks malloc'd so far; flat once the arena has its high-water mark.
+    uint64_t    Grown(void) const { return grown_; }
+
+private:
+    struct Block
+    {
+        unsigned char*  memory;                 // as new[] gave it
+        unsigned char*  data;                   // memory on a cache line
+        size_t          size;                   // bytes from data
+    };
+
+    void*       TakeBytes(size_t bytes);
+
+    std::vector<Block>  blocks_;
+    size_t      block_;                         // the block being carved
+    size_t      used_;                          // bytes of it taken
+    uint64_t    grown_;
+
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+};
+
+
+// The calling thread's arena, made (empty) on its first call.
+ScratchArena&   thread_scratch(void);
+
+
+// Rewinds the thread's arena to where it was when the scope opened.
+class ScratchScope
+{
+public:
+    ScratchScope() : arena_(thread_scratch()), mark_(arena_.Mark()) {}
+    ~ScratchScope() { arena_.Release(mark_); }
+
+    ScratchArena&   Arena(void) { return arena_; }
+
+private:
+    ScratchArena&   arena_;
+    ScratchMark     mark_;
+
+    ScratchScope(const ScratchScope&) = delete;
+    ScratchScope& operator=(const ScratchScope&) = delete;
+};
+
+
+// Limb blocks by power-of-two size; Take() rounds count up to one.
+class LimbPool
+{
+public:
+    LimbPool() : grown_(0) {}
+    ~LimbPool();
+
+    uint64_t*   Take(size_t count, size_t& capacity);
+    void        Give(uint64_t* limbs, size_t capacity);
+
+    // Blocks malloc'd so far.
+    uint64_t    Grown(void);
+
+private:
+    std::mutex          lock_;
+    std::vector<uint64_t*> free_[cLimbClasses];
+    uint64_t            grown_;
+};
+
+
+// The one pool every residue draws from.
+LimbPool&       limb_pool(void);
@@ -0,0 +1,119 @@
+/*
+    SigmaCache.cpp -- The odd-part progress cache of pair_verdict().
+*/
+#include "SigmaCache.h"
+
+
+SigmaCache::SigmaCache()
+    : lookups_(0), hits_(0)
+{
+}
+
+
+bool SigmaCache::Find(PerfectValue odd, OddProgress& progress)
+{
+    uint64_t    hash = Hash(odd);
+    Shard&      shard = shards_[hash % cCacheShards];
+    unsigned    slot = (unsigned)(hash / cCacheShards);
+
+    lookups_.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    for (unsigned probe = 0; probe < cCacheProbes; probe++)
+    {
+        const OddProgress&  entry = shard.slots[(slot + probe) % cCacheSlots];
+
+        if (entry.odd == odd)
+        {
+            progress = entry;
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        if (entry.odd == 0)
+            break;
+    }
+
+    return false;
+}
+
+
+/*
+    Into the slot odd already has, or the first empty one, or over the
+    probed entry that has the least to lose.
+*/
+void SigmaCache::Store(const OddProgress& progress)
+{
+    uint64_t    hash = Hash(progress.odd);
+    Shard&      shard = shards_[hash % cCacheShards];
+    unsigned    slot = (unsigned)(hash / cCacheShards);
+    OddProgress* victim = nullptr;
+
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    for (unsigned probe = 0; probe < cCacheProbes; probe++)
+    {
+        OddProgress&    entry = shard.slots[(slot + probe) % cCacheSlots];
+
+        if (entry.odd == progress.odd)
+        {
+            if (!entry.complete && (progress.complete || progress.reached > entry.reached))
+                entry = progress;
+            return;
+        }
+        if (entry.odd == 0)
+        {
+            entry = progress;
+            return;
+        }
+        if (victim == nullptr || (!entry.complete && (victim->complete || entry.reached < victim->reached)))
+            victim = &entry;
+    }
+
+    *victim = progress;
+}
+
+
+void SigmaCache::Entries(std::vector<OddProgress>& entries)
+{
+    entries.clear();
+    for (unsigned index = 0; index < cCacheShards; index++)
+    {
+        std::lock_guard<std::mutex> guard(shards_[index].lock);
+
+        for (unsigned slot = 0; slot < cCacheSlots; slot++)
+            if (shards_[index].slots[slot].odd != 0)
+                entries.push_back(shards_[index].slots[slot]);
+    }
+}
+
+
+void SigmaCache::Clear(void)
+{
+    for (unsigned index = 0; index < cCacheShards; index++)
+    {
+        std::lock_guard<std::mutex> guard(shards_[index].lock);
+
+        for (unsigned slot = 0; slot < cCacheSlots; slot++)
+            shards_[index].slots[slot] = OddProgress();
+    }
+    lookups_.store(0, std::memory_order_relaxed);
+    hits_.store(0, std::memory_order_relaxed);
+}
+
+
+/*
+    The odd parts are 2^k - 1, all ones in their low bits, so the bits are
+    mixed (the splitmix64 finalizer) before they pick a slot.
+*/
+uint64_t SigmaCache::Hash(PerfectValue odd)
+{
+    uint64_t    hash = (uint64_t)odd;
+
+#if defined(__SIZEOF_INT128__)
+    hash ^= (uint64_t)(odd >> 64) * 0x9E3779B97F4A7C15ULL;
+#endif
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+    return hash ^ (hash >> 31);
+}
@@ -0,0 +1,77 @@
+/*
+    SigmaCache.h -- How far the divisors of an odd part have been summed
+    (part of PerfectLib).
+
+    Every pair 2^hi - 2^lo of one width hi - lo has the same odd part
+    m = 2^(hi-lo) - 1, and pair_verdict() tries it against a different
+    target for each lo with lo + 1 dividing the width: the same odd
+    divisors, from 3 up, once per row.  The cache keeps, for each m, the
+    sum of its divisor pairs up to the last whole chunk the trial division
+    got through, so the next row picks up where the last one stopped, and
+    a row after the last chunk needs no division at all.
+
+    The cache is the caller's, handed in like the divisor counter, so
+    Perfect.h keeps no state of its own.  It is bounded: cCacheShards of
+    cCacheSlots each, open addressing over cCacheProbes slots, and the
+    entry with the least progress goes when they are full.  Each shard
+    has a lock of its own, held only to copy an entry in or out.
+*/
+#pragma once
+
+#include "Perfect.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+
+const unsigned  cCacheShards = 16;              // locks
+const unsigned  cCacheSlots = 256;              // entries per shard
+const unsigned  cCacheProbes = 8;               // slots an odd value may take
+
+
+// The divisor pairs (d, m / d) of an odd m with 3 <= d <= reached are in
+// sum, with 1 and m; complete when reached is the root of m, and sum is
+// sigma(m).
+struct OddProgress
+{
+    PerfectValue    odd;                        // 0 for an empty slot
+    PerfectValue    sum;
+    uint64_t        reached;
+    bool            complete;
+
+    OddProgress() : odd(0), sum(0), reached(0), complete(false) {}
+};
+
+
+class SigmaCache
+{
+public:
+    SigmaCache();
+
+    // The entry of odd, if there is one.  Counts a lookup, and a hit.
+    bool        Find(PerfectValue odd, OddProgress& progress);
+
+    // Keep progress unless the cache has got further with its odd value.
+    void        Store(const OddProgress& progress);
+
+    // Every entry, to be saved; and the cache emptied.
+    void        Entries(std::vector<OddProgress>& entries);
+    void        Clear(void);
+
+    uint64_t    Lookups(void) const { return lookups_.load(std::memory_order_relaxed); }
+    uint64_t    Hits(void) const { return hits_.load(std::memory_order_relaxed); }
+
+private:
+    struct Shard
+    {
+        std::mutex      lock;
+        OddProgress     slots[cCacheSlots];
+    };
+
+    static uint64_t Hash(PerfectValue odd);
+
+    Shard                   shards_[cCacheShards];
+    std::atomic<uint64_t>   lookups_;
+    std::atomic<uint64_t>   hits_;
+};
@@ -0,0 +1,720 @@
+/*
+    SimdKernel.cpp -- Vectorized divisibility test for the trial-division
+    loop (part of PerfectLib).
+
+    Each lane holds one divisor d as a double, with its reciprocal 1/d.
+    For x below 2^48, q = round(x * (1/d)) is the true quotient or one
+    more, and x - q * d is exact in a double, so after adding d back to a
+    negative remainder we have x mod d with no division at all.  A 64-bit
+    value is reduced Horner-style: its top 32 bits first, then two 16-bit
+    limbs, each step keeping the partial remainder below 2^48.
+
+    The lanes only find the divisors; the (rare) hits are added by the
+    scalar divisor_sum_range(), so the sums and the early exit on an
+    abundant value are exactly those of the scalar path.
+
+    Reciprocals of the divisors below cReciprocals come from a table built
+    once and then only read; above it they are computed a vector at a
+    time.  Every kernel is compiled for its own instruction set and picked
+    at run time from CPUID, so one binary runs on any x86-64.
+
+    On a wheel (Wheel.h) the lanes hold consecutive spokes instead: the
+    turn's base plus the wheel's offsets, loaded as they stand.  Their
+    reciprocals are gathered from the table, or computed past it.
+*/
+#include "Perfect.h"
+#include "Wheel.h"
+
+#include <mutex>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PERFECT_SIMD_X86    1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define PERFECT_SIMD_NEON   1
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang need each kernel marked with its instruction set; MSVC
+// accepts the intrinsics anywhere.
+#if defined(__GNUC__)
+#define PERFECT_TARGET(isa) __attribute__((target(isa)))
+#else
+#define PERFECT_TARGET(isa)
+#endif
+
+
+const uint64_t  cReciprocals = 0x00010000 + 16; // table covers every 16-bit divisor
+const uint64_t  cWideValue = (uint64_t)1 << 48; // values from here are reduced in limbs
+
+static double           Reciprocals[cReciprocals];  // 1/d, read-only once built
+static std::once_flag   ReciprocalsBuilt;
+
+typedef bool    (*SimdRange)(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum);
+typedef bool    (*SimdWheel)(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum, const DivisorWheel& wheel);
+
+static void     BuildReciprocals(void);
+static bool     RangeScalar(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum);
+static bool     WheelScalar(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum, const DivisorWheel& wheel);
+static SimdRange KernelFor(SimdLevel level);
+static SimdWheel WheelKernelFor(SimdLevel level);
+
+
+static void BuildReciprocals(void)
+{
+    Reciprocals[0] = 0.0;
+    for (uint64_t index = 1; index < cReciprocals; index++)
+        Reciprocals[index] = 1.0 / (double)index;
+}
+
+
+/*
+    Add the divisor pairs of the lanes set in hits, from first upwards.
+*/
+static bool AddHits(uint64_t value, uint64_t first, unsigned hits, uint64_t& sum)
+{
+    for (unsigned lane = 0; hits != 0; lane++, hits >>= 1)
+        if ((hits & 1) && !divisor_sum_range<uint64_t>(value, first + lane, first + lane, sum))
+            return false;
+
+    return true;
+}
+
+
+/*
+    The same for lanes on the spokes base + offsets[0], offsets[1], ...
+*/
+static bool AddWheelHits(uint64_t value, uint64_t base, const uint32_t* offsets, unsigned hits, uint64_t& sum)
+{
+    for (unsigned lane = 0; hits != 0; lane++, hits >>= 1)
+        if ((hits & 1) && !divisor_sum_range<uint64_t>(value, base + offsets[lane], base + offsets[lane], sum))
+            return false;
+
+    return true;
+}
+
+
+/*
+    Where the spokes from first on start: the base of first's turn and
+    the spoke within it.
+*/
+static void WheelStart(const DivisorWheel& wheel, uint64_t first, uint64_t& base, uint32_t& spoke)
+{
+    uint64_t    divisor = *WheelCursor<uint64_t>(wheel, first);
+
+    base = divisor - divisor % wheel.modulus;
+    spoke = (uint32_t)(std::lower_bound(wheel.residues, wheel.residues + wheel.spokes, (uint16_t)(divisor - base))
+                - wheel.residues);
+}
+
+
+// Past the lanes just tried: on to the spoke cWheelRun or fewer further.
+static inline void WheelStep(const DivisorWheel& wheel, unsigned lanes, uint64_t& base, uint32_t& spoke)
+{
+    for (spoke += lanes; spoke >= wheel.spokes; spoke -= wheel.spokes)
+        base += wheel.modulus;
+}
+
+
+static bool RangeScalar(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum)
+{
+    return divisor_sum_range<uint64_t>(value, first, last, sum);
+}
+
+
+static bool WheelScalar(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum, const DivisorWheel& wheel)
+{
+    return divisor_sum_range<uint64_t>(value, first, last, sum, wheel);
+}
+
+
+#if defined(PERFECT_SIMD_X86)
+
+/*
+    x mod d for four lanes, given x < 2^48 and r = 1/d.
+*/
+PERFECT_TARGET("avx2")
+static inline __m256d ReduceAvx2(__m256d x, __m256d divisor, __m256d reciprocal)
+{
+    __m256d     quotient = _mm256_round_pd(_mm256_mul_pd(x, reciprocal),
+                    _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+
+    x = _mm256_sub_pd(x, _mm256_mul_pd(quotient, divisor));
+    return _mm256_add_pd(x, _mm256_and_pd(divisor, _mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_LT_OQ)));
+}
+
+
+PERFECT_TARGET("avx2")
+static inline __m256d RemainderAvx2(const __m256d limbs[3], bool wide, __m256d divisor, __m256d reciprocal)
+{
+    const __m256d   cShift = _mm256_set1_pd(65536.0);
+    __m256d         x = ReduceAvx2(limbs[0], divisor, reciprocal);
+
+    if (wide)
+    {
+        x = ReduceAvx2(_mm256_add_pd(_mm256_mul_pd(x, cShift), limbs[1]), divisor, reciprocal);
+        x = ReduceAvx2(_mm256_add_pd(_mm256_mul_pd(x, cShift), limbs[2]), divisor, reciprocal);
+    }
+
+    return x;
+}
+
+
+/*
+    AVX2: two vectors of four divisors per step.
+*/
+PERFECT_TARGET("avx2")
+static bool RangeAvx2(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum)
+{
+    const unsigned  cLanes = 8;
+    const __m256d   cOne = _mm256_set1_pd(1.0);
+    const __m256d   cStep = _mm256_set1_pd((double)cLanes);
+    bool            wide = value >= cWideValue;
+    __m256d         limbs[3];
+    __m256d         divisor0, divisor1;
+    uint64_t        index = first;
+
+    limbs[0] = _mm256_set1_pd((double)(wide ? value >> 32 : value));
+    limbs[1] = _mm256_set1_pd((double)((value >> 16) & 0xFFFF));
+    limbs[2] = _mm256_set1_pd((double)(value & 0xFFFF));
+    divisor0 = _mm256_setr_pd((double)index, (double)(index + 1), (double)(index + 2), (double)(index + 3));
+    divisor1 = _mm256_add_pd(divisor0, _mm256_set1_pd(4.0));
+
+    for (; index <= last && last - index >= cLanes - 1; index += cLanes)
+    {
+        __m256d     reciprocal0, reciprocal1;
+        unsigned    hits;
+
+        if (index + cLanes <= cReciprocals)
+        {
+            reciprocal0 = _mm256_loadu_pd(&Reciprocals[index]);
+            reciprocal1 = _mm256_loadu_pd(&Reciprocals[index + 4]);
+        }
+        else
+        {
+            reciprocal0 = _mm256_div_pd(cOne, divisor0);
+            reciprocal1 = _mm256_div_pd(cOne, divisor1);
+        }
+
+        hits = (unsigned)_mm256_movemask_pd(_mm256_cmp_pd(RemainderAvx2(limbs, wide, divisor0, reciprocal0),
+                    _mm256_setzero_pd(), _CMP_EQ_OQ))
+            | ((unsigned)_mm256_movemask_pd(_mm256_cmp_pd(RemainderAvx2(limbs, wide, divisor1, reciprocal1),
+                    _mm256_setzero_pd(), _CMP_EQ_OQ)) << 4);
+
+        if (hits && !AddHits(value, index, hits, sum))
+            return false;
+
+        divisor0 = _mm256_add_pd(divisor0, cStep);
+        divisor1 = _mm256_add_pd(divisor1, cStep);
+    }
+
+    return index > last || divisor_sum_range<uint64_t>(value, index, last, sum);
+}
+
+
+/*
+    AVX2 on a wheel: two vectors of four spokes per step.  The lanes past
+    last in the final step are masked off.
+*/
+PERFECT_TARGET("avx2")
+static bool WheelAvx2(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum, const DivisorWheel& wheel)
+{
+    const unsigned  cLanes = 8;
+    const __m256d   cOne = _mm256_set1_pd(1.0);
+    const __m256d   cLast = _mm256_set1_pd((double)last);
+    bool            wide = value >= cWideValue;
+    __m256d         limbs[3];
+    uint64_t        base;
+    uint32_t        spoke;
+
+    limbs[0] = _mm256_set1_pd((double)(wide ? value >> 32 : value));
+    limbs[1] = _mm256_set1_pd((double)((value >> 16) & 0xFFFF));
+    limbs[2] = _mm256_set1_pd((double)(value & 0xFFFF));
+
+    for (WheelStart(wheel, first, base, spoke); base + wheel.offsets[spoke] <= last; WheelStep(wheel, cLanes, base, spoke))
+    {
+        const uint32_t* offsets = &wheel.offsets[spoke];
+        __m256d     turn = _mm256_set1_pd((double)base);
+        __m256i     lanes = _mm256_loadu_si256((const __m256i*)offsets);
+        __m256d     divisor0 = _mm256_add_pd(turn, _mm256_cvtepi32_pd(_mm256_castsi256_si128(lanes)));
+        __m256d     divisor1 = _mm256_add_pd(turn, _mm256_cvtepi32_pd(_mm256_extracti128_si256(lanes, 1)));
+        __m256d     reciprocal0, reciprocal1;
+        unsigned    hits;
+
+        if (base + offsets[cLanes - 1] < cReciprocals)
+        {
+            reciprocal0 = _mm256_i32gather_pd(Reciprocals, _mm256_cvttpd_epi32(divisor0), 8);
+            reciprocal1 = _mm256_i32gather_pd(Reciprocals, _mm256_cvttpd_epi32(divisor1), 8);
+        }
+        else
+        {
+            reciprocal0 = _mm256_div_pd(cOne, divisor0);
+            reciprocal1 = _mm256_div_pd(cOne, divisor1);
+        }
+
+        hits = (unsigned)_mm256_movemask_pd(_mm256_cmp_pd(RemainderAvx2(limbs, wide, divisor0, reciprocal0),
+                    _mm256_setzero_pd(), _CMP_EQ_OQ))
+            | ((unsigned)_mm256_movemask_pd(_mm256_cmp_pd(RemainderAvx2(limbs, wide, divisor1, reciprocal1),
+                    _mm256_setzero_pd(), _CMP_EQ_OQ)) << 4);
+        if (base + offsets[cLanes - 1] > last)
+            hits &= (unsigned)_mm256_movemask_pd(_mm256_cmp_pd(divisor0, cLast, _CMP_LE_OQ))
+                | ((unsigned)_mm256_movemask_pd(_mm256_cmp_pd(divisor1, cLast, _CMP_LE_OQ)) << 4);
+
+        if (hits && !AddWheelHits(value, base, offsets, hits, sum))
+            return false;
+    }
+
+    return true;
+}
+
+
+PERFECT_TARGET("avx512f")
+static inline __m512d ReduceAvx512(__m512d x, __m512d divisor, __m512d reciprocal)
+{
+    __m512d     quotient = _mm512_maskz_roundscale_pd(0xFF, _mm512_mul_pd(x, reciprocal),
+                    _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+
+    x = _mm512_sub_pd(x, _mm512_mul_pd(quotient, divisor));
+    return _mm512_mask_add_pd(x, _mm512_cmp_pd_mask(x, _mm512_setzero_pd(), _CMP_LT_OQ), x, divisor);
+}
+
+
+PERFECT_TARGET("avx512f")
+static inline __mmask8 ZeroAvx512(const __m512d limbs[3], bool wide, __m512d divisor, __m512d reciprocal)
+{
+    const __m512d   cShift = _mm512_set1_pd(65536.0);
+    __m512d         x = ReduceAvx512(limbs[0], divisor, reciprocal);
+
+    if (wide)
+    {
+        x = ReduceAvx512(_mm512_add_pd(_mm512_mul_pd(x, cShift), limbs[1]), divisor, reciprocal);
+        x = ReduceAvx512(_mm512_add_pd(_mm512_mul_pd(x, cShift), limbs[2]), divisor, reciprocal);
+    }
+
+    return _mm512_cmp_pd_mask(x, _mm512_setzero_pd(), _CMP_EQ_OQ);
+}
+
+
+/*
+    AVX-512: two vectors of eight divisors per step.
+*/
+PERFECT_TARGET("avx512f")
+static bool RangeAvx512(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum)
+{
+    const unsigned  cLanes = 16;
+    const __m512d   cOne = _mm512_set1_pd(1.0);
+    const __m512d   cStep = _mm512_set1_pd((double)cLanes);
+    bool            wide = value >= cWideValue;
+    __m512d         limbs[3];
+    __m512d         divisor0, divisor1;
+    uint64_t        index = first;
+
+    limbs[0] = _mm512_set1_pd((double)(wide ? value >> 32 : value));
+    limbs[1] = _mm512_set1_pd((double)((value >> 16) & 0xFFFF));
+    limbs[2] = _mm512_set1_pd((double)(value & 0xFFFF));
+    divisor0 = _mm512_add_pd(_mm512_set1_pd((double)index),
+        _mm512_setr_pd(0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0));
+    divisor1 = _mm512_add_pd(divisor0, _mm512_set1_pd(8.0));
+
+    for (; index <= last && last - index >= cLanes - 1; index += cLanes)
+    {
+        __m512d     reciprocal0, reciprocal1;
+        unsigned    hits;
+
+        if (index + cLanes <= cReciprocals)
+        {
+            reciprocal0 = _mm512_loadu_pd(&Reciprocals[index]);
+            reciprocal1 = _mm512_loadu_pd(&Reciprocals[index + 8]);
+        }
+        else
+        {
+            reciprocal0 = _mm512_div_pd(cOne, divisor0);
+            reciprocal1 = _mm512_div_pd(cOne, divisor1);
+        }
+
+        hits = (unsigned)ZeroAvx512(limbs, wide, divisor0, reciprocal0)
+            | ((unsigned)ZeroAvx512(limbs, wide, divisor1, reciprocal1) << 8);
+
+        if (hits && !AddHits(value, index, hits, sum))
+            return false;
+
+        divisor0 = _mm512_add_pd(divisor0, cStep);
+        divisor1 = _mm512_add_pd(divisor1, cStep);
+    }
+
+    return index > last || divisor_sum_range<uint64_t>(value, index, last, sum);
+}
+
+
+/*
+    AVX-512 on a wheel: two vectors of eight spokes per step.
+*/
+PERFECT_TARGET("avx512f")
+static bool WheelAvx512(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum, const DivisorWheel& wheel)
+{
+    const unsigned  cLanes = 16;
+    const __m512d   cOne = _mm512_set1_pd(1.0);
+    const __m512d   cLast = _mm512_set1_pd((double)last);
+    bool            wide = value >= cWideValue;
+    __m512d         limbs[3];
+    uint64_t        base;
+    uint32_t        spoke;
+
+    limbs[0] = _mm512_set1_pd((double)(wide ? value >> 32 : value));
+    limbs[1] = _mm512_set1_pd((double)((value >> 16) & 0xFFFF));
+    limbs[2] = _mm512_set1_pd((double)(value & 0xFFFF));
+
+    for (WheelStart(wheel, first, base, spoke); base + wheel.offsets[spoke] <= last; WheelStep(wheel, cLanes, base, spoke))
+    {
+        const uint32_t* offsets = &wheel.offsets[spoke];
+        __m512d     turn = _mm512_set1_pd((double)base);
+        __m512i     lanes = _mm512_loadu_si512((const void*)offsets);
+        __m512d     divisor0 = _mm512_add_pd(turn, _mm512_cvtepi32_pd(_mm512_castsi512_si256(lanes)));
+        __m512d     divisor1 = _mm512_add_pd(turn, _mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(lanes, 1)));
+        __m512d     reciprocal0, reciprocal1;
+        unsigned    hits;
+
+        if (base + offsets[cLanes - 1] < cReciprocals)
+        {
+            reciprocal0 = _mm512_i32gather_pd(_mm512_cvttpd_epi32(divisor0), Reciprocals, 8);
+            reciprocal1 = _mm512_i32gather_pd(_mm512_cvttpd_epi32(divisor1), Reciprocals, 8);
+        }
+        else
+        {
+            reciprocal0 = _mm512_div_pd(cOne, divisor0);
+            reciprocal1 = _mm512_div_pd(cOne, divisor1);
+        }
+
+        hits = (unsigned)ZeroAvx512(limbs, wide, divisor0, reciprocal0)
+            | ((unsigned)ZeroAvx512(limbs, wide, divisor1, reciprocal1) << 8);
+        if (base + offsets[cLanes - 1] > last)
+            hits &= (unsigned)_mm512_cmp_pd_mask(divisor0, cLast, _CMP_LE_OQ)
+                | ((unsigned)_mm512_cmp_pd_mask(divisor1, cLast, _CMP_LE_OQ) << 8);
+
+        if (hits && !AddWheelHits(value, base, offsets, hits, sum))
+            return false;
+    }
+
+    return true;
+}
+
+#endif  // PERFECT_SIMD_X86
+
+
+#if defined(PERFECT_SIMD_NEON)
+
+static inline float64x2_t ReduceNeon(float64x2_t x, float64x2_t divisor, float64x2_t reciprocal)
+{
+    float64x2_t quotient = vrndnq_f64(vmulq_f64(x, reciprocal));
+
+    x = vsubq_f64(x, vmulq_f64(quotient, divisor));
+    return vaddq_f64(x, vreinterpretq_f64_u64(vandq_u64(vcltzq_f64(x), vreinterpretq_u64_f64(divisor))));
+}
+
+
+static inline unsigned ZeroNeon(const float64x2_t limbs[3], bool wide, float64x2_t divisor, float64x2_t reciprocal)
+{
+    const float64x2_t   cShift = vdupq_n_f64(65536.0);
+    float64x2_t         x = ReduceNeon(limbs[0], divisor, reciprocal);
+    uint64x2_t          zero;
+
+    if (wide)
+    {
+        x = ReduceNeon(vaddq_f64(vmulq_f64(x, cShift), limbs[1]), divisor, reciprocal);
+        x = ReduceNeon(vaddq_f64(vmulq_f64(x, cShift), limbs[2]), divisor, reciprocal);
+    }
+
+    zero = vceqzq_f64(x);
+    return (unsigned)(vgetq_lane_u64(zero, 0) & 1) | ((unsigned)(vgetq_lane_u64(zero, 1) & 1) << 1);
+}
+
+
+/*
+    NEON: four vectors of two divisors per step.
+*/
+static bool RangeNeon(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum)
+{
+    const unsigned      cLanes = 8;
+    const float64x2_t   cOne = vdupq_n_f64(1.0);
+    const float64x2_t   cStep = vdupq_n_f64((double)cLanes);
+    bool                wide = value >= cWideValue;
+    float64x2_t         limbs[3];
+    float64x2_t         divisor[4];
+    uint64_t            index = first;
+
+    limbs[0] = vdupq_n_f64((double)(wide ? value >> 32 : value));
+    limbs[1] = vdupq_n_f64((double)((value >> 16) & 0xFFFF));
+    limbs[2] = vdupq_n_f64((double)(value & 0xFFFF));
+    for (unsigned vector = 0; vector < 4; vector++)
+    {
+        double  pair[2] = { (double)(index + 2 * vector), (double)(index + 2 * vector + 1) };
+
+        divisor[vector] = vld1q_f64(pair);
+    }
+
+    for (; index <= last && last - index >= cLanes - 1; index += cLanes)
+    {
+        unsigned    hits = 0;
+
+        for (unsigned vector = 0; vector < 4; vector++)
+        {
+            float64x2_t reciprocal = (index + cLanes <= cReciprocals)
+                ? vld1q_f64(&Reciprocals[index + 2 * vector])
+                : vdivq_f64(cOne, divisor[vector]);
+
+            hits |= ZeroNeon(limbs, wide, divisor[vector], reciprocal) << (2 * vector);
+            divisor[vector] = vaddq_f64(divisor[vector], cStep);
+        }
+
+        if (hits && !AddHits(value, index, hits, sum))
+            return false;
+    }
+
+    return index > last || divisor_sum_range<uint64_t>(value, index, last, sum);
+}
+
+
+/*
+    NEON on a wheel: four vectors of two spokes per step.  There is no
+    gather, so the reciprocals are always computed.
+*/
+static bool WheelNeon(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum, const DivisorWheel& wheel)
+{
+    const unsigned      cLanes = 8;
+    const float64x2_t   cOne = vdupq_n_f64(1.0);
+    const float64x2_t   cLast = vdupq_n_f64((double)last);
+    bool                wide = value >= cWideValue;
+    float64x2_t         limbs[3];
+    uint64_t            base;
+    uint32_t            spoke;
+
+    limbs[0] = vdupq_n_f64((double)(wide ? value >> 32 : value));
+    limbs[1] = vdupq_n_f64((double)((value >> 16) & 0xFFFF));
+    limbs[2] = vdupq_n_f64((double)(value & 0xFFFF));
+
+    for (WheelStart(wheel, first, base, spoke); base + wheel.offsets[spoke] <= last; WheelStep(wheel, cLanes, base, spoke))
+    {
+        const uint32_t* offsets = &wheel.offsets[spoke];
+        float64x2_t     turn = vdupq_n_f64((double)base);
+        unsigned        hits = 0;
+
+        for (unsigned vector = 0; vector < 4; vector++)
+        {
+            float64x2_t divisor = vaddq_f64(turn, vcvtq_f64_u64(vmovl_u32(vld1_u32(&offsets[2 * vector]))));
+            uint64x2_t  within = vcleq_f64(divisor, cLast);
+            unsigned    mask = (unsigned)(vgetq_lane_u64(within, 0) & 1) | ((unsigned)(vgetq_lane_u64(within, 1) & 1) << 1);
+
+            hits |= (ZeroNeon(limbs, wide, divisor, vdivq_f64(cOne, divisor)) & mask) << (2 * vector);
+        }
+
+        if (hits && !AddWheelHits(value, base, offsets, hits, sum))
+            return false;
+    }
+
+    return true;
+}
+
+#endif  // PERFECT_SIMD_NEON
+
+
+SimdLevel simd_level(void)
+{
+    static SimdLevel    level = []
+    {
+#if defined(PERFECT_SIMD_X86) && defined(_MSC_VER)
+        int         info[4];
+        bool        osAvx, osAvx512;
+
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return cSimdNone;
+
+        // the OS must save the ymm (and zmm) registers
+        __cpuid(info, 1);
+        if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)))
+            return cSimdNone;
+        osAvx = (_xgetbv(0) & 0x06) == 0x06;
+        osAvx512 = (_xgetbv(0) & 0xE6) == 0xE6;
+
+        __cpuidex(info, 7, 0);
+        if (osAvx512 && (info[1] & (1 << 16)))
+            return cSimdAvx512;
+        if (osAvx && (info[1] & (1 << 5)))
+            return cSimdAvx2;
+        return cSimdNone;
+#elif defined(PERFECT_SIMD_X86)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return cSimdAvx512;
+        if (__builtin_cpu_supports("avx2"))
+            return cSimdAvx2;
+        return cSimdNone;
+#elif defined(PERFECT_SIMD_NEON)
+        return cSimdNeon;               // part of every AArch64 core
+#else
+        return cSimdNone;
+#endif
+    }();
+
+    return level;
+}
+
+
+const char* simd_level_name(SimdLevel level)
+{
+    switch (level)
+    {
+    case cSimdNeon:     return "NEON";
+    case cSimdAvx2:     return "AVX2";
+    case cSimdAvx512:   return "AVX-512";
+    default:            return "scalar";
+    }
+}
+
+
+/*
+    The kernel for a level, stepping down to the best one this CPU (and
+    this build) really has.
+*/
+static SimdRange KernelFor(SimdLevel level)
+{
+    if (level > simd_level())
+        level = simd_level();
+
+    std::call_once(ReciprocalsBuilt, BuildReciprocals);
+
+    switch (level)
+    {
+#if defined(PERFECT_SIMD_X86)
+    case cSimdAvx512:   return RangeAvx512;
+    case cSimdAvx2:     return RangeAvx2;
+#endif
+#if defined(PERFECT_SIMD_NEON)
+    case cSimdNeon:     return RangeNeon;
+#endif
+    default:            return RangeScalar;
+    }
+}
+
+
+static SimdWheel WheelKernelFor(SimdLevel level)
+{
+    if (level > simd_level())
+        level = simd_level();
+
+    std::call_once(ReciprocalsBuilt, BuildReciprocals);
+
+    switch (level)
+    {
+#if defined(PERFECT_SIMD_X86)
+    case cSimdAvx512:   return WheelAvx512;
+    case cSimdAvx2:     return WheelAvx2;
+#endif
+#if defined(PERFECT_SIMD_NEON)
+    case cSimdNeon:     return WheelNeon;
+#endif
+    default:            return WheelScalar;
+    }
+}
+
+
+template <>
+bool divisor_sum_range_simd<uint64_t>(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum, SimdLevel level)
+{
+    return KernelFor(level)(value, first, last, sum);
+}
+
+
+template <>
+bool divisor_sum_range_simd<uint32_t>(uint32_t value, uint32_t first, uint32_t last, uint32_t& sum, SimdLevel level)
+{
+    uint64_t    wideSum = sum;
+    bool        within = KernelFor(level)(value, first, last, wideSum);
+
+    sum = (uint32_t)wideSum;            // never above value, so it fits
+    return within;
+}
+
+
+#if defined(__SIZEOF_INT128__)
+template <>
+bool divisor_sum_range_simd<uint128_t>(uint128_t value, uint128_t first, uint128_t last, uint128_t& sum, SimdLevel level)
+{
+    uint64_t    narrowSum = (uint64_t)sum;
+    bool        within;
+
+    // the lanes work on 64-bit values; anything wider stays scalar
+    if (value > UINT64_MAX)
+        return divisor_sum_range<uint128_t>(value, first, last, sum);
+
+    within = KernelFor(level)((uint64_t)value, (uint64_t)first, (uint64_t)last, narrowSum);
+    sum = narrowSum;
+    return within;
+}
+#endif
+
+
+template <>
+bool divisor_sum_range_simd<uint64_t>(uint64_t value, uint64_t first, uint64_t last, uint64_t& sum,
+    const DivisorWheel& wheel)
+{
+    return WheelKernelFor(simd_level())(value, first, last, sum, wheel);
+}
+
+
+template <>
+bool divisor_sum_range_simd<uint32_t>(uint32_t value, uint32_t first, uint32_t last, uint32_t& sum,
+    const DivisorWheel& wheel)
+{
+    uint64_t    wideSum = sum;
+    bool        within = WheelKernelFor(simd_level())(value, first, last, wideSum, wheel);
+
+    sum = (uint32_t)wideSum;
+    return within;
+}
+
+
+#if defined(__SIZEOF_INT128__)
+template <>
+bool divisor_sum_range_simd<uint128_t>(uint128_t value, uint128_t first, uint128_t last, uint128_t& sum,
+    const DivisorWheel& wheel)
+{
+    uint64_t    narrowSum = (uint64_t)sum;
+    bool        within;
+
+    if (value > UINT64_MAX)
+        return divisor_sum_range<uint128_t>(value, first, last, sum, wheel);
+
+    within = WheelKernelFor(simd_level())((uint64_t)value, (uint64_t)first, (uint64_t)last, narrowSum, wheel);
+    sum = narrowSum;
+    return within;
+}
+#endif
+
+
+template <typename T>
+bool divisor_sum_range_simd(T value, T first, T last, T& sum)
+{
+    return divisor_sum_range_simd<T>(value, first, last, sum, simd_level());
+}
+
+
+template <typename T>
+bool is_perfect_simd(T value)
+{
+    return trial_verdict<T>(value, cEngineSimd) == cVerdictPerfect;
+}
+
+
+// the instantiations PerfectLib provides
+template bool   divisor_sum_range_simd<uint32_t>(uint32_t, uint32_t, uint32_t, uint32_t&);
+template bool   divisor_sum_range_simd<uint64_t>(uint64_t, uint64_t, uint64_t, uint64_t&);
+template bool   is_perfect_simd<uint32_t>(uint32_t);
+template bool   is_perfect_simd<uint64_t>(uint64_t);
+#if defined(__SIZEOF_INT128__)
+template bool   divisor_sum_range_simd<uint128_t>(uint128_t, uint128_t, uint128_t, uint128_t&);
+template bool   is_perfect_simd<uint128_t>(uint128_t);
+#endif
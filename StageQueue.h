@@ -0,0 +1,117 @@
+/*
+    StageQueue.h -- A bounded, lock-free queue between two stages of the
+    staged sweep (the PerfectSweep library).
+
+    Any number of threads push and any number pop.  Each slot carries a
+    sequence number that says whose turn it is: a pusher claims the tail
+    with one compare-exchange and publishes the item by bumping the
+    slot's sequence, a popper does the same at the head, so neither end
+    ever takes a lock or waits on the other except when the queue is
+    full or empty.  Then TryPush() or TryPop() fails, and the stage backs
+    off; that is the backpressure of the pipeline.
+
+    The slots are fixed at construction, a power of two of them, so the
+    queue never allocates once it exists.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+
+
+template <typename T>
+class StageQueue
+{
+public:
+    // At least slots items, rounded up to a power of two.
+    explicit StageQueue(size_t slots)
+    {
+        size_t      size = 2;
+
+        while (size < slots)
+            size *= 2;
+        mask_ = size - 1;
+        cells_.reset(new Cell[size]);
+        for (size_t index = 0; index < size; index++)
+            cells_[index].sequence.store(index, std::memory_order_relaxed);
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+    // false if the queue is full
+    bool        TryPush(const T& item)
+    {
+        size_t      position = tail_.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            Cell&       cell = cells_[position & mask_];
+            size_t      sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t    lag = (intptr_t)sequence - (intptr_t)position;
+
+            if (lag == 0 && tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                cell.item = item;
+                cell.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+            if (lag < 0)
+                return false;
+            if (lag > 0)
+                position = tail_.load(std::memory_order_relaxed);
+        }
+    }
+
+    // false if the queue is empty
+    bool        TryPop(T& item)
+    {
+        size_t      position = head_.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            Cell&       cell = cells_[position & mask_];
+            size_t      sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t    lag = (intptr_t)sequence - (intptr_t)(position + 1);
+
+            if (lag == 0 && head_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                item = cell.item;
+                cell.sequence.store(position + mask_ + 1, std::memory_order_release);
+                return true;
+            }
+            if (lag < 0)
+                return false;
+            if (lag > 0)
+                position = head_.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Items waiting, as of a moment ago; exact only when nobody is
+    // pushing or popping.
+    size_t      Depth(void) const
+    {
+        size_t      head = head_.load(std::memory_order_relaxed);
+        size_t      tail = tail_.load(std::memory_order_relaxed);
+
+        return (tail > head) ? tail - head : 0;
+    }
+
+    size_t      Slots(void) const { return mask_ + 1; }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;           // position + 1 once pushed, + slots once popped
+        T                   item;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t                  mask_;
+    alignas(64) std::atomic<size_t> head_;      // the ends on lines of their own
+    alignas(64) std::atomic<size_t> tail_;
+
+    StageQueue(const StageQueue&) = delete;
+    StageQueue& operator=(const StageQueue&) = delete;
+};
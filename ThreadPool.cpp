@@ -0,0 +1,179 @@
+/*
+    ThreadPool.cpp -- Work-stealing thread pool for the candidate sweep.
+*/
+#include "ThreadPool.h"
+#include "NodeLocal.h"
+
+#include <chrono>
+
+
+// the pool and worker index of the current thread, if it is a worker
+static thread_local WorkStealingPool*   CurrentPool = nullptr;
+static thread_local unsigned            CurrentWorker = 0;
+
+
+WorkStealingPool::WorkStealingPool(unsigned numThreads, const std::vector<ThreadPlace>* places)
+    : pending(0), queued(0), nextWorker(0), numNodes(1), stopping(false)
+{
+    if (numThreads == 0)
+        numThreads = DefaultThreads();
+
+    for (unsigned index = 0; index < numThreads; index++)
+    {
+        workers.emplace_back(new Worker);
+        workers[index]->place.node = 0;
+        workers[index]->place.cpu = -1;
+        if (places != nullptr && !places->empty())
+            workers[index]->place = (*places)[index % places->size()];
+        if (workers[index]->place.node >= numNodes)
+            numNodes = workers[index]->place.node + 1;
+    }
+
+    // start the threads only once every deque exists, since they steal
+    for (unsigned index = 0; index < numThreads; index++)
+        workers[index]->thread = std::thread(&WorkStealingPool::WorkerLoop, this, index);
+}
+
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(idleLock);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+
+    for (auto& worker : workers)
+        worker->thread.join();
+}
+
+
+unsigned WorkStealingPool::DefaultThreads(void)
+{
+    unsigned    numThreads = std::thread::hardware_concurrency();
+
+    return numThreads ? numThreads : 1;
+}
+
+
+unsigned WorkStealingPool::WorkerIndex(void) const
+{
+    return (CurrentPool == this) ? CurrentWorker : NumThreads();
+}
+
+
+void WorkStealingPool::Submit(Task task)
+{
+    unsigned    target;
+
+    if (CurrentPool == this)
+        target = CurrentWorker;
+    else
+        target = nextWorker++ % (unsigned)workers.size();
+
+    pending++;
+    {
+        std::lock_guard<std::mutex> guard(workers[target]->lock);
+        workers[target]->tasks.push_back(std::move(task));
+    }
+    queued++;
+
+    // take idleLock so a worker between its check and its wait can't miss this
+    {
+        std::lock_guard<std::mutex> guard(idleLock);
+    }
+    wakeUp.notify_one();
+}
+
+
+bool WorkStealingPool::WaitFor(unsigned milliseconds)
+{
+    std::unique_lock<std::mutex> guard(idleLock);
+
+    return allDone.wait_for(guard, std::chrono::milliseconds(milliseconds),
+        [this] { return pending == 0; });
+}
+
+
+/*
+    Take the newest task of our own deque, or else steal the oldest task of
+    the other workers, starting with our neighbour so thieves spread out:
+    first those of our own node, then the rest.
+*/
+bool WorkStealingPool::TakeTask(unsigned self, Task& task)
+{
+    unsigned    numWorkers = (unsigned)workers.size();
+    unsigned    node = workers[self]->place.node;
+
+    {
+        Worker&     own = *workers[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued--;
+            return true;
+        }
+    }
+
+    for (unsigned pass = 0; pass < (numNodes > 1 ? 2u : 1u); pass++)
+    {
+        for (unsigned offset = 1; offset < numWorkers; offset++)
+        {
+            Worker&     victim = *workers[(self + offset) % numWorkers];
+
+            if (numNodes > 1 && (victim.place.node == node) != (pass == 0))
+                continue;
+
+            std::lock_guard<std::mutex> guard(victim.lock);
+
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                queued--;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+
+void WorkStealingPool::WorkerLoop(unsigned self)
+{
+    Task    task;
+
+    CurrentPool = this;
+    CurrentWorker = self;
+
+    // pinned before the first task, so its scratch is first touched here
+    if (workers[self]->place.cpu >= 0)
+        pin_thread((unsigned)workers[self]->place.cpu);
+    set_thread_node(workers[self]->place.node);
+
+    for (;;)
+    {
+        if (TakeTask(self, task))
+        {
+            task();
+            task = nullptr;
+
+            if (--pending == 0)
+            {
+                std::lock_guard<std::mutex> guard(idleLock);
+                allDone.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(idleLock);
+
+        wakeUp.wait(guard, [this] { return stopping || queued > 0; });
+        if (stopping && queued == 0)
+            return;
+    }
+}
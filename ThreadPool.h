@@ -0,0 +1,83 @@
+/*
+    ThreadPool.h -- Work-stealing thread pool for the candidate sweep.
+
+    Every worker owns a deque of tasks.  A worker takes its own newest task
+    first (LIFO, so a task that splits itself keeps its pieces hot in
+    cache), and when its deque runs dry it steals the oldest task of
+    another worker (FIFO, the biggest piece of work still waiting).  That
+    keeps all workers busy even though the cost of a candidate grows
+    steeply with hiPower, where a static split would leave most threads
+    idle behind the last few stragglers.
+
+    Given ThreadPlaces (Topology.h), each worker pins itself to its
+    processor and steals from the workers of its own node, nearest
+    first, before it tries any other node, so work crosses a socket only
+    once a whole node has run dry.
+*/
+#pragma once
+
+#include "Topology.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class WorkStealingPool
+{
+public:
+    typedef std::function<void(void)> Task;
+
+    // Unpinned, on one node, unless places are given: then worker i runs
+    // at places[i % places->size()].
+    explicit WorkStealingPool(unsigned numThreads, const std::vector<ThreadPlace>* places = nullptr);
+    ~WorkStealingPool();
+
+    // Queue a task.  From a worker it goes onto that worker's own deque,
+    // from any other thread onto the next deque in round-robin order.
+    void        Submit(Task task);
+
+    // Wait up to the given time for every submitted task to finish;
+    // returns true once the pool is idle.
+    bool        WaitFor(unsigned milliseconds);
+
+    unsigned    NumThreads(void) const { return (unsigned)workers.size(); }
+
+    // Index of the calling worker, or NumThreads() if it is not one.
+    unsigned    WorkerIndex(void) const;
+
+    // Nodes the workers are on, and the node of a worker; node 0 for
+    // NumThreads(), the caller that is not one.
+    unsigned    NumNodes(void) const { return numNodes; }
+    unsigned    NodeOf(unsigned worker) const { return worker < NumThreads() ? workers[worker]->place.node : 0; }
+
+    // Thread count to use when the caller asks for "all of them".
+    static unsigned DefaultThreads(void);
+
+private:
+    struct Worker
+    {
+        std::mutex          lock;               // guards tasks
+        std::deque<Task>    tasks;              // own work, newest at the back
+        std::thread         thread;
+        ThreadPlace         place;
+    };
+
+    bool        TakeTask(unsigned self, Task& task);
+    void        WorkerLoop(unsigned self);
+
+    std::vector<std::unique_ptr<Worker> > workers;
+    std::mutex              idleLock;           // pairs with wakeUp and allDone
+    std::condition_variable wakeUp;             // signalled when work is queued
+    std::condition_variable allDone;            // signalled when pending hits 0
+    std::atomic<size_t>     pending;            // submitted but not finished
+    std::atomic<size_t>     queued;             // sitting in some deque
+    std::atomic<unsigned>   nextWorker;         // round-robin for outside submits
+    unsigned                numNodes;
+    bool                    stopping;           // guarded by idleLock
+};
@@ -0,0 +1,225 @@
+/*
+    Topology.cpp -- The NUMA nodes and thread pinning (the PerfectSweep
+    library).
+*/
+#include "Topology.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <thread>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__linux__)
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+static std::vector<CpuNode> OneNode(void);
+#if defined(__linux__)
+static bool     ParseCpuList(const char* text, std::vector<unsigned>& cpus);
+#endif
+
+
+static std::vector<CpuNode> OneNode(void)
+{
+    std::vector<CpuNode>    nodes(1);
+    unsigned                count = std::thread::hardware_concurrency();
+
+    nodes[0].id = 0;
+    for (unsigned cpu = 0; cpu < (count ? count : 1); cpu++)
+        nodes[0].cpus.push_back(cpu);
+
+    return nodes;
+}
+
+
+#if defined(_WIN32)
+
+std::vector<CpuNode> cpu_nodes(void)
+{
+    std::vector<CpuNode>    nodes;
+    std::vector<char>       buffer;
+    DWORD                   length = 0;
+
+    GetLogicalProcessorInformationEx(RelationNumaNode, nullptr, &length);
+    buffer.resize(length);
+    if (length == 0 || !GetLogicalProcessorInformationEx(RelationNumaNode,
+                            (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)buffer.data(), &length))
+        return OneNode();
+
+    for (DWORD offset = 0; offset < length; )
+    {
+        const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* info =
+            (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)(buffer.data() + offset);
+        CpuNode     node;
+
+        node.id = info->NumaNode.NodeNumber;
+        for (unsigned bit = 0; bit < 64; bit++)
+            if (info->NumaNode.GroupMask.Mask & ((KAFFINITY)1 << bit))
+                node.cpus.push_back(64 * info->NumaNode.GroupMask.Group + bit);
+        if (!node.cpus.empty())
+            nodes.push_back(node);
+        offset += info->Size;
+    }
+
+    if (nodes.empty())
+        return OneNode();
+    std::sort(nodes.begin(), nodes.end(), [](const CpuNode& a, const CpuNode& b) { return a.id < b.id; });
+    return nodes;
+}
+
+
+bool pin_thread(unsigned cpu)
+{
+    GROUP_AFFINITY  affinity = {};
+
+    affinity.Group = (WORD)(cpu / 64);
+    affinity.Mask = (KAFFINITY)1 << (cpu % 64);
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+}
+
+#elif defined(__linux__)
+
+std::vector<CpuNode> cpu_nodes(void)
+{
+    std::vector<CpuNode>    nodes;
+    DIR*                    dir = opendir("/sys/devices/system/node");
+    struct dirent*          entry;
+
+    if (dir == nullptr)
+        return OneNode();
+
+    while ((entry = readdir(dir)) != nullptr)
+    {
+        char        path[300], text[4096];
+        unsigned    id;
+        char        extra;
+        FILE*       fd;
+        CpuNode     node;
+
+        if (sscanf(entry->d_name, "node%u%c", &id, &extra) != 1)
+            continue;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/node/%s/cpulist", entry->d_name);
+        if ((fd = fopen(path, "r")) == nullptr)
+            continue;
+        if (fgets(text, sizeof(text), fd) != nullptr && ParseCpuList(text, node.cpus) && !node.cpus.empty())
+        {
+            node.id = id;
+            nodes.push_back(node);
+        }
+        fclose(fd);
+    }
+    closedir(dir);
+
+    if (nodes.empty())
+        return OneNode();
+    std::sort(nodes.begin(), nodes.end(), [](const CpuNode& a, const CpuNode& b) { return a.id < b.id; });
+    return nodes;
+}
+
+
+bool pin_thread(unsigned cpu)
+{
+    cpu_set_t   set;
+
+    if (cpu >= CPU_SETSIZE)
+        return false;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+
+/*
+    "0-15,32-47" and the like; a memoryless node has an empty list.
+*/
+static bool ParseCpuList(const char* text, std::vector<unsigned>& cpus)
+{
+    while (*text != '\0' && *text != '\n')
+    {
+        char*           end;
+        unsigned long   first = strtoul(text, &end, 10), last = first;
+
+        if (end == text)
+            return false;
+        if (*end == '-')
+        {
+            text = end + 1;
+            last = strtoul(text, &end, 10);
+            if (end == text || last < first)
+                return false;
+        }
+        for (unsigned long cpu = first; cpu <= last; cpu++)
+            cpus.push_back((unsigned)cpu);
+
+        text = (*end == ',') ? end + 1 : end;
+    }
+
+    return true;
+}
+
+#else
+
+std::vector<CpuNode> cpu_nodes(void)
+{
+    return OneNode();
+}
+
+
+bool pin_thread(unsigned)
+{
+    return false;
+}
+
+#endif
+
+
+/*
+    The workers are dealt out in blocks, so worker w of n is on the
+    (w * nodes / n)th node and the workers of one node are neighbours:
+    a worker steals along its neighbours first.
+*/
+std::vector<ThreadPlace> place_threads(unsigned numThreads, const std::vector<unsigned>& nodeIds, std::string& error)
+{
+    std::vector<CpuNode>        nodes = cpu_nodes(), chosen;
+    std::vector<ThreadPlace>    places;
+
+    for (size_t index = 0; index < nodeIds.size(); index++)
+    {
+        size_t  found = 0;
+
+        while (found < nodes.size() && nodes[found].id != nodeIds[index])
+            found++;
+        if (found == nodes.size())
+        {
+            error = "there is no NUMA node " + std::to_string(nodeIds[index]) + " with processors";
+            return places;
+        }
+        chosen.push_back(nodes[found]);
+    }
+    if (chosen.empty())
+        chosen = nodes;
+
+    for (unsigned worker = 0; worker < numThreads; worker++)
+    {
+        unsigned        node = (unsigned)((uint64_t)worker * chosen.size() / numThreads);
+        unsigned        first = (unsigned)(((uint64_t)node * numThreads + chosen.size() - 1) / chosen.size());
+        const CpuNode&  home = chosen[node];
+        ThreadPlace     place;
+
+        // each node's processors from its own first worker on
+        place.node = node;
+        place.cpu = (int)home.cpus[(worker - first) % home.cpus.size()];
+        places.push_back(place);
+    }
+
+    return places;
+}
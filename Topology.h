@@ -0,0 +1,53 @@
+/*
+    Topology.h -- The NUMA nodes of the machine and where the workers of
+    a pool run (the PerfectSweep library).
+
+    Left to the scheduler, the workers of a two-socket machine wander
+    between the sockets, and with them the lines of the shared tables
+    and of each candidate.  A ThreadPlace puts a worker on one processor
+    of one node for its whole life: the pool pins it there, takes its
+    tasks from the workers of its own node before it steals across
+    sockets, and tells PerfectLib its node (NodeLocal.h) so the tables it
+    reads are the copies on that node.
+
+    This is the one part of the libraries that asks the OS anything: the
+    node list comes from /sys/devices/system/node on Linux and from
+    GetLogicalProcessorInformationEx() on Windows.  Anywhere else, or
+    where there is no such list, the machine is one node of
+    hardware_concurrency() processors and nothing is pinned.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+
+
+// One NUMA node: its number as the OS has it, and its processors.  On
+// Windows a processor is 64 * group + its number in the group.
+struct CpuNode
+{
+    unsigned                id;
+    std::vector<unsigned>   cpus;
+};
+
+
+// Where one worker runs.  node is dense, 0 .. the pool's nodes - 1, in
+// the order the nodes were asked for; cpu is -1 for anywhere.
+struct ThreadPlace
+{
+    unsigned        node;
+    int             cpu;
+};
+
+
+// The nodes of this machine, in ascending order of id; never empty.
+std::vector<CpuNode> cpu_nodes(void);
+
+// Pin the calling thread to the processor; false if it cannot be.
+bool        pin_thread(unsigned cpu);
+
+// Where numThreads workers go when they are pinned: spread evenly over
+// the nodes with the ids in nodeIds (every node if it is empty), the
+// workers of a node numbered together, one processor each while they
+// last.  Empty, with the reason in error, if a node is not there.
+std::vector<ThreadPlace> place_threads(unsigned numThreads, const std::vector<unsigned>& nodeIds, std::string& error);
@@ -0,0 +1,49 @@
+/*
+    Wheel.cpp -- The 32 divisor wheels (part of PerfectLib).
+*/
+#include "Wheel.h"
+
+#include <mutex>
+
+
+static DivisorWheel     Wheels[1u << cWheelPrimes];     // by the primes left out; read-only once built
+static std::once_flag   WheelsBuilt;
+
+static void     BuildWheels(void);
+
+
+static void BuildWheels(void)
+{
+    for (unsigned primes = 0; primes < (1u << cWheelPrimes); primes++)
+    {
+        DivisorWheel&   wheel = Wheels[primes];
+
+        wheel.modulus = 1;
+        for (unsigned bit = 0; bit < cWheelPrimes; bit++)
+            if (primes & (1u << bit))
+                wheel.modulus *= WheelPrime[bit];
+
+        wheel.spokes = 0;
+        for (uint32_t residue = 0; residue < wheel.modulus; residue++)
+        {
+            bool    coprime = true;
+
+            for (unsigned bit = 0; bit < cWheelPrimes && coprime; bit++)
+                coprime = !(primes & (1u << bit)) || residue % WheelPrime[bit] != 0;
+
+            // 0 is a spoke only of the empty wheel, mod 1
+            if (coprime)
+                wheel.residues[wheel.spokes++] = (uint16_t)residue;
+        }
+
+        for (uint32_t spoke = 0; spoke < wheel.spokes + cWheelRun; spoke++)
+            wheel.offsets[spoke] = wheel.residues[spoke % wheel.spokes] + wheel.modulus * (spoke / wheel.spokes);
+    }
+}
+
+
+const DivisorWheel& divisor_wheel(unsigned primes)
+{
+    std::call_once(WheelsBuilt, BuildWheels);
+    return Wheels[primes & ((1u << cWheelPrimes) - 1)];
+}
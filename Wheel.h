@@ -0,0 +1,119 @@
+/*
+    Wheel.h -- Divisor wheels on the primes 2 to 11 (part of PerfectLib).
+
+    A divisor of n has no prime factor n hasn't, so once 3 is known not to
+    divide n no multiple of 3 can, and the same goes for every small
+    prime.  The wheel of n is built on those of 2, 3, 5, 7 and 11 that do
+    not divide it: its modulus is their product, at most 2310, and its
+    spokes are the residues coprime to the modulus, the only divisors
+    worth trying.
+
+    A pair 2^lo * (2^k - 1) keeps 2 in play, but 3, 5, 7 and 11 divide
+    2^k - 1 only when 2, 4, 3 and 10 divide k, so for most pairs the wheel
+    is mod 1155 and leaves about 42% of the range; the odd part alone adds
+    the 2 and leaves about 21%.  These are the filters of 1.10 and 1.11,
+    which did this for 2 and 3, carried on to 11.
+
+    The 32 wheels are built once and only read from then on.  Each also
+    keeps its spokes as offsets running on into the next turns, for the
+    SIMD kernel's lanes.
+*/
+#pragma once
+
+#include "Perfect.h"
+
+#include <algorithm>
+
+
+const unsigned  cWheelPrimes = 5;                   // 2, 3, 5, 7 and 11
+const unsigned  cMaxSpokes = 480;                   // phi(2310)
+const unsigned  cWheelRun = 16;                     // offsets run on this far past the last spoke
+
+const unsigned  WheelPrime[cWheelPrimes] = { 2, 3, 5, 7, 11 };
+
+
+struct DivisorWheel
+{
+    uint32_t    modulus;                            // product of the primes left out
+    uint32_t    spokes;                             // residues kept
+    uint16_t    residues[cMaxSpokes];               // ascending
+
+    // spoke i counted on through the turns, residues[i % spokes] + modulus
+    // * (i / spokes), so a vector of lanes can start at any spoke
+    uint32_t    offsets[cMaxSpokes + cWheelRun];
+};
+
+
+// The wheel that leaves out the multiples of WheelPrime[bit] for each bit
+// set in primes.
+const DivisorWheel& divisor_wheel(unsigned primes);
+
+
+// The wheel for value: every small prime that doesn't divide it left out.
+template <typename T>
+const DivisorWheel& wheel_for(T value)
+{
+    unsigned    primes = 0;
+
+    for (unsigned bit = 0; bit < cWheelPrimes; bit++)
+        if (value % WheelPrime[bit] != 0)
+            primes |= 1u << bit;
+
+    return divisor_wheel(primes);
+}
+
+
+/*
+    The spokes of a wheel in ascending order from first on.
+*/
+template <typename T>
+class WheelCursor
+{
+public:
+    WheelCursor(const DivisorWheel& wheel, T first) : wheel_(wheel)
+    {
+        T       offset = first % wheel.modulus;
+
+        base_ = first - offset;
+        spoke_ = (uint32_t)(std::lower_bound(wheel.residues, wheel.residues + wheel.spokes, (uint16_t)offset)
+                    - wheel.residues);
+        if (spoke_ == wheel.spokes)
+        {
+            spoke_ = 0;
+            base_ += wheel.modulus;
+        }
+    }
+
+    T           operator*() const { return base_ + wheel_.residues[spoke_]; }
+
+    WheelCursor& operator++()
+    {
+        if (++spoke_ == wheel_.spokes)
+        {
+            spoke_ = 0;
+            base_ += wheel_.modulus;
+        }
+        return *this;
+    }
+
+private:
+    const DivisorWheel& wheel_;
+    T           base_;                              // a multiple of the modulus
+    uint32_t    spoke_;
+};
+
+
+// How many spokes of the wheel lie in first..last; last < the largest T.
+template <typename T>
+uint64_t wheel_count(const DivisorWheel& wheel, T first, T last)
+{
+    auto        below = [&wheel](T bound)           // spokes under bound
+    {
+        uint16_t    offset = (uint16_t)(bound % wheel.modulus);
+
+        return (uint64_t)(bound / wheel.modulus) * wheel.spokes
+            + (uint64_t)(std::lower_bound(wheel.residues, wheel.residues + wheel.spokes, offset) - wheel.residues);
+    };
+
+    return (first > last) ? 0 : below(last + 1) - below(first);
+}